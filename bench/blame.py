@@ -0,0 +1,123 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright 2010-2013 The pygit2 contributors
+#
+# This file is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License, version 2,
+# as published by the Free Software Foundation.
+#
+# In addition to the permissions in the GNU General Public License,
+# the authors give you unlimited permission to link the compiled
+# version of this file into combinations with other programs,
+# and to distribute those combinations without any restriction
+# coming from the use of this file.  (The General Public License
+# restrictions do apply in other respects; for example, they cover
+# modification of the file, and distribution when not linked into
+# a combined executable.)
+#
+# This file is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; see the file COPYING.  If not, write to
+# the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+# Boston, MA 02110-1301, USA.
+
+
+"""Measure Repository.blame on a deep history.
+
+A bare repository is created in a temporary directory, with a file which
+every commit changes: the first commits write its lines, and the others
+rewrite lines taken at random. The time to blame the whole file, and to get
+the first hunk of an incremental blame, is printed as a JSON object.
+
+Usage:
+
+    $ python bench/blame.py [--commits N] [--lines N] [--runs N]
+"""
+
+from __future__ import print_function
+
+import json
+from optparse import OptionParser
+import os
+import random
+import shutil
+import sys
+import tempfile
+import time
+
+# Run against the build tree when invoked from a source checkout
+sys.path.insert(0, os.getcwd())
+from pygit2 import init_repository, Signature, GIT_FILEMODE_BLOB
+
+
+def make_history(path, commits, lines):
+    repo = init_repository(path, True)
+    random.seed(0)
+    content = []
+    parents = []
+    for i in range(commits):
+        if len(content) < lines:
+            content.append('line %d\n' % i)
+        else:
+            content[random.randrange(lines)] = 'line %d\n' % i
+
+        blob = repo.create_blob(''.join(content).encode('ascii'))
+        builder = repo.TreeBuilder()
+        builder.insert('file.txt', blob, GIT_FILEMODE_BLOB)
+        signature = Signature('Bench', 'bench@example.com', 1373371436 + i, 0)
+        oid = repo.create_commit(None, signature, signature, 'Commit %d\n' % i,
+                                 builder.write(), parents)
+        parents = [oid]
+
+    return repo, parents[0]
+
+
+def median_ms(function, runs):
+    timings = []
+    for i in range(runs):
+        start = time.time()
+        function()
+        timings.append((time.time() - start) * 1000.0)
+
+    timings.sort()
+    return round(timings[len(timings) // 2], 3)
+
+
+def main():
+    parser = OptionParser(usage='%prog [--commits N] [--lines N] [--runs N]')
+    parser.add_option('--commits', type='int', default=5000)
+    parser.add_option('--lines', type='int', default=1000)
+    parser.add_option('--runs', type='int', default=5)
+    options, args = parser.parse_args()
+
+    tmp = tempfile.mkdtemp(prefix='pygit2-bench-')
+    try:
+        repo, head = make_history(os.path.join(tmp, 'blame.git'),
+                                  options.commits, options.lines)
+        full = median_ms(lambda: repo.blame('file.txt', head), options.runs)
+        first = median_ms(
+            lambda: next(repo.blame('file.txt', head, incremental=True)),
+            options.runs)
+        hunks = len(repo.blame('file.txt', head))
+    finally:
+        shutil.rmtree(tmp)
+
+    print(json.dumps({
+        'benchmark': 'blame',
+        'commits': options.commits,
+        'lines': options.lines,
+        'runs': options.runs,
+        'hunks': hunks,
+        'blame_ms': full,
+        'first_hunk_ms': first,
+    }, sort_keys=True))
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
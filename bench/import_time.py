@@ -0,0 +1,94 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright 2010-2013 The pygit2 contributors
+#
+# This file is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License, version 2,
+# as published by the Free Software Foundation.
+#
+# In addition to the permissions in the GNU General Public License,
+# the authors give you unlimited permission to link the compiled
+# version of this file into combinations with other programs,
+# and to distribute those combinations without any restriction
+# coming from the use of this file.  (The General Public License
+# restrictions do apply in other respects; for example, they cover
+# modification of the file, and distribution when not linked into
+# a combined executable.)
+#
+# This file is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; see the file COPYING.  If not, write to
+# the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+# Boston, MA 02110-1301, USA.
+
+"""Measure how long 'import pygit2' takes.
+
+Every sample runs a fresh interpreter, once with an empty program and once
+importing pygit2; the difference between the two medians is the cost of the
+import. The result is printed as a JSON object, and the exit status is 1 if
+the cost exceeds the budget (see docs/performance.rst).
+
+Usage:
+
+    $ python bench/import_time.py [--runs N] [--budget MS]
+"""
+
+from __future__ import print_function
+
+import json
+from optparse import OptionParser
+import os
+import subprocess
+import sys
+import time
+
+
+# Keep in sync with docs/performance.rst
+BUDGET_MS = 10.0
+
+
+def sample(program, runs, env):
+    timings = []
+    for i in range(runs):
+        start = time.time()
+        subprocess.check_call([sys.executable, '-c', program], env=env)
+        timings.append((time.time() - start) * 1000.0)
+
+    timings.sort()
+    return timings[len(timings) // 2]
+
+
+def main():
+    parser = OptionParser(usage='%prog [--runs N] [--budget MS]')
+    parser.add_option('--runs', type='int', default=50)
+    parser.add_option('--budget', type='float', default=BUDGET_MS)
+    options, args = parser.parse_args()
+
+    # Run against the build tree when invoked from a source checkout
+    env = dict(os.environ)
+    env.setdefault('PYTHONPATH', os.getcwd())
+
+    # Warm the filesystem cache before measuring
+    sample('import pygit2', 3, env)
+
+    baseline = sample('pass', options.runs, env)
+    with_import = sample('import pygit2', options.runs, env)
+    cost = with_import - baseline
+
+    print(json.dumps({
+        'benchmark': 'import_time',
+        'runs': options.runs,
+        'interpreter_ms': round(baseline, 3),
+        'import_pygit2_ms': round(cost, 3),
+        'budget_ms': options.budget,
+    }, sort_keys=True))
+
+    return 0 if cost <= options.budget else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,132 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright 2010-2013 The pygit2 contributors
+#
+# This file is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License, version 2,
+# as published by the Free Software Foundation.
+#
+# In addition to the permissions in the GNU General Public License,
+# the authors give you unlimited permission to link the compiled
+# version of this file into combinations with other programs,
+# and to distribute those combinations without any restriction
+# coming from the use of this file.  (The General Public License
+# restrictions do apply in other respects; for example, they cover
+# modification of the file, and distribution when not linked into
+# a combined executable.)
+#
+# This file is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; see the file COPYING.  If not, write to
+# the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+# Boston, MA 02110-1301, USA.
+
+
+"""Measure lookup_reference latency with many loose, then packed, references.
+
+A bare repository with one commit and N references to it is created in a
+temporary directory. Lookups of a random sample of the references are timed
+while they are loose files, then again after Repository.pack_references().
+The time it takes to create the references, left loose or packed right
+away, is measured too. The result is printed as a JSON object.
+
+Usage:
+
+    $ python bench/refs.py [--refs N] [--lookups N]
+"""
+
+from __future__ import print_function
+
+import json
+from optparse import OptionParser
+import os
+import random
+import shutil
+import sys
+import tempfile
+import time
+
+# Run against the build tree when invoked from a source checkout
+sys.path.insert(0, os.getcwd())
+from pygit2 import init_repository, Signature, GIT_FILEMODE_BLOB
+
+
+def make_repository(path):
+    repo = init_repository(path, True)
+    blob = repo.create_blob(b'bench\n')
+    builder = repo.TreeBuilder()
+    builder.insert('bench', blob, GIT_FILEMODE_BLOB)
+    signature = Signature('Bench', 'bench@example.com', 1373371436, 0)
+    commit = repo.create_commit(None, signature, signature, 'Bench\n',
+                                builder.write(), [])
+    return repo, commit
+
+
+def create_references(repo, names, commit, packed):
+    start = time.time()
+    repo.create_references(dict((name, commit) for name in names),
+                           packed=packed)
+    return time.time() - start
+
+
+def lookup_us(repo, names):
+    timings = []
+    for name in names:
+        start = time.time()
+        repo.lookup_reference(name)
+        timings.append((time.time() - start) * 1000000.0)
+
+    timings.sort()
+    return {
+        'median_us': round(timings[len(timings) // 2], 3),
+        'p90_us': round(timings[len(timings) * 9 // 10], 3),
+        'total_ms': round(sum(timings) / 1000.0, 3),
+    }
+
+
+def main():
+    parser = OptionParser(usage='%prog [--refs N] [--lookups N]')
+    parser.add_option('--refs', type='int', default=100000)
+    parser.add_option('--lookups', type='int', default=1000)
+    options, args = parser.parse_args()
+
+    names = ['refs/tags/bench/%06d' % i for i in range(options.refs)]
+    sample = random.sample(names, min(options.lookups, len(names)))
+
+    tmp = tempfile.mkdtemp(prefix='pygit2-bench-')
+    try:
+        repo, commit = make_repository(os.path.join(tmp, 'loose.git'))
+        create_loose = create_references(repo, names, commit, False)
+        loose = lookup_us(repo, sample)
+        start = time.time()
+        repo.pack_references()
+        pack = time.time() - start
+        packed = lookup_us(repo, sample)
+
+        repo, commit = make_repository(os.path.join(tmp, 'bulk.git'))
+        create_packed = create_references(repo, names, commit, True)
+        bulk = lookup_us(repo, sample)
+    finally:
+        shutil.rmtree(tmp)
+
+    print(json.dumps({
+        'benchmark': 'refs',
+        'refs': options.refs,
+        'lookups': len(sample),
+        'create_loose_ms': round(create_loose * 1000.0, 3),
+        'pack_references_ms': round(pack * 1000.0, 3),
+        'create_packed_ms': round(create_packed * 1000.0, 3),
+        'lookup_loose': loose,
+        'lookup_packed': packed,
+        'lookup_bulk_packed': bulk,
+    }, sort_keys=True))
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,343 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright 2010-2013 The pygit2 contributors
+#
+# This file is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License, version 2,
+# as published by the Free Software Foundation.
+#
+# In addition to the permissions in the GNU General Public License,
+# the authors give you unlimited permission to link the compiled
+# version of this file into combinations with other programs,
+# and to distribute those combinations without any restriction
+# coming from the use of this file.  (The General Public License
+# restrictions do apply in other respects; for example, they cover
+# modification of the file, and distribution when not linked into
+# a combined executable.)
+#
+# This file is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; see the file COPYING.  If not, write to
+# the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+# Boston, MA 02110-1301, USA.
+
+"""Time the common operations of pygit2 on several repositories.
+
+The repositories are those of test/data, copied to a temporary directory,
+and a synthetic one: a linear history where every commit changes one file
+of a tree of nested directories. The synthetic repository takes a long time
+to generate at its default size (1M commits, 100k files), so it is kept in
+the directory given by --synthetic and reused by the runs that follow;
+without --synthetic it is generated in a temporary directory and removed.
+
+On every repository the suite times object lookup, history walks, tree
+iteration, diffs, blob reads and reference listing; with a working
+directory, status and index updates too. The cost of 'import pygit2' is
+measured with bench/import_time.py. Each timing is the median of --runs
+runs, in milliseconds.
+
+The result is printed as a JSON object. Given the result of an earlier run,
+--compare lists the timings which got slower by more than --tolerance
+percent, and the exit status is then 1.
+
+Usage:
+
+    $ python bench/suite.py [--runs N] [--synthetic PATH] [--commits N]
+                            [--files N] [--sample N] [--compare FILE]
+                            [--tolerance PERCENT]
+"""
+
+from __future__ import print_function
+
+import json
+from optparse import OptionParser
+import os
+import random
+import shutil
+import sys
+import tarfile
+import tempfile
+import time
+
+# Run against the build tree when invoked from a source checkout
+sys.path.insert(0, os.getcwd())
+import pygit2
+from pygit2 import Repository, init_repository, Signature
+from pygit2 import GIT_FILEMODE_BLOB, GIT_FILEMODE_BLOB_EXECUTABLE
+from pygit2 import GIT_FILEMODE_TREE
+from pygit2 import GIT_SORT_TIME, GIT_CHECKOUT_FORCE
+
+import import_time
+
+
+DATA = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'test',
+                    'data')
+
+# Files per directory of the synthetic repository
+FANOUT = 50
+
+# Commits given to create_commits at once
+BATCH = 10000
+
+
+#
+# The synthetic repository
+#
+def synthetic_path(i, files):
+    """Return the path of the i-th file, in directories nested as deep as
+    needed for trees of at most FANOUT entries."""
+    parts = ['f%06d.txt' % i]
+    while files > FANOUT:
+        files = (files + FANOUT - 1) // FANOUT
+        i //= FANOUT
+        parts.append('d%02d' % (i % FANOUT))
+    return '/'.join(reversed(parts))
+
+
+def make_synthetic(path, commits, files):
+    repo = init_repository(path, False)
+    authors = [Signature('Author %d' % i, 'author%d@example.com' % i,
+                         1373371436, 0)
+               for i in range(50)]
+
+    # The first commit adds all the files
+    editor = repo.TreeEditor()
+    for i in range(files):
+        blob = repo.create_blob(('file %d\nrevision 0\n' % i).encode('ascii'))
+        editor.upsert(synthetic_path(i, files), blob, GIT_FILEMODE_BLOB)
+    tree = editor.write()
+
+    # Then every commit changes one file, taken at random
+    random.seed(0)
+    parent = None
+    batch = []
+    for n in range(commits):
+        if n > 0:
+            i = random.randrange(files)
+            data = 'file %d\nrevision %d\n' % (i, n)
+            editor = repo.TreeEditor(tree)
+            editor.upsert(synthetic_path(i, files),
+                          repo.create_blob(data.encode('ascii')),
+                          GIT_FILEMODE_BLOB)
+            tree = editor.write()
+
+        author = authors[n % len(authors)]
+        signature = Signature(author.name, author.email, 1373371436 + n, 0)
+        if batch:
+            parents = [len(batch) - 1]
+        else:
+            parents = [parent] if parent else []
+        batch.append((signature, signature, 'Commit %d\n' % n, tree, parents))
+
+        if len(batch) == BATCH or n == commits - 1:
+            parent = repo.create_commits(batch, 'refs/heads/master')[-1]
+            batch = []
+
+    repo.checkout_head(GIT_CHECKOUT_FORCE)
+    return repo
+
+
+def open_synthetic(path, commits, files):
+    """Open the synthetic repository at the given path, or generate it there.
+    A file next to it records its size, a repository of another size is
+    generated again."""
+    stamp = path.rstrip(os.sep) + '.json'
+    size = {'commits': commits, 'files': files}
+    if os.path.exists(stamp):
+        with open(stamp) as f:
+            if json.load(f) == size:
+                return Repository(path)
+
+    if os.path.exists(path):
+        shutil.rmtree(path)
+    repo = make_synthetic(path, commits, files)
+    with open(stamp, 'w') as f:
+        json.dump(size, f)
+    return repo
+
+
+#
+# The benchmarks
+#
+def median_ms(function, runs):
+    timings = []
+    for i in range(runs):
+        start = time.time()
+        function()
+        timings.append((time.time() - start) * 1000.0)
+
+    timings.sort()
+    return round(timings[len(timings) // 2], 3)
+
+
+def sample_objects(repo, head, size):
+    """Return the commit oids, a sample of them, and one of the files (paths
+    and oids) of the head tree."""
+    random.seed(0)
+    commits = [commit.oid for commit in repo.walk(head, GIT_SORT_TIME)]
+    blobs = [(path, oid) for path, oid, filemode in repo[head].tree.walk()
+             if filemode in (GIT_FILEMODE_BLOB, GIT_FILEMODE_BLOB_EXECUTABLE)]
+    return (commits, random.sample(commits, min(size, len(commits))),
+            random.sample(blobs, min(size, len(blobs))))
+
+
+def iterate_tree(repo, tree):
+    count = 0
+    for entry in tree:
+        count += 1
+        if entry.filemode == GIT_FILEMODE_TREE:
+            count += iterate_tree(repo, repo[entry.oid])
+    return count
+
+
+def diff_patches(repo, oids):
+    for oid in oids:
+        commit = repo[oid]
+        if commit.parents:
+            for patch in commit.parents[0].tree.diff_to_tree(commit.tree):
+                pass
+
+
+def add_files(repo, paths):
+    index = repo.index
+    index.read()
+    for path in paths:
+        index.add(path)
+    index.write()
+
+
+def run_suite(repo, runs, size):
+    head = repo.head.target
+    history, commits, blobs = sample_objects(repo, head, size)
+    blob_oids = [oid for path, oid in blobs]
+    oids = commits + blob_oids
+    head_tree = repo[head].tree
+
+    result = {
+        'commits': len(history),
+        'sample': len(oids),
+        'lookup_ms': median_ms(lambda: [repo[oid] for oid in oids], runs),
+        'walk_ms': median_ms(
+            lambda: [commit for commit in repo.walk(head, GIT_SORT_TIME)],
+            runs),
+        'walk_signatures_ms': median_ms(
+            lambda: [commit.as_tuple()
+                     for commit in repo.walk(head, GIT_SORT_TIME)],
+            runs),
+        'tree_iterate_ms': median_ms(lambda: iterate_tree(repo, head_tree),
+                                     runs),
+        'tree_walk_ms': median_ms(lambda: list(head_tree.walk()), runs),
+        'diff_parents_ms': median_ms(lambda: diff_patches(repo, commits),
+                                     runs),
+        'diff_deltas_ms': median_ms(
+            lambda: repo[history[-1]].tree.diff_to_tree(head_tree).deltas(),
+            runs),
+        'blob_read_ms': median_ms(
+            lambda: [repo[oid].data for oid in blob_oids], runs),
+        'refs_ms': median_ms(repo.listall_references, runs),
+    }
+
+    if not repo.is_bare:
+        paths = [path for path, oid in blobs]
+        result['status_ms'] = median_ms(repo.status, runs)
+        result['index_add_write_ms'] = median_ms(
+            lambda: add_files(repo, paths), runs)
+
+    return result
+
+
+#
+# Comparison with an earlier run
+#
+def timings(result, prefix=''):
+    for key, value in result.items():
+        if isinstance(value, dict):
+            for item in timings(value, prefix + key + '.'):
+                yield item
+        elif key.endswith('_ms'):
+            yield prefix + key, value
+
+
+def regressions(old, new, tolerance):
+    old = dict(timings(old))
+    slower = []
+    for key, value in sorted(timings(new)):
+        before = old.get(key)
+        if before and value > before * (1 + tolerance / 100.0):
+            slower.append({'timing': key, 'before_ms': before,
+                           'after_ms': value})
+    return slower
+
+
+def main():
+    parser = OptionParser(usage='%prog [--runs N] [--synthetic PATH] '
+                                '[--commits N] [--files N] [--sample N] '
+                                '[--compare FILE] [--tolerance PERCENT]')
+    parser.add_option('--runs', type='int', default=5)
+    parser.add_option('--synthetic')
+    parser.add_option('--commits', type='int', default=1000000)
+    parser.add_option('--files', type='int', default=100000)
+    parser.add_option('--sample', type='int', default=1000)
+    parser.add_option('--import-runs', type='int', default=20)
+    parser.add_option('--compare')
+    parser.add_option('--tolerance', type='float', default=10.0)
+    options, args = parser.parse_args()
+
+    repos = {}
+    tmp = tempfile.mkdtemp(prefix='pygit2-bench-')
+    try:
+        for name in ('testrepo', 'dirtyrepo'):
+            with tarfile.open(os.path.join(DATA, name + '.tar')) as tar:
+                tar.extractall(tmp)
+            repo = Repository(os.path.join(tmp, name))
+            repos[name] = run_suite(repo, options.runs, options.sample)
+
+        path = os.path.join(tmp, 'testrepo.git')
+        shutil.copytree(os.path.join(DATA, 'testrepo.git'), path)
+        repos['testrepo.git'] = run_suite(Repository(path), options.runs,
+                                          options.sample)
+
+        path = options.synthetic or os.path.join(tmp, 'synthetic')
+        start = time.time()
+        repo = open_synthetic(path, options.commits, options.files)
+        generate = time.time() - start
+        repos['synthetic'] = run_suite(repo, options.runs, options.sample)
+        repos['synthetic']['files'] = options.files
+        repos['synthetic']['open_or_generate_s'] = round(generate, 3)
+    finally:
+        shutil.rmtree(tmp)
+
+    # The same measure as bench/import_time.py
+    env = dict(os.environ)
+    env.setdefault('PYTHONPATH', os.getcwd())
+    import_time.sample('import pygit2', 3, env)
+    import_ms = (import_time.sample('import pygit2', options.import_runs, env)
+                 - import_time.sample('pass', options.import_runs, env))
+
+    result = {
+        'benchmark': 'suite',
+        'pygit2': pygit2.__version__,
+        'libgit2': pygit2.LIBGIT2_VERSION,
+        'python': sys.version.split()[0],
+        'runs': options.runs,
+        'import_ms': round(import_ms, 3),
+        'repos': repos,
+    }
+
+    status = 0
+    if options.compare:
+        with open(options.compare) as f:
+            slower = regressions(json.load(f), result, options.tolerance)
+        result['regressions'] = slower
+        status = 1 if slower else 0
+
+    print(json.dumps(result, sort_keys=True))
+    return status
+
+
+if __name__ == '__main__':
+    sys.exit(main())
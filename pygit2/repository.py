@@ -25,15 +25,82 @@
 # the Free Software Foundation, 51 Franklin Street, Fifth Floor,
 # Boston, MA 02110-1301, USA.
 
-# Import from the Standard Library
-from string import hexdigits
-
 # Import from pygit2
 from _pygit2 import Repository as _Repository
 from _pygit2 import GIT_BRANCH_LOCAL, GIT_BRANCH_REMOTE
 from _pygit2 import Oid, GIT_OID_HEXSZ, GIT_OID_MINPREFIXLEN
 from _pygit2 import GIT_CHECKOUT_SAFE_CREATE, GIT_DIFF_NORMAL
-from _pygit2 import Reference, Tree, Commit, Blob
+from _pygit2 import GIT_FILEMODE_BLOB, GIT_FILEMODE_BLOB_EXECUTABLE
+from _pygit2 import Reference, Tree, Commit, Blob, Tag
+
+
+# Same as string.hexdigits; importing the string module would pull in the re
+# module, which more than doubles the time it takes to import pygit2.
+hexdigits = '0123456789abcdefABCDEF'
+
+# The characters with a meaning in a regular expression
+regex_specials = '.^$*+?{}[]()|\\'
+
+
+def grep_literal(pattern):
+    """Return the longest literal string every match of the pattern (bytes)
+    contains, or the empty string if this cannot be told easily.
+
+    Only the text outside of groups and alternatives is looked at, escaped
+    letters (classes, references...) end the literal strings, and a
+    character followed by a quantifier does not count.
+    """
+    # Iterating over latin-1 text gives characters for bytes, on Python 2
+    # and 3 alike, and back to the same bytes
+    pattern = pattern.decode('latin-1')
+    if '|' in pattern or '(?' in pattern:
+        return b''
+
+    best = run = ''
+    depth = 0
+    i, n = 0, len(pattern)
+    while i < n:
+        c = pattern[i]
+        i += 1
+        if c == '\\':
+            # An escaped special character, or a class, a reference...
+            c = pattern[i:i + 1]
+            i += 1
+            if c.isalnum() or not c:
+                c = None
+        elif c == '[':
+            # Skip the set, "]" is a member if first
+            if pattern[i:i + 1] == '^':
+                i += 1
+            if pattern[i:i + 1] == ']':
+                i += 1
+            while i < n and pattern[i] != ']':
+                i += 2 if pattern[i] == '\\' else 1
+            i += 1
+            c = None
+        elif c == '(':
+            depth += 1
+            c = None
+        elif c == ')':
+            depth -= 1
+            c = None
+        elif c in '?*{':
+            # The previous character may be missing
+            if depth == 0 and run:
+                run = run[:-1]
+            if c == '{':
+                i = pattern.find('}', i) + 1 or n
+            c = None
+        elif c in regex_specials:
+            c = None
+
+        if depth == 0 and c is not None:
+            run += c
+        else:
+            best = max(best, run, key=len)
+            run = ''
+
+    return max(best, run, key=len).encode('latin-1')
 
 
 class Repository(_Repository):
@@ -92,6 +159,87 @@ class Repository(_Repository):
         return self.create_reference_symbolic(name, target, force)
 
 
+    def create_references(self, refs, packed=False):
+        """
+        Create many direct references at once. The refs parameter is a
+        dictionary {name: target}, or an iterable of (name, target) pairs,
+        where every target is an Oid or a full hexadecimal id. Existing
+        references are never overridden: if a name is taken, or is the
+        directory of an existing reference (or the other way around), a
+        ValueError is raised and no reference is created.
+
+        Keyword arguments:
+
+        packed
+            If True the references are packed once created, along with the
+            loose references already in the repository, see
+            pack_references().
+
+        Examples::
+
+            repo.create_references({'refs/tags/v1': oid1,
+                                    'refs/tags/v2': oid2}, packed=True)
+        """
+        if isinstance(refs, dict):
+            refs = refs.items()
+
+        # Check everything first, nothing is created if a name is taken
+        targets = []
+        names = set()
+        for name, target in refs:
+            if name in names:
+                raise ValueError(name)
+            if type(target) is not Oid:
+                if len(target) != GIT_OID_HEXSZ:
+                    raise ValueError(target)
+                target = Oid(hex=target)
+            names.add(name)
+            targets.append((name, target))
+
+        existing = set(self.listall_references())
+        for name in names:
+            if name in existing:
+                raise ValueError(name)
+        self._check_ref_directories(existing | names, names)
+
+        # The references are written by libgit2, which keeps its refdb
+        # caches up to date
+        created = []
+        try:
+            for name, target in targets:
+                self.create_reference_direct(name, target, False)
+                created.append(name)
+        except:
+            for name in created:
+                self.lookup_reference(name).delete()
+            raise
+
+        if packed:
+            self.pack_references()
+
+
+    @staticmethod
+    def _check_ref_directories(names, new_names):
+        """Raise ValueError if a new reference name is a directory of
+        another reference (refs/heads/a and refs/heads/a/b), or the other
+        way around."""
+        directories = set()
+        for name in names:
+            i = name.rfind('/')
+            while i > 0 and name[:i] not in directories:
+                directories.add(name[:i])
+                i = name.rfind('/', 0, i)
+
+        for name in new_names:
+            if name in directories:
+                raise ValueError(name)
+            i = name.rfind('/')
+            while i > 0:
+                if name[:i] in names:
+                    raise ValueError(name)
+                i = name.rfind('/', 0, i)
+
+
     #
     # Checkout
     #
@@ -134,11 +282,13 @@ class Repository(_Repository):
     # Diff
     #
     def diff(self, a=None, b=None, cached=False, flags=GIT_DIFF_NORMAL,
-             context_lines=3, interhunk_lines=0):
+             context_lines=3, interhunk_lines=0, pathspec=None, max_size=0,
+             ignore_submodules=False, old_prefix=None, new_prefix=None,
+             force_binary=False):
         """
         Show changes between the working tree and the index or a tree,
         changes between the index and a tree, changes between two trees, or
-        changes between two blobs.
+        changes between two blobs (or a blob and a buffer).
 
         Keyword arguments:
 
@@ -156,6 +306,24 @@ class Repository(_Repository):
             the maximum number of unchanged lines between hunk
             boundaries before the hunks will be merged into a one
 
+        pathspec
+            a list of paths or fnmatch patterns to limit the diff to; the
+            trees outside of them are not looked into (not for blobs)
+
+        max_size
+            the size from which blobs are treated as binary, 0 for the
+            default (not for blobs)
+
+        ignore_submodules
+            leave the submodules out (not for blobs)
+
+        old_prefix, new_prefix
+            the prefixes of the paths in the patches (not for blobs)
+
+        force_binary
+            take every file as binary, never loading their contents (not
+            for blobs)
+
         Examples::
 
           # Changes in the working tree not yet staged for the next commit
@@ -173,6 +341,9 @@ class Repository(_Repository):
           >>> diff(t0, t1)
           >>> diff('HEAD', 'HEAD^') # equivalent
 
+          # Changes between blobs, a Patch
+          >>> diff(repo[blob_oid1], repo[blob_oid2])
+
         If you want to diff a tree against an empty tree, use the low level
         API (Tree.diff_to_tree()) directly.
         """
@@ -192,26 +363,152 @@ class Repository(_Repository):
         a = treeish_to_tree(a) or a
         b = treeish_to_tree(b) or b
 
-        opt_keys = ['flags', 'context_lines', 'interhunk_lines']
-        opt_values = [flags, context_lines, interhunk_lines]
+        blob_options = {'flags': flags, 'context_lines': context_lines,
+                        'interhunk_lines': interhunk_lines}
+        options = dict(blob_options, pathspec=pathspec, max_size=max_size,
+                       ignore_submodules=ignore_submodules,
+                       old_prefix=old_prefix, new_prefix=new_prefix,
+                       force_binary=force_binary)
 
         # Case 1: Diff tree to tree
         if isinstance(a, Tree) and isinstance(b, Tree):
-            return a.diff_to_tree(b, **dict(zip(opt_keys, opt_values)))
+            return a.diff_to_tree(b, **options)
 
         # Case 2: Index to workdir
         elif a is None and b is None:
-            return self.index.diff_to_workdir(*opt_values)
+            return self.index.diff_to_workdir(**options)
 
         # Case 3: Diff tree to index or workdir
         elif isinstance(a, Tree) and b is None:
             if cached:
-                return a.diff_to_index(self.index, *opt_values)
+                return a.diff_to_index(self.index, **options)
             else:
-                return a.diff_to_workdir(*opt_values)
+                return a.diff_to_workdir(**options)
 
-        # Case 4: Diff blob to blob
-        if isinstance(a, Blob) and isinstance(b, Blob):
-            raise NotImplementedError('git_diff_blob_to_blob()')
+        # Case 4: Diff blob to blob, or to a buffer
+        if isinstance(a, Blob) and isinstance(b, (Blob, bytes)):
+            return a.diff(b, **blob_options)
 
         raise ValueError("Only blobs and treeish can be diffed")
+
+
+    #
+    # Grep
+    #
+    def grep(self, treeish, pattern, pathspec=None, workers=1, flags=0):
+        """
+        Search the files of a tree for the lines matching a regular
+        expression, like git grep. Return a list of (path, line_no, line)
+        tuples, in tree order. Line numbers start at 1, and the lines are
+        bytes without their end of line. Binary files, symbolic links and
+        submodules are skipped.
+
+        Keyword arguments:
+
+        treeish
+            a Tree, a Commit, a Tag, a Reference, an Oid or a revision
+            (like 'HEAD')
+
+        pattern
+            the regular expression, as bytes or text (encoded to UTF-8), or
+            already compiled
+
+        pathspec
+            a list of paths (files or directories); only the files within
+            them are searched
+
+        workers
+            the number of threads scanning the blobs
+
+        flags
+            the re flags, if the pattern is not compiled
+
+        The blobs are scanned natively, in place and with the GIL released,
+        for the longest literal string every match must contain (see
+        Repository.grep_blobs). Only the lines containing it are matched
+        against the regular expression, and if the pattern is a plain string
+        even this is skipped.
+
+        Example::
+
+          >>> for path, line_no, line in repo.grep('HEAD', r'TODO\b'):
+          ...     print(path, line_no, line)
+        """
+        # Imported here, the re module is slow to import
+        import re
+        from array import array
+
+        # The tree
+        tree = treeish
+        if isinstance(tree, Oid):
+            tree = self[tree]
+        elif not isinstance(tree, (Tree, Commit, Tag, Reference)):
+            tree = self.revparse_single(tree)
+        if isinstance(tree, Reference):
+            tree = self[tree.resolve().target]
+        while isinstance(tree, Tag):
+            tree = self[tree.target]
+        if isinstance(tree, Commit):
+            tree = tree.tree
+        if not isinstance(tree, Tree):
+            raise ValueError('%r is not a tree' % treeish)
+
+        # The regular expression, on bytes
+        if hasattr(pattern, 'pattern'):
+            flags = pattern.flags
+            pattern = pattern.pattern
+        if not isinstance(pattern, bytes):
+            pattern = pattern.encode('utf-8')
+            flags &= ~re.UNICODE
+        regex = re.compile(pattern, flags)
+
+        literal = b''
+        if not flags & (re.IGNORECASE | re.VERBOSE):
+            literal = grep_literal(pattern)
+        if literal == pattern:
+            regex = None
+
+        # The regular files
+        paths, oids, filemodes = tree.walk(pathspec=pathspec, blobs_only=True,
+                                           bulk=True)
+        files = [i for i, filemode in enumerate(array(str('I'), filemodes))
+                 if filemode in (GIT_FILEMODE_BLOB,
+                                 GIT_FILEMODE_BLOB_EXECUTABLE)]
+        if len(files) < len(paths):
+            paths = [paths[i] for i in files]
+            oids = b''.join([oids[20 * i:20 * i + 20] for i in files])
+
+        # Scan the blobs, a slice by worker
+        count = len(paths)
+        workers = max(1, min(workers, count))
+        step = (count + workers - 1) // workers or 1
+        starts = list(range(0, count, step))
+        results = [None] * len(starts)
+
+        def scan(i):
+            try:
+                chunk = oids[20 * starts[i]:20 * (starts[i] + step)]
+                results[i] = self.grep_blobs(chunk, literal)
+            except Exception as e:
+                results[i] = e
+
+        if len(starts) > 1:
+            import threading
+            threads = [threading.Thread(target=scan, args=(i,))
+                       for i in range(len(starts))]
+            for thread in threads:
+                thread.start()
+            for thread in threads:
+                thread.join()
+        elif starts:
+            scan(0)
+
+        matches = []
+        for start, result in zip(starts, results):
+            if isinstance(result, Exception):
+                raise result
+            for blob, line_no, line in result:
+                if regex is None or regex.search(line):
+                    matches.append((paths[start + blob], line_no, line))
+
+        return matches
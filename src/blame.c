@@ -0,0 +1,722 @@
+/*
+ * Copyright 2010-2013 The pygit2 contributors
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * In addition to the permissions in the GNU General Public License,
+ * the authors give you unlimited permission to link the compiled
+ * version of this file into combinations with other programs,
+ * and to distribute those combinations without any restriction
+ * coming from the use of this file.  (The General Public License
+ * restrictions do apply in other respects; for example, they cover
+ * modification of the file, and distribution when not linked into
+ * a combined executable.)
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stdlib.h>
+#include <string.h>
+#include "error.h"
+#include "oid.h"
+#include "types.h"
+#include "blame.h"
+
+/*
+ * Every suspect is a commit with some lines of the newest version that are
+ * not attributed yet. A suspect passes the lines it did not change on to its
+ * parents, and keeps the others. Suspects are processed newest first, so a
+ * commit reached through many children is processed once.
+ */
+
+typedef struct {
+    size_t final_start;     /* In the newest version */
+    size_t orig_start;      /* In the version of the suspect */
+    size_t count;
+} blame_segment;
+
+typedef struct {
+    git_oid commit;
+    git_time_t time;
+    git_oid blob;
+    blame_segment *segments;
+    size_t count;
+    size_t alloc;
+} blame_suspect;
+
+/* The lines a version shares with its parent: new_start in the version,
+ * old_start in the parent */
+typedef struct {
+    size_t new_start;
+    size_t old_start;
+    size_t count;
+} blame_run;
+
+typedef struct {
+    blame_run *runs;
+    size_t count;
+    size_t alloc;
+    size_t new_line;    /* Past the last hunk, 1 based */
+    size_t old_line;
+    int binary;
+} blame_diff;
+
+struct blame {
+    git_repository *repo;
+    char *path;
+    git_oid oldest;
+    int has_oldest;
+    git_oid newest_blob;
+    size_t line_count;
+    blame_suspect *queue;
+    size_t queue_count;
+    size_t queue_alloc;
+    blame_hunk *results;
+    size_t results_count;
+    size_t results_alloc;
+};
+
+
+static int
+blame_grow(void **items, size_t *alloc, size_t count, size_t size)
+{
+    void *new_items;
+    size_t new_alloc;
+
+    if (count < *alloc)
+        return 0;
+
+    new_alloc = *alloc ? *alloc * 2 : 16;
+    new_items = realloc(*items, new_alloc * size);
+    if (new_items == NULL) {
+        giterr_set_oom();
+        return GIT_ERROR;
+    }
+
+    *items = new_items;
+    *alloc = new_alloc;
+    return 0;
+}
+
+
+static int
+blame_add_segment(blame_suspect *suspect, size_t final_start,
+                  size_t orig_start, size_t count)
+{
+    blame_segment *segment;
+
+    if (blame_grow((void**)&suspect->segments, &suspect->alloc,
+                   suspect->count, sizeof(blame_segment)) < 0)
+        return GIT_ERROR;
+
+    segment = &suspect->segments[suspect->count++];
+    segment->final_start = final_start;
+    segment->orig_start = orig_start;
+    segment->count = count;
+    return 0;
+}
+
+
+/* The suspect of the given commit, added to the queue if missing */
+static int
+blame_suspect_get(blame_suspect **out, blame *blame, const git_commit *commit,
+                  const git_oid *blob)
+{
+    const git_oid *oid = git_commit_id(commit);
+    blame_suspect *suspect;
+    size_t i;
+
+    for (i = 0; i < blame->queue_count; i++) {
+        if (git_oid_cmp(&blame->queue[i].commit, oid) == 0) {
+            *out = &blame->queue[i];
+            return 0;
+        }
+    }
+
+    if (blame_grow((void**)&blame->queue, &blame->queue_alloc,
+                   blame->queue_count, sizeof(blame_suspect)) < 0)
+        return GIT_ERROR;
+
+    suspect = &blame->queue[blame->queue_count++];
+    memset(suspect, 0, sizeof(blame_suspect));
+    git_oid_cpy(&suspect->commit, oid);
+    git_oid_cpy(&suspect->blob, blob);
+    suspect->time = git_commit_time(commit);
+    *out = suspect;
+    return 0;
+}
+
+
+static int
+blame_resolve(blame *blame, const blame_suspect *suspect, int boundary)
+{
+    const blame_segment *segment;
+    blame_hunk *hunk;
+    size_t i;
+
+    for (i = 0; i < suspect->count; i++) {
+        segment = &suspect->segments[i];
+        if (segment->count == 0)
+            continue;
+
+        if (blame_grow((void**)&blame->results, &blame->results_alloc,
+                       blame->results_count, sizeof(blame_hunk)) < 0)
+            return GIT_ERROR;
+
+        hunk = &blame->results[blame->results_count++];
+        hunk->final_start = segment->final_start;
+        hunk->lines = segment->count;
+        git_oid_cpy(&hunk->commit, &suspect->commit);
+        hunk->orig_start = segment->orig_start;
+        hunk->boundary = boundary;
+    }
+
+    return 0;
+}
+
+
+static size_t
+blame_count_lines(const git_blob *blob)
+{
+    const char *data = git_blob_rawcontent(blob);
+    size_t size = (size_t)git_blob_rawsize(blob);
+    size_t i, lines = 0;
+
+    for (i = 0; i < size; i++)
+        if (data[i] == '\n')
+            lines++;
+
+    /* The last line may have no newline */
+    if (size > 0 && data[size - 1] != '\n')
+        lines++;
+
+    return lines;
+}
+
+
+/*
+ * Diff of a version with its parent, as the runs of common lines
+ */
+
+static int
+blame_diff_file_cb(const git_diff_delta *delta, float progress, void *payload)
+{
+    blame_diff *diff = payload;
+
+    if (delta->flags & GIT_DIFF_FLAG_BINARY)
+        diff->binary = 1;
+    return 0;
+}
+
+static int
+blame_diff_add_run(blame_diff *diff, size_t new_end, size_t old_end)
+{
+    blame_run *run;
+
+    if (new_end > diff->new_line) {
+        if (blame_grow((void**)&diff->runs, &diff->alloc, diff->count,
+                       sizeof(blame_run)) < 0)
+            return -1;
+        run = &diff->runs[diff->count++];
+        run->new_start = diff->new_line;
+        run->old_start = diff->old_line;
+        run->count = new_end - diff->new_line;
+    }
+
+    diff->new_line = new_end;
+    diff->old_line = old_end;
+    return 0;
+}
+
+static int
+blame_diff_hunk_cb(const git_diff_delta *delta, const git_diff_range *range,
+                   const char *header, size_t header_len, void *payload)
+{
+    blame_diff *diff = payload;
+    size_t new_first, old_first;
+
+    /* Without lines, the start is the line before the change */
+    new_first = range->new_lines ? range->new_start : range->new_start + 1;
+    old_first = range->old_lines ? range->old_start : range->old_start + 1;
+
+    /* The lines before the hunk are common, the ones inside are not */
+    if (blame_diff_add_run(diff, new_first, old_first) < 0)
+        return -1;
+    diff->new_line = new_first + range->new_lines;
+    diff->old_line = old_first + range->old_lines;
+    return 0;
+}
+
+static int
+blame_diff_blobs(blame_diff *diff, blame *blame, const git_oid *old_oid,
+                 const git_oid *new_oid)
+{
+    git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+    git_blob *old_blob = NULL, *new_blob = NULL;
+    int err;
+
+    diff->count = 0;
+    diff->new_line = 1;
+    diff->old_line = 1;
+    diff->binary = 0;
+
+    err = git_blob_lookup(&old_blob, blame->repo, old_oid);
+    if (err < 0)
+        goto out;
+    err = git_blob_lookup(&new_blob, blame->repo, new_oid);
+    if (err < 0)
+        goto out;
+
+    opts.context_lines = 0;
+    opts.interhunk_lines = 0;
+    err = git_diff_blobs(old_blob, new_blob, &opts, blame_diff_file_cb,
+                         blame_diff_hunk_cb, NULL, diff);
+    if (err < 0)
+        goto out;
+
+    if (diff->binary) {
+        /* Nothing in common */
+        diff->count = 0;
+    }
+    else {
+        /* The lines after the last hunk */
+        err = blame_diff_add_run(diff, (size_t)-1, (size_t)-1);
+        if (err < 0)
+            err = GIT_ERROR;
+    }
+
+out:
+    git_blob_free(old_blob);
+    git_blob_free(new_blob);
+    return err;
+}
+
+
+/* Move the lines of the suspect that are common with the parent to it, the
+ * suspect keeps the others */
+static int
+blame_pass_common(blame_suspect *suspect, blame_suspect *parent,
+                  const blame_diff *diff)
+{
+    blame_segment *segments = suspect->segments;
+    const blame_segment *segment;
+    const blame_run *run;
+    size_t count = suspect->count;
+    size_t i, j, pos, segment_end, run_end, start, end;
+    int err = 0;
+
+    suspect->segments = NULL;
+    suspect->count = 0;
+    suspect->alloc = 0;
+
+    for (i = 0; i < count && err == 0; i++) {
+        segment = &segments[i];
+        pos = segment->orig_start;
+        segment_end = segment->orig_start + segment->count;
+
+        /* The runs are sorted, and do not overlap */
+        for (j = 0; j < diff->count && pos < segment_end && err == 0; j++) {
+            run = &diff->runs[j];
+            run_end = run->new_start + run->count;
+            if (run_end <= pos)
+                continue;
+            if (run->new_start >= segment_end)
+                break;
+
+            start = pos > run->new_start ? pos : run->new_start;
+            end = segment_end < run_end ? segment_end : run_end;
+            if (start > pos)
+                err = blame_add_segment(suspect,
+                        segment->final_start + (pos - segment->orig_start),
+                        pos, start - pos);
+            if (err == 0)
+                err = blame_add_segment(parent,
+                        segment->final_start + (start - segment->orig_start),
+                        run->old_start + (start - run->new_start),
+                        end - start);
+            pos = end;
+        }
+
+        if (pos < segment_end && err == 0)
+            err = blame_add_segment(suspect,
+                    segment->final_start + (pos - segment->orig_start),
+                    pos, segment_end - pos);
+    }
+
+    free(segments);
+    return err;
+}
+
+
+int
+blame_new(blame **out, git_repository *repo, const char *path,
+          const git_oid *newest, const git_oid *oldest)
+{
+    blame *blame;
+    git_commit *commit = NULL;
+    git_tree *tree = NULL;
+    git_tree_entry *entry = NULL;
+    git_blob *blob = NULL;
+    int err;
+
+    blame = calloc(1, sizeof(struct blame));
+    if (blame == NULL) {
+        giterr_set_oom();
+        return GIT_ERROR;
+    }
+
+    blame->repo = repo;
+    blame->path = strdup(path);
+    if (blame->path == NULL) {
+        giterr_set_oom();
+        err = GIT_ERROR;
+        goto out;
+    }
+
+    if (oldest) {
+        git_oid_cpy(&blame->oldest, oldest);
+        blame->has_oldest = 1;
+    }
+
+    err = git_commit_lookup(&commit, repo, newest);
+    if (err < 0)
+        goto out;
+    err = git_commit_tree(&tree, commit);
+    if (err < 0)
+        goto out;
+    err = git_tree_entry_bypath(&entry, tree, path);
+    if (err < 0)
+        goto out;
+    err = git_blob_lookup(&blob, repo, git_tree_entry_id(entry));
+    if (err < 0)
+        goto out;
+
+    git_oid_cpy(&blame->newest_blob, git_tree_entry_id(entry));
+    blame->line_count = blame_count_lines(blob);
+
+    /* The first suspect, its lines are set by blame_start */
+    err = blame_grow((void**)&blame->queue, &blame->queue_alloc, 0,
+                     sizeof(blame_suspect));
+    if (err < 0)
+        goto out;
+    memset(blame->queue, 0, sizeof(blame_suspect));
+    git_oid_cpy(&blame->queue[0].commit, newest);
+    git_oid_cpy(&blame->queue[0].blob, &blame->newest_blob);
+    blame->queue[0].time = git_commit_time(commit);
+    blame->queue_count = 1;
+
+out:
+    git_blob_free(blob);
+    git_tree_entry_free(entry);
+    git_tree_free(tree);
+    git_commit_free(commit);
+    if (err < 0)
+        blame_free(blame);
+    else
+        *out = blame;
+    return err;
+}
+
+
+void
+blame_free(blame *blame)
+{
+    size_t i;
+
+    for (i = 0; i < blame->queue_count; i++)
+        free(blame->queue[i].segments);
+    free(blame->queue);
+    free(blame->results);
+    free(blame->path);
+    free(blame);
+}
+
+
+size_t
+blame_line_count(blame *blame)
+{
+    return blame->line_count;
+}
+
+
+int
+blame_start(blame *blame, size_t min_line, size_t max_line)
+{
+    size_t i;
+
+    /* No line, like in an empty file: there is nothing to look for */
+    if (max_line < min_line) {
+        for (i = 0; i < blame->queue_count; i++)
+            free(blame->queue[i].segments);
+        blame->queue_count = 0;
+        return 0;
+    }
+
+    return blame_add_segment(&blame->queue[0], min_line, min_line,
+                             max_line - min_line + 1);
+}
+
+
+/* The blob of the path in the given commit, 0 if there is none */
+static int
+blame_blob_in(git_oid *out, blame *blame, git_commit *commit)
+{
+    git_tree *tree;
+    git_tree_entry *entry;
+    int err;
+
+    err = git_commit_tree(&tree, commit);
+    if (err < 0)
+        return err;
+
+    err = git_tree_entry_bypath(&entry, tree, blame->path);
+    git_tree_free(tree);
+    if (err == GIT_ENOTFOUND) {
+        giterr_clear();
+        return 0;
+    }
+    if (err < 0)
+        return err;
+
+    if (git_tree_entry_type(entry) == GIT_OBJ_BLOB) {
+        git_oid_cpy(out, git_tree_entry_id(entry));
+        err = 1;
+    }
+    git_tree_entry_free(entry);
+    return err;
+}
+
+
+int
+blame_step(blame *blame)
+{
+    blame_suspect suspect, *parent_suspect;
+    blame_diff diff = {NULL, 0, 0, 0, 0, 0};
+    git_commit *commit = NULL, *parent = NULL;
+    git_oid blob;
+    unsigned int i, n;
+    size_t newest = 0, j;
+    int err = 0, boundary = 0, found;
+
+    if (blame->queue_count == 0)
+        return 0;
+
+    /* Take the newest suspect out of the queue */
+    for (j = 1; j < blame->queue_count; j++)
+        if (blame->queue[j].time > blame->queue[newest].time)
+            newest = j;
+    suspect = blame->queue[newest];
+    blame->queue[newest] = blame->queue[--blame->queue_count];
+
+    if (blame->has_oldest && git_oid_cmp(&suspect.commit,
+                                         &blame->oldest) == 0) {
+        boundary = 1;
+        goto resolve;
+    }
+
+    err = git_commit_lookup(&commit, blame->repo, &suspect.commit);
+    if (err < 0)
+        goto out;
+
+    /* Like Git, follow the first parent with the same version, if any */
+    n = git_commit_parentcount(commit);
+    for (i = 0; i < n; i++) {
+        err = git_commit_parent(&parent, commit, i);
+        if (err < 0)
+            goto out;
+        found = blame_blob_in(&blob, blame, parent);
+        if (found < 0) {
+            err = found;
+            goto out;
+        }
+        if (found && git_oid_cmp(&blob, &suspect.blob) == 0) {
+            err = blame_suspect_get(&parent_suspect, blame, parent, &blob);
+            for (j = 0; j < suspect.count && err == 0; j++)
+                err = blame_add_segment(parent_suspect,
+                                        suspect.segments[j].final_start,
+                                        suspect.segments[j].orig_start,
+                                        suspect.segments[j].count);
+            goto out;
+        }
+        git_commit_free(parent);
+        parent = NULL;
+    }
+
+    /* Otherwise pass the common lines to every parent, in order */
+    for (i = 0; i < n && suspect.count > 0; i++) {
+        err = git_commit_parent(&parent, commit, i);
+        if (err < 0)
+            goto out;
+        found = blame_blob_in(&blob, blame, parent);
+        if (found < 0) {
+            err = found;
+            goto out;
+        }
+        if (found) {
+            err = blame_diff_blobs(&diff, blame, &blob, &suspect.blob);
+            if (err < 0)
+                goto out;
+            err = blame_suspect_get(&parent_suspect, blame, parent, &blob);
+            if (err < 0)
+                goto out;
+            err = blame_pass_common(&suspect, parent_suspect, &diff);
+            if (err < 0)
+                goto out;
+        }
+        git_commit_free(parent);
+        parent = NULL;
+    }
+
+resolve:
+    err = blame_resolve(blame, &suspect, boundary);
+
+out:
+    git_commit_free(parent);
+    git_commit_free(commit);
+    free(diff.runs);
+    free(suspect.segments);
+    if (err < 0)
+        return err;
+    return blame->queue_count > 0;
+}
+
+
+const blame_hunk *
+blame_results(blame *blame, size_t *count)
+{
+    *count = blame->results_count;
+    return blame->results;
+}
+
+
+static int
+blame_compare_hunks(const void *a, const void *b)
+{
+    const blame_hunk *ha = a, *hb = b;
+
+    if (ha->final_start < hb->final_start)
+        return -1;
+    return ha->final_start > hb->final_start;
+}
+
+void
+blame_coalesce(blame *blame)
+{
+    blame_hunk *hunks = blame->results, *last;
+    size_t i, n = 0;
+
+    qsort(hunks, blame->results_count, sizeof(blame_hunk),
+          blame_compare_hunks);
+
+    for (i = 0; i < blame->results_count; i++) {
+        last = n ? &hunks[n - 1] : NULL;
+        if (last && git_oid_cmp(&last->commit, &hunks[i].commit) == 0 &&
+            last->final_start + last->lines == hunks[i].final_start &&
+            last->orig_start + last->lines == hunks[i].orig_start) {
+            last->lines += hunks[i].lines;
+            continue;
+        }
+        hunks[n++] = hunks[i];
+    }
+
+    blame->results_count = n;
+}
+
+
+/*
+ * Python side
+ */
+
+PyObject *
+wrap_blame_hunk(const blame_hunk *hunk)
+{
+    PyObject *py_commit;
+
+    py_commit = git_oid_to_python(&hunk->commit);
+    if (py_commit == NULL)
+        return NULL;
+
+    return Py_BuildValue("(nnNnN)", (Py_ssize_t)hunk->final_start,
+                         (Py_ssize_t)hunk->lines, py_commit,
+                         (Py_ssize_t)hunk->orig_start,
+                         PyBool_FromLong(hunk->boundary));
+}
+
+
+void
+BlameIter_dealloc(BlameIter *self)
+{
+    blame_free(self->blame);
+    Py_CLEAR(self->owner);
+    PyObject_Del(self);
+}
+
+PyObject *
+BlameIter_iternext(BlameIter *self)
+{
+    const blame_hunk *hunks;
+    size_t count;
+    int err;
+
+    hunks = blame_results(self->blame, &count);
+    while (self->emitted == count && !self->done) {
+        Py_BEGIN_ALLOW_THREADS
+        err = blame_step(self->blame);
+        Py_END_ALLOW_THREADS
+        if (err < 0)
+            return Error_set(err);
+
+        self->done = (err == 0);
+        hunks = blame_results(self->blame, &count);
+    }
+
+    if (self->emitted == count)
+        return NULL;
+
+    return wrap_blame_hunk(&hunks[self->emitted++]);
+}
+
+
+PyDoc_STRVAR(BlameIter__doc__, "Internal incremental blame iterator.");
+
+PyTypeObject BlameIterType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_pygit2.BlameIter",                       /* tp_name           */
+    sizeof(BlameIter),                         /* tp_basicsize      */
+    0,                                         /* tp_itemsize       */
+    (destructor)BlameIter_dealloc,             /* tp_dealloc        */
+    0,                                         /* tp_print          */
+    0,                                         /* tp_getattr        */
+    0,                                         /* tp_setattr        */
+    0,                                         /* tp_compare        */
+    0,                                         /* tp_repr           */
+    0,                                         /* tp_as_number      */
+    0,                                         /* tp_as_sequence    */
+    0,                                         /* tp_as_mapping     */
+    0,                                         /* tp_hash           */
+    0,                                         /* tp_call           */
+    0,                                         /* tp_str            */
+    0,                                         /* tp_getattro       */
+    0,                                         /* tp_setattro       */
+    0,                                         /* tp_as_buffer      */
+    Py_TPFLAGS_DEFAULT,                        /* tp_flags          */
+    BlameIter__doc__,                          /* tp_doc            */
+    0,                                         /* tp_traverse       */
+    0,                                         /* tp_clear          */
+    0,                                         /* tp_richcompare    */
+    0,                                         /* tp_weaklistoffset */
+    PyObject_SelfIter,                         /* tp_iter           */
+    (iternextfunc)BlameIter_iternext,          /* tp_iternext       */
+};
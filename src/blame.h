@@ -0,0 +1,71 @@
+/*
+ * Copyright 2010-2013 The pygit2 contributors
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * In addition to the permissions in the GNU General Public License,
+ * the authors give you unlimited permission to link the compiled
+ * version of this file into combinations with other programs,
+ * and to distribute those combinations without any restriction
+ * coming from the use of this file.  (The General Public License
+ * restrictions do apply in other respects; for example, they cover
+ * modification of the file, and distribution when not linked into
+ * a combined executable.)
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDE_pygit2_blame_h
+#define INCLUDE_pygit2_blame_h
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <git2.h>
+
+/* A run of lines of the newest version, and the commit that last changed
+ * them. Line numbers start at 1. */
+typedef struct {
+    size_t final_start;
+    size_t lines;
+    git_oid commit;
+    size_t orig_start;  /* The first line in that commit */
+    int boundary;       /* The lines are older than the oldest commit */
+} blame_hunk;
+
+/*
+ * The blame engine does not touch Python objects, it may run with the GIL
+ * released. Create it with blame_new, then start it on a range of lines
+ * (see blame_line_count) and run blame_step until it returns 0. The hunks
+ * are appended to the results as they are resolved, in no particular order.
+ */
+typedef struct blame blame;
+
+int blame_new(blame **out, git_repository *repo, const char *path,
+              const git_oid *newest, const git_oid *oldest);
+void blame_free(blame *blame);
+
+size_t blame_line_count(blame *blame);
+int blame_start(blame *blame, size_t min_line, size_t max_line);
+
+/* Returns 1 if there is more to do, 0 when done, or an error code */
+int blame_step(blame *blame);
+
+const blame_hunk *blame_results(blame *blame, size_t *count);
+
+/* Sort the results by line, and merge the adjacent hunks of a commit */
+void blame_coalesce(blame *blame);
+
+/* (final_start, lines, commit, orig_start, boundary) */
+PyObject *wrap_blame_hunk(const blame_hunk *hunk);
+
+#endif
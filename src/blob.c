@@ -27,10 +27,17 @@
 
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <string.h>
+#include "error.h"
 #include "utils.h"
 #include "object.h"
 #include "blob.h"
 
+extern PyTypeObject PatchType;
+extern PyTypeObject HunkType;
+
+PyTypeObject BlobType;
+
 
 PyDoc_STRVAR(Blob_size__doc__, "Size.");
 
@@ -41,6 +48,326 @@ Blob_size__get__(Blob *self)
 }
 
 
+/*
+ * Blob.diff collects the hunks and lines with the GIL released, and builds
+ * the Patch once it is done.
+ */
+typedef struct {
+    git_diff_range range;
+    size_t first_line;
+    size_t header_offset;
+    size_t header_len;
+} blob_diff_hunk;
+
+typedef struct {
+    char origin;
+    size_t offset;
+    size_t len;
+} blob_diff_line;
+
+typedef struct {
+    git_delta_t status;
+    int binary;
+    blob_diff_hunk *hunks;
+    size_t hunk_count;
+    size_t hunk_alloc;
+    blob_diff_line *lines;
+    size_t line_count;
+    size_t line_alloc;
+    char *text;
+    size_t text_len;
+    size_t text_alloc;
+} blob_diff;
+
+/* Make room for n more items */
+static int
+blob_diff_grow(void **items, size_t *alloc, size_t count, size_t n,
+               size_t size)
+{
+    size_t new_alloc = *alloc ? *alloc : 64;
+    void *new_items;
+
+    if (count + n <= *alloc)
+        return 0;
+
+    while (new_alloc < count + n)
+        new_alloc *= 2;
+    new_items = realloc(*items, new_alloc * size);
+    if (new_items == NULL) {
+        giterr_set_oom();
+        return GIT_ERROR;
+    }
+
+    *items = new_items;
+    *alloc = new_alloc;
+    return 0;
+}
+
+static int
+blob_diff_file_cb(const git_diff_delta *delta, float progress, void *payload)
+{
+    blob_diff *diff = payload;
+
+    diff->status = delta->status;
+    diff->binary = (delta->flags & GIT_DIFF_FLAG_BINARY) != 0;
+    return 0;
+}
+
+static int
+blob_diff_hunk_cb(const git_diff_delta *delta, const git_diff_range *range,
+                  const char *header, size_t header_len, void *payload)
+{
+    blob_diff *diff = payload;
+
+    blob_diff_hunk *hunk;
+
+    if (blob_diff_grow((void **)&diff->hunks, &diff->hunk_alloc,
+                       diff->hunk_count, 1, sizeof(blob_diff_hunk)) < 0 ||
+        blob_diff_grow((void **)&diff->text, &diff->text_alloc,
+                       diff->text_len, header_len, 1) < 0)
+        return GIT_ERROR;
+
+    hunk = &diff->hunks[diff->hunk_count++];
+    hunk->range = *range;
+    hunk->first_line = diff->line_count;
+    hunk->header_offset = diff->text_len;
+    hunk->header_len = header_len;
+    memcpy(diff->text + diff->text_len, header, header_len);
+    diff->text_len += header_len;
+    return 0;
+}
+
+static int
+blob_diff_data_cb(const git_diff_delta *delta, const git_diff_range *range,
+                  char line_origin, const char *content, size_t content_len,
+                  void *payload)
+{
+    blob_diff *diff = payload;
+    blob_diff_line *line;
+
+    if (blob_diff_grow((void **)&diff->lines, &diff->line_alloc,
+                       diff->line_count, 1, sizeof(blob_diff_line)) < 0 ||
+        blob_diff_grow((void **)&diff->text, &diff->text_alloc,
+                       diff->text_len, content_len, 1) < 0)
+        return GIT_ERROR;
+
+    line = &diff->lines[diff->line_count++];
+    line->origin = line_origin;
+    line->offset = diff->text_len;
+    line->len = content_len;
+    memcpy(diff->text + diff->text_len, content, content_len);
+    diff->text_len += content_len;
+    return 0;
+}
+
+/* The text of the patch, as git prints it: blobs have no file header */
+static int
+blob_diff_line_prefixed(char origin)
+{
+    return origin == GIT_DIFF_LINE_CONTEXT ||
+           origin == GIT_DIFF_LINE_ADDITION ||
+           origin == GIT_DIFF_LINE_DELETION;
+}
+
+static PyObject *
+blob_diff_to_bytes(blob_diff *diff)
+{
+    PyObject *py_bytes;
+    blob_diff_hunk *hunk;
+    blob_diff_line *line;
+    size_t i, j, end, len;
+    char *out;
+
+    len = diff->text_len;
+    for (j = 0; j < diff->line_count; j++)
+        len += blob_diff_line_prefixed(diff->lines[j].origin);
+
+    py_bytes = PyBytes_FromStringAndSize(NULL, len);
+    if (py_bytes == NULL)
+        return NULL;
+
+    out = PyBytes_AS_STRING(py_bytes);
+    for (i = 0; i < diff->hunk_count; i++) {
+        hunk = &diff->hunks[i];
+        memcpy(out, diff->text + hunk->header_offset, hunk->header_len);
+        out += hunk->header_len;
+
+        end = i + 1 < diff->hunk_count ? diff->hunks[i + 1].first_line :
+                                         diff->line_count;
+        for (j = hunk->first_line; j < end; j++) {
+            line = &diff->lines[j];
+            if (blob_diff_line_prefixed(line->origin))
+                *out++ = line->origin;
+            memcpy(out, diff->text + line->offset, line->len);
+            out += line->len;
+        }
+    }
+
+    return py_bytes;
+}
+
+static PyObject *
+blob_diff_to_patch(blob_diff *diff, const git_oid *old_oid,
+                   const git_oid *new_oid)
+{
+    Patch *py_patch;
+    Hunk *py_hunk;
+    PyObject *py_line;
+    blob_diff_line *line;
+    size_t i, j, end;
+
+    py_patch = PyObject_New(Patch, &PatchType);
+    if (py_patch == NULL)
+        return NULL;
+
+    /* Blobs have no paths */
+    py_patch->old_file_path = NULL;
+    py_patch->new_file_path = NULL;
+    py_patch->status = git_diff_status_char(diff->status);
+    py_patch->similarity = 0;
+    py_patch->binary = (char)diff->binary;
+    py_patch->diff = NULL;
+    py_patch->idx = 0;
+    py_patch->text = NULL;
+    py_patch->old_oid = git_oid_allocfmt(old_oid);
+    py_patch->new_oid = git_oid_allocfmt(new_oid);
+    py_patch->hunks = PyList_New(diff->hunk_count);
+    if (py_patch->hunks == NULL)
+        goto error;
+    py_patch->text = blob_diff_to_bytes(diff);
+    if (py_patch->text == NULL)
+        goto error;
+
+    for (i = 0; i < diff->hunk_count; i++) {
+        py_hunk = PyObject_New(Hunk, &HunkType);
+        if (py_hunk == NULL)
+            goto error;
+        py_hunk->old_start = diff->hunks[i].range.old_start;
+        py_hunk->old_lines = diff->hunks[i].range.old_lines;
+        py_hunk->new_start = diff->hunks[i].range.new_start;
+        py_hunk->new_lines = diff->hunks[i].range.new_lines;
+        PyList_SET_ITEM(py_patch->hunks, i, (PyObject*)py_hunk);
+
+        end = i + 1 < diff->hunk_count ? diff->hunks[i + 1].first_line :
+                                         diff->line_count;
+        py_hunk->lines = PyList_New(end - diff->hunks[i].first_line);
+        if (py_hunk->lines == NULL)
+            goto error;
+
+        for (j = diff->hunks[i].first_line; j < end; j++) {
+            line = &diff->lines[j];
+            py_line = Py_BuildValue(
+            #if PY_MAJOR_VERSION == 2
+                "(Ns#)",
+            #else
+                "(Ny#)",
+            #endif
+                to_unicode_n(&line->origin, 1, NULL, NULL),
+                diff->text + line->offset, (Py_ssize_t)line->len);
+            if (py_line == NULL)
+                goto error;
+            PyList_SET_ITEM(py_hunk->lines, j - diff->hunks[i].first_line,
+                            py_line);
+        }
+    }
+
+    return (PyObject*)py_patch;
+
+error:
+    Py_DECREF(py_patch);
+    return NULL;
+}
+
+
+PyDoc_STRVAR(Blob_diff__doc__,
+  "diff([other, flags, context_lines, interhunk_lines]) -> Patch\n"
+  "\n"
+  "Diff this blob to another blob, to a buffer (bytes) or, if other is\n"
+  "None, to nothing. No tree is involved, the patch has no paths. Unlike\n"
+  "those of a Diff, the lines of the hunks are (origin, bytes) tuples.\n"
+  "\n"
+  "Arguments:\n"
+  "\n"
+  "other: a Blob, a bytes string or None (the default).\n"
+  "\n"
+  "flags: a GIT_DIFF_* constant.\n"
+  "\n"
+  "context_lines: the number of unchanged lines that define the boundary\n"
+  "   of a hunk (and to display before and after).\n"
+  "\n"
+  "interhunk_lines: the maximum number of unchanged lines between hunk\n"
+  "   boundaries before the hunks will be merged into a one.\n"
+  "\n"
+  "The GIL is released during the diff.");
+
+PyObject *
+Blob_diff(Blob *self, PyObject *args, PyObject *kwds)
+{
+    char *keywords[] = {"other", "flags", "context_lines", "interhunk_lines",
+                        NULL};
+    git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+    PyObject *py_other = Py_None, *py_patch;
+    git_blob *other = NULL;
+    git_oid old_oid, new_oid;
+    blob_diff diff;
+    char *buffer = NULL;
+    Py_ssize_t buffer_len = 0;
+    int err;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OIHH", keywords,
+                                     &py_other, &opts.flags,
+                                     &opts.context_lines,
+                                     &opts.interhunk_lines))
+        return NULL;
+
+    git_oid_cpy(&old_oid, git_object_id((git_object*)self->blob));
+    memset(&new_oid, 0, sizeof(git_oid));
+    if (PyObject_TypeCheck(py_other, &BlobType)) {
+        other = ((Blob*)py_other)->blob;
+        git_oid_cpy(&new_oid, git_object_id((git_object*)other));
+    }
+    else if (PyBytes_Check(py_other)) {
+        if (PyBytes_AsStringAndSize(py_other, &buffer, &buffer_len) < 0)
+            return NULL;
+        err = git_odb_hash(&new_oid, buffer, buffer_len, GIT_OBJ_BLOB);
+        if (err < 0)
+            return Error_set(err);
+    }
+    else if (py_other != Py_None) {
+        PyErr_SetString(PyExc_TypeError, "expected a Blob, bytes or None");
+        return NULL;
+    }
+
+    memset(&diff, 0, sizeof(blob_diff));
+    diff.status = GIT_DELTA_UNMODIFIED;
+
+    Py_BEGIN_ALLOW_THREADS
+    if (buffer != NULL)
+        err = git_diff_blob_to_buffer(self->blob, buffer, buffer_len, &opts,
+                                      blob_diff_file_cb, blob_diff_hunk_cb,
+                                      blob_diff_data_cb, &diff);
+    else
+        err = git_diff_blobs(self->blob, other, &opts, blob_diff_file_cb,
+                             blob_diff_hunk_cb, blob_diff_data_cb, &diff);
+    Py_END_ALLOW_THREADS
+
+    if (err < 0)
+        py_patch = Error_set(err);
+    else
+        py_patch = blob_diff_to_patch(&diff, &old_oid, &new_oid);
+
+    free(diff.hunks);
+    free(diff.lines);
+    free(diff.text);
+    return py_patch;
+}
+
+PyMethodDef Blob_methods[] = {
+    METHOD(Blob, diff, METH_VARARGS | METH_KEYWORDS),
+    {NULL}
+};
+
+
 PyDoc_STRVAR(Blob_data__doc__,
   "The contents of the blob, a bytes string. This is the same as\n"
   "Blob.read_raw()");
@@ -82,7 +409,7 @@ PyTypeObject BlobType = {
     0,                                         /* tp_weaklistoffset */
     0,                                         /* tp_iter           */
     0,                                         /* tp_iternext       */
-    0,                                         /* tp_methods        */
+    Blob_methods,                              /* tp_methods        */
     0,                                         /* tp_members        */
     Blob_getseters,                            /* tp_getset         */
     0,                                         /* tp_base           */
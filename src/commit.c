@@ -91,18 +91,105 @@ Commit_commit_time_offset__get__(Commit *commit)
 }
 
 
-PyDoc_STRVAR(Commit_committer__doc__, "The committer of the commit.");
+/*
+ * The signatures of a commit are built on first access and kept.  They own
+ * a copy of the git_signature: a reference to the commit would be a cycle.
+ * Their names and emails are looked up in the strings of the repository, so
+ * the commits of a walk share them instead of holding a copy each.
+ */
+static int
+commit_intern(Repository *repo, PyObject **str)
+{
+    PyObject *interned;
 
-PyObject *
-Commit_committer__get__(Commit *self)
+    if (repo->strings == NULL) {
+        repo->strings = PyDict_New();
+        if (repo->strings == NULL)
+            return -1;
+    }
+
+    interned = PyDict_GetItem(repo->strings, *str);
+    if (interned == NULL)
+        return PyDict_SetItem(repo->strings, *str, *str);
+
+    Py_INCREF(interned);
+    Py_DECREF(*str);
+    *str = interned;
+    return 0;
+}
+
+static Signature *
+commit_signature(Commit *self, PyObject **cache,
+                 const git_signature *signature)
 {
-    const git_signature *signature;
+    Signature *py_signature;
+    git_signature *copy;
     const char *encoding;
+    char *owned_encoding = NULL;
+
+    if (*cache != NULL)
+        return (Signature*)*cache;
+
+    copy = git_signature_dup(signature);
+    if (copy == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
 
-    signature = git_commit_committer(self->commit);
     encoding = git_commit_message_encoding(self->commit);
+    if (encoding != NULL) {
+        owned_encoding = strdup(encoding);
+        if (owned_encoding == NULL) {
+            git_signature_free(copy);
+            PyErr_NoMemory();
+            return NULL;
+        }
+    }
+
+    py_signature = (Signature*)build_signature(NULL, copy, owned_encoding);
+    if (py_signature == NULL) {
+        git_signature_free(copy);
+        free(owned_encoding);
+        return NULL;
+    }
 
-    return build_signature((Object*)self, signature, encoding);
+    /* Those which do not decode raise from the getters, as before */
+    if (self->repo != NULL) {
+        py_signature->name = to_unicode(copy->name, owned_encoding,
+                                        "strict");
+        if (py_signature->name == NULL)
+            PyErr_Clear();
+        else if (commit_intern(self->repo, &py_signature->name) < 0)
+            goto error;
+
+        py_signature->email = to_unicode(copy->email, owned_encoding,
+                                         "strict");
+        if (py_signature->email == NULL)
+            PyErr_Clear();
+        else if (commit_intern(self->repo, &py_signature->email) < 0)
+            goto error;
+    }
+
+    *cache = (PyObject*)py_signature;
+    return py_signature;
+
+error:
+    Py_DECREF(py_signature);
+    return NULL;
+}
+
+
+PyDoc_STRVAR(Commit_committer__doc__, "The committer of the commit.");
+
+PyObject *
+Commit_committer__get__(Commit *self)
+{
+    PyObject *py_signature;
+
+    py_signature = (PyObject*)commit_signature(
+        self, &self->committer, git_commit_committer(self->commit));
+    Py_XINCREF(py_signature);
+    return py_signature;
 }
 
 
@@ -111,13 +198,58 @@ PyDoc_STRVAR(Commit_author__doc__, "The author of the commit.");
 PyObject *
 Commit_author__get__(Commit *self)
 {
-    const git_signature *signature;
-    const char *encoding;
+    PyObject *py_signature;
 
-    signature = git_commit_author(self->commit);
-    encoding = git_commit_message_encoding(self->commit);
+    py_signature = (PyObject*)commit_signature(
+        self, &self->author, git_commit_author(self->commit));
+    Py_XINCREF(py_signature);
+    return py_signature;
+}
+
+
+PyDoc_STRVAR(Commit_as_tuple__doc__,
+  "as_tuple() -> (author_name, author_email, author_time, author_offset,\n"
+  "               committer_name, committer_email, commit_time,\n"
+  "               commit_time_offset)\n"
+  "\n"
+  "Return the signatures of the commit at once, for the programs which read\n"
+  "them from many commits.  The strings are those of the author and\n"
+  "committer attributes, shared by the commits of the repository.");
+
+PyObject *
+Commit_as_tuple(Commit *self)
+{
+    Signature *author, *committer;
+    PyObject *author_name, *author_email, *committer_name, *committer_email;
+
+    author = commit_signature(self, &self->author,
+                              git_commit_author(self->commit));
+    if (author == NULL)
+        return NULL;
+    committer = commit_signature(self, &self->committer,
+                                 git_commit_committer(self->commit));
+    if (committer == NULL)
+        return NULL;
+
+    author_name = Signature_name__get__(author);
+    author_email = author_name ? Signature_email__get__(author) : NULL;
+    committer_name = author_email ? Signature_name__get__(committer) : NULL;
+    committer_email = committer_name ? Signature_email__get__(committer)
+                                     : NULL;
+    if (committer_email == NULL) {
+        Py_XDECREF(author_name);
+        Py_XDECREF(author_email);
+        Py_XDECREF(committer_name);
+        return NULL;
+    }
 
-    return build_signature((Object*)self, signature, encoding);
+    return Py_BuildValue("NNLiNNLi",
+        author_name, author_email,
+        (PY_LONG_LONG)author->signature->when.time,
+        author->signature->when.offset,
+        committer_name, committer_email,
+        (PY_LONG_LONG)committer->signature->when.time,
+        committer->signature->when.offset);
 }
 
 
@@ -192,6 +324,19 @@ Commit_parents__get__(Commit *self)
     return list;
 }
 
+static void
+Commit_dealloc(Commit *self)
+{
+    Py_CLEAR(self->author);
+    Py_CLEAR(self->committer);
+    Object_dealloc((Object*)self);
+}
+
+PyMethodDef Commit_methods[] = {
+    METHOD(Commit, as_tuple, METH_NOARGS),
+    {NULL}
+};
+
 PyGetSetDef Commit_getseters[] = {
     GETTER(Commit, message_encoding),
     GETTER(Commit, message),
@@ -213,7 +358,7 @@ PyTypeObject CommitType = {
     "_pygit2.Commit",                          /* tp_name           */
     sizeof(Commit),                            /* tp_basicsize      */
     0,                                         /* tp_itemsize       */
-    0,                                         /* tp_dealloc        */
+    (destructor)Commit_dealloc,                /* tp_dealloc        */
     0,                                         /* tp_print          */
     0,                                         /* tp_getattr        */
     0,                                         /* tp_setattr        */
@@ -236,7 +381,7 @@ PyTypeObject CommitType = {
     0,                                         /* tp_weaklistoffset */
     0,                                         /* tp_iter           */
     0,                                         /* tp_iternext       */
-    0,                                         /* tp_methods        */
+    Commit_methods,                            /* tp_methods        */
     0,                                         /* tp_members        */
     Commit_getseters,                          /* tp_getset         */
     0,                                         /* tp_base           */
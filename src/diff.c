@@ -31,7 +31,10 @@
 #include "error.h"
 #include "types.h"
 #include "utils.h"
+#include "oid.h"
 #include "diff.h"
+#include "repository.h"
+#include "similarity.h"
 
 extern PyObject *GitError;
 
@@ -43,7 +46,7 @@ extern PyTypeObject HunkType;
 PyTypeObject PatchType;
 
 PyObject*
-wrap_diff(git_diff_list *diff, Repository *repo)
+wrap_diff(git_diff_list *diff, Repository *repo, const diff_options *options)
 {
     Diff *py_diff;
 
@@ -52,14 +55,149 @@ wrap_diff(git_diff_list *diff, Repository *repo)
         Py_INCREF(repo);
         py_diff->repo = repo;
         py_diff->list = diff;
+        py_diff->force_binary = options ? options->force_binary : 0;
+    } else {
+        git_diff_list_free(diff);
     }
 
     return (PyObject*) py_diff;
 }
 
+int
+diff_options_prepare(diff_options *options)
+{
+    PyObject *py_seq;
+    Py_ssize_t i, n;
+    char **strings;
+
+    if (options->max_size < 0) {
+        PyErr_SetString(PyExc_ValueError, "max_size must be positive");
+        return -1;
+    }
+    options->opts.max_size = (git_off_t)options->max_size;
+
+    if (options->ignore_submodules)
+        options->opts.flags |= GIT_DIFF_IGNORE_SUBMODULES;
+
+    /* Without the flag, git_diff_get_patch(NULL, ...) loads the contents
+     * to tell binary files, see deltas(); the patches still look at them */
+    options->opts.flags |= GIT_DIFF_SKIP_BINARY_CHECK;
+
+    if (options->pathspec == NULL || options->pathspec == Py_None)
+        return 0;
+
+    py_seq = PySequence_Fast(options->pathspec, "pathspec must be a list");
+    if (py_seq == NULL)
+        return -1;
+
+    n = PySequence_Fast_GET_SIZE(py_seq);
+    strings = calloc(n > 0 ? n : 1, sizeof(char *));
+    if (strings == NULL) {
+        Py_DECREF(py_seq);
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    options->opts.pathspec.strings = strings;
+    for (i = 0; i < n; i++) {
+        strings[i] = py_path_to_c_str(PySequence_Fast_GET_ITEM(py_seq, i));
+        if (strings[i] == NULL) {
+            Py_DECREF(py_seq);
+            return -1;
+        }
+        options->opts.pathspec.count++;
+    }
+
+    Py_DECREF(py_seq);
+    return 0;
+}
+
+void
+diff_options_free(diff_options *options)
+{
+    size_t i;
+
+    for (i = 0; i < options->opts.pathspec.count; i++)
+        free(options->opts.pathspec.strings[i]);
+    free(options->opts.pathspec.strings);
+    options->opts.pathspec.strings = NULL;
+    options->opts.pathspec.count = 0;
+}
+
+
+/*
+ * The patches are printed by libgit2 one line at a time, they are gathered
+ * in a buffer.  With a write function the buffer is handed to it each time
+ * it is full, so a diff can be written without holding all of it.
+ */
+#define DIFF_PRINT_CHUNK 65536
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t alloc;
+    PyObject *write;
+} diff_print;
+
+static int
+diff_print_flush(diff_print *print)
+{
+    PyObject *py_chunk, *result;
+
+    if (print->len == 0)
+        return 0;
+
+    py_chunk = PyBytes_FromStringAndSize(print->data, print->len);
+    if (py_chunk == NULL)
+        return -1;
+
+    result = PyObject_CallFunctionObjArgs(print->write, py_chunk, NULL);
+    Py_DECREF(py_chunk);
+    if (result == NULL)
+        return -1;
+
+    Py_DECREF(result);
+    print->len = 0;
+    return 0;
+}
+
+static int
+diff_print_cb(const git_diff_delta *delta, const git_diff_range *range,
+              char line_origin, const char *content, size_t content_len,
+              void *payload)
+{
+    diff_print *print = payload;
+    size_t alloc;
+    char *data;
+
+    if (print->write != NULL && print->len + content_len > DIFF_PRINT_CHUNK &&
+        diff_print_flush(print) < 0)
+        return -1;
+
+    if (print->len + content_len > print->alloc) {
+        alloc = print->alloc ? print->alloc : DIFF_PRINT_CHUNK;
+        while (alloc < print->len + content_len)
+            alloc *= 2;
+        data = realloc(print->data, alloc);
+        if (data == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        print->data = data;
+        print->alloc = alloc;
+    }
+
+    memcpy(print->data + print->len, content, content_len);
+    print->len += content_len;
+    return 0;
+}
+
+
 PyObject*
-diff_get_patch_byindex(git_diff_list* list, size_t idx)
+diff_get_patch_byindex(Diff *diff, size_t idx)
 {
+    git_diff_list *list = diff->list;
+    int force_binary = diff->force_binary;
     const git_diff_delta* delta;
     const git_diff_range* range;
     git_diff_patch* patch = NULL;
@@ -71,7 +209,8 @@ diff_get_patch_byindex(git_diff_list* list, size_t idx)
     Patch *py_patch = NULL;
     PyObject *py_line_origin=NULL, *py_line=NULL;
 
-    err = git_diff_get_patch(&patch, &delta, list, idx);
+    /* Without the patch, the contents of the files are not loaded */
+    err = git_diff_get_patch(force_binary ? NULL : &patch, &delta, list, idx);
     if (err < 0)
         return Error_set(err);
 
@@ -83,9 +222,15 @@ diff_get_patch_byindex(git_diff_list* list, size_t idx)
         py_patch->similarity = delta->similarity;
         py_patch->old_oid = git_oid_allocfmt(&delta->old_file.oid);
         py_patch->new_oid = git_oid_allocfmt(&delta->new_file.oid);
-
-
-        hunk_amounts = git_diff_patch_num_hunks(patch);
+        py_patch->binary = force_binary ||
+                           (delta->flags & GIT_DIFF_FLAG_BINARY) != 0;
+        /* The paths belong to the diff */
+        Py_INCREF(diff);
+        py_patch->diff = diff;
+        py_patch->idx = idx;
+        py_patch->text = NULL;
+
+        hunk_amounts = patch ? git_diff_patch_num_hunks(patch) : 0;
         py_patch->hunks = PyList_New(hunk_amounts);
         for (i=0; i < hunk_amounts; ++i) {
             err = git_diff_patch_get_hunk(&range, &header, &header_len,
@@ -141,6 +286,8 @@ Patch_dealloc(Patch *self)
     free(self->new_oid);
     // we do not have to free old_file_path and new_file_path, they will
     // be freed by git_diff_list_free in Diff_dealloc
+    Py_CLEAR(self->diff);
+    Py_CLEAR(self->text);
     PyObject_Del(self);
 }
 
@@ -151,10 +298,58 @@ PyMemberDef Patch_members[] = {
     MEMBER(Patch, new_oid, T_STRING, "new oid"),
     MEMBER(Patch, status, T_CHAR, "status"),
     MEMBER(Patch, similarity, T_INT, "similarity"),
+    MEMBER(Patch, binary, T_BOOL, "whether the files are binary"),
     MEMBER(Patch, hunks, T_OBJECT, "hunks"),
     {NULL}
 };
 
+PyDoc_STRVAR(Patch_to_bytes__doc__,
+  "to_bytes() -> bytes\n"
+  "\n"
+  "Return the text of the patch, exactly as git prints it.  The patch is\n"
+  "generated again from the diff, it is not kept by the Patch. The diff's\n"
+  "force_binary is not applied: the contents of the files are loaded, and\n"
+  "the hunks printed, unless libgit2 finds the files binary.");
+
+PyObject *
+Patch_to_bytes(Patch *self)
+{
+    const git_diff_delta *delta;
+    git_diff_patch *patch;
+    diff_print print = {NULL, 0, 0, NULL};
+    PyObject *py_bytes = NULL;
+    int err;
+
+    if (self->text != NULL) {
+        Py_INCREF(self->text);
+        return self->text;
+    }
+
+    err = git_diff_get_patch(&patch, &delta, self->diff->list, self->idx);
+    if (err < 0)
+        return Error_set(err);
+
+    /* libgit2 makes no patch for the deltas it skips */
+    if (patch == NULL)
+        return PyBytes_FromStringAndSize("", 0);
+
+    err = git_diff_patch_print(patch, diff_print_cb, &print);
+    git_diff_patch_free(patch);
+    if (err == 0)
+        py_bytes = PyBytes_FromStringAndSize(print.data ? print.data : "",
+                                             print.len);
+    else if (err != GIT_EUSER)
+        Error_set(err);
+
+    free(print.data);
+    return py_bytes;
+}
+
+static PyMethodDef Patch_methods[] = {
+    METHOD(Patch, to_bytes, METH_NOARGS),
+    {NULL}
+};
+
 PyDoc_STRVAR(Patch__doc__, "Diff patch object.");
 
 PyTypeObject PatchType = {
@@ -185,7 +380,7 @@ PyTypeObject PatchType = {
     0,                                         /* tp_weaklistoffset */
     0,                                         /* tp_iter           */
     0,                                         /* tp_iternext       */
-    0,                                         /* tp_methods        */
+    Patch_methods,                             /* tp_methods        */
     Patch_members,                             /* tp_members        */
     0,                                         /* tp_getset         */
     0,                                         /* tp_base           */
@@ -203,7 +398,7 @@ PyObject *
 DiffIter_iternext(DiffIter *self)
 {
     if (self->i < self->n)
-        return diff_get_patch_byindex(self->diff->list, self->i++);
+        return diff_get_patch_byindex(self->diff, self->i++);
 
     PyErr_SetNone(PyExc_StopIteration);
     return NULL;
@@ -250,47 +445,59 @@ PyTypeObject DiffIterType = {
 };
 
 
-PyDoc_STRVAR(Diff_patch__doc__, "Patch diff string.");
+PyDoc_STRVAR(Diff_patch__doc__,
+  "Patch diff string. Like write_patch, it ignores force_binary.");
 
 PyObject *
 Diff_patch__get__(Diff *self)
 {
-    const git_diff_delta* delta;
-    git_diff_patch* patch;
-    char **strings = NULL;
-    char *buffer = NULL;
-    int err = GIT_ERROR;
-    size_t i, len, num;
+    diff_print print = {NULL, 0, 0, NULL};
     PyObject *py_patch = NULL;
+    int err;
 
-    num = git_diff_num_deltas(self->list);
-    MALLOC(strings, num * sizeof(char*), cleanup);
+    err = git_diff_print_patch(self->list, diff_print_cb, &print);
+    if (err == 0)
+        py_patch = to_unicode_n(print.data ? print.data : "", print.len,
+                                NULL, NULL);
+    else if (err != GIT_EUSER)
+        Error_set(err);
 
-    for (i = 0, len = 1; i < num ; ++i) {
-        err = git_diff_get_patch(&patch, &delta, self->list, i);
-        if (err < 0)
-            goto cleanup;
+    free(print.data);
+    return py_patch;
+}
 
-        err = git_diff_patch_to_str(&(strings[i]), patch);
-        if (err < 0)
-            goto cleanup;
 
-        len += strlen(strings[i]);
-        git_diff_patch_free(patch);
-    }
+PyDoc_STRVAR(Diff_write_patch__doc__,
+  "write_patch(file)\n"
+  "\n"
+  "Write the patch of the diff to the given file, opened in binary mode.\n"
+  "The patch is written as it is generated, by chunks, and unlike the\n"
+  "patch attribute it is not decoded: the contents of the files are kept\n"
+  "byte for byte. force_binary is not applied to the patch: the contents\n"
+  "of the files are loaded, and binary files told by libgit2.");
 
-    CALLOC(buffer, (len + 1), sizeof(char), cleanup);
-    for (i = 0; i < num; ++i) {
-        strcat(buffer, strings[i]);
-        free(strings[i]);
-    }
-    free(strings);
+PyObject *
+Diff_write_patch(Diff *self, PyObject *py_file)
+{
+    diff_print print = {NULL, 0, 0, NULL};
+    int err;
 
-    py_patch = to_unicode(buffer, NULL, NULL);
-    free(buffer);
+    print.write = PyObject_GetAttrString(py_file, "write");
+    if (print.write == NULL)
+        return NULL;
 
-cleanup:
-    return (err < 0) ? Error_set(err) : py_patch;
+    err = git_diff_print_patch(self->list, diff_print_cb, &print);
+    if (err == 0 && diff_print_flush(&print) < 0)
+        err = GIT_EUSER;
+
+    Py_DECREF(print.write);
+    free(print.data);
+    if (err == GIT_EUSER)
+        return NULL;
+    if (err < 0)
+        return Error_set(err);
+
+    Py_RETURN_NONE;
 }
 
 
@@ -380,21 +587,339 @@ Diff_merge(Diff *self, PyObject *args)
 }
 
 
-PyDoc_STRVAR(Diff_find_similar__doc__,
-  "find_similar([flags])\n"
+/* Whether the side of the delta is missing: the old side of an added file,
+ * the new side of a deleted one */
+static int
+diff_side_missing(const git_diff_delta *delta, int side)
+{
+    if (side == 0)
+        return delta->status == GIT_DELTA_ADDED ||
+               delta->status == GIT_DELTA_UNTRACKED;
+    return delta->status == GIT_DELTA_DELETED;
+}
+
+PyDoc_STRVAR(Diff_deltas__doc__,
+  "deltas() -> [(status, old_path, new_path, old_oid, new_oid, old_size,\n"
+  "              new_size, binary), ...]\n"
   "\n"
-  "Find renamed files in diff and updates them in-place in the diff itself.");
+  "Return the changed files, without their patches: the contents of the\n"
+  "files are never loaded, so this stays cheap with large or binary\n"
+  "files. The status is a character, as Patch.status. The sizes of the\n"
+  "blobs are read from the headers of the objects. The old side of an\n"
+  "added file, and the new side of a deleted file, are None, and so is\n"
+  "the oid of a file of the workdir not hashed yet. Binary is True with\n"
+  "force_binary, else True or False if already known (from the attributes,\n"
+  "or the patch of the file made earlier), else None.");
 
 PyObject *
-Diff_find_similar(Diff *self, PyObject *args)
+Diff_deltas(Diff *self)
 {
+    const git_diff_delta *delta;
+    const git_diff_file *file;
+    git_odb *odb;
+    git_otype type;
+    size_t i, j, n, *sizes, len;
+    PyObject *py_result = NULL, *py_delta, *py_binary, *py_files[6];
+    char status;
+    int err = 0;
+
+    err = git_repository_odb(&odb, self->repo->repo);
+    if (err < 0)
+        return Error_set(err);
+
+    n = git_diff_num_deltas(self->list);
+    sizes = malloc((n > 0 ? n : 1) * 2 * sizeof(size_t));
+    if (sizes == NULL) {
+        git_odb_free(odb);
+        return PyErr_NoMemory();
+    }
+
+    /* The sizes, with the GIL released */
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < n && err == 0; i++) {
+        err = git_diff_get_patch(NULL, &delta, self->list, i);
+        for (j = 0; j < 2 && err == 0; j++) {
+            file = j == 0 ? &delta->old_file : &delta->new_file;
+            sizes[2 * i + j] = (size_t)file->size;
+            if (file->size > 0 || git_oid_iszero(&file->oid) ||
+                diff_side_missing(delta, (int)j))
+                continue;
+
+            err = git_odb_read_header(&len, &type, odb, &file->oid);
+            if (err == 0) {
+                sizes[2 * i + j] = len;
+            }
+            else if (err == GIT_ENOTFOUND) {
+                /* Not in the odb, like a file of the workdir */
+                giterr_clear();
+                err = 0;
+            }
+        }
+    }
+    Py_END_ALLOW_THREADS
+    git_odb_free(odb);
+    if (err < 0) {
+        Error_set(err);
+        goto out;
+    }
+
+    py_result = PyList_New(n);
+    for (i = 0; i < n && py_result != NULL; i++) {
+        git_diff_get_patch(NULL, &delta, self->list, i);
+        for (j = 0; j < 2; j++) {
+            file = j == 0 ? &delta->old_file : &delta->new_file;
+            if (diff_side_missing(delta, (int)j)) {
+                py_files[j] = Py_None;
+                py_files[2 + j] = Py_None;
+                py_files[4 + j] = Py_None;
+                Py_INCREF(Py_None);
+                Py_INCREF(Py_None);
+                Py_INCREF(Py_None);
+                continue;
+            }
+
+            py_files[j] = to_path(file->path);
+            if (git_oid_iszero(&file->oid)) {
+                py_files[2 + j] = Py_None;
+                Py_INCREF(Py_None);
+            }
+            else {
+                py_files[2 + j] = git_oid_to_python(&file->oid);
+            }
+            py_files[4 + j] = PyLong_FromSize_t(sizes[2 * i + j]);
+        }
+
+        if (self->force_binary || delta->flags & GIT_DIFF_FLAG_BINARY)
+            py_binary = Py_True;
+        else if (delta->flags & GIT_DIFF_FLAG_NOT_BINARY)
+            py_binary = Py_False;
+        else
+            py_binary = Py_None;
+        Py_INCREF(py_binary);
+
+        status = git_diff_status_char(delta->status);
+        py_delta = Py_BuildValue("(NNNNNNNN)",
+                                 to_unicode_n(&status, 1, NULL, NULL),
+                                 py_files[0], py_files[1], py_files[2],
+                                 py_files[3], py_files[4], py_files[5],
+                                 py_binary);
+        if (py_delta == NULL)
+            Py_CLEAR(py_result);
+        else
+            PyList_SET_ITEM(py_result, i, py_delta);
+    }
+
+out:
+    free(sizes);
+    return py_result;
+}
+
+
+/*
+ * A similarity metric written in Python: the signatures are the contents of
+ * the files, and the metric is called with them. The GIL is held.
+ */
+static int
+diff_py_buffer_signature(void **out, const git_diff_file *file,
+                         const char *buf, size_t len, void *payload)
+{
+    *out = PyBytes_FromStringAndSize(buf, len);
+    return *out == NULL ? GIT_EUSER : 0;
+}
+
+static int
+diff_py_file_signature(void **out, const git_diff_file *file,
+                       const char *path, void *payload)
+{
+    char *buf;
+    size_t len;
     int err;
+
+    err = similarity_read_file(&buf, &len, path);
+    if (err < 0)
+        return err;
+
+    err = diff_py_buffer_signature(out, file, buf, len, payload);
+    free(buf);
+    return err;
+}
+
+static void
+diff_py_free_signature(void *sig, void *payload)
+{
+    Py_XDECREF((PyObject*)sig);
+}
+
+static int
+diff_py_similarity(int *score, void *a, void *b, void *payload)
+{
+    PyObject *py_score;
+    long value;
+
+    py_score = PyObject_CallFunctionObjArgs((PyObject*)payload, a, b, NULL);
+    if (py_score == NULL)
+        return GIT_EUSER;
+
+    value = PyLong_AsLong(py_score);
+    Py_DECREF(py_score);
+    if (value == -1 && PyErr_Occurred())
+        return GIT_EUSER;
+
+    if (value < 0 || value > 100) {
+        PyErr_SetString(PyExc_ValueError,
+                        "the similarity must be between 0 and 100");
+        return GIT_EUSER;
+    }
+
+    *score = (int)value;
+    return 0;
+}
+
+
+PyDoc_STRVAR(Diff_find_similar__doc__,
+  "find_similar([flags, rename_threshold, copy_threshold,\n"
+  "              rename_from_rewrite_threshold, break_rewrite_threshold,\n"
+  "              target_limit, metric, workers])\n"
+  "\n"
+  "Find renamed and copied files in the diff, and update it in-place.\n"
+  "\n"
+  "Arguments:\n"
+  "\n"
+  "flags: GIT_DIFF_FIND_* constants (default GIT_DIFF_FIND_RENAMES).\n"
+  "\n"
+  "rename_threshold, copy_threshold: the similarity (between 0 and 100)\n"
+  "   from which files are renames or copies (default 50).\n"
+  "\n"
+  "rename_from_rewrite_threshold: the similarity under which a modified\n"
+  "   file may be the source of a rename (default 50).\n"
+  "\n"
+  "break_rewrite_threshold: the similarity under which a modification is\n"
+  "   broken into a deletion and an addition (default 60).\n"
+  "\n"
+  "target_limit: the maximum number of files any file is compared with;\n"
+  "   past it, renames and copies are not looked for (default 200, or the\n"
+  "   diff.renameLimit configuration). 0 means the default.\n"
+  "\n"
+  "metric: None (the default) for libgit2's own metric. 'native' for\n"
+  "   git's metric computed natively with the GIL released: the signatures\n"
+  "   of the blobs are cached by the repository, so they are computed once\n"
+  "   for all the diffs; its similarities may differ a little from\n"
+  "   libgit2's. Or else a function metric(old, new) -> int, given the\n"
+  "   contents of the files (bytes), returning their similarity between 0\n"
+  "   and 100.\n"
+  "\n"
+  "workers: with the 'native' metric, the number of threads computing the\n"
+  "   signatures of the files, before they are compared (default 1).");
+
+PyObject *
+Diff_find_similar(Diff *self, PyObject *args, PyObject *kwds)
+{
+    char *keywords[] = {"flags", "rename_threshold", "copy_threshold",
+                        "rename_from_rewrite_threshold",
+                        "break_rewrite_threshold", "target_limit", "metric",
+                        "workers", NULL};
     git_diff_find_options opts = GIT_DIFF_FIND_OPTIONS_INIT;
+    git_diff_similarity_metric py_metric;
+    similarity_metric metric;
+    similarity_cache *cache;
+    PyObject *py_callable = Py_None;
+    int thresholds[4] = {0, 0, 0, 0};
+    Py_ssize_t target_limit = 0;
+    unsigned int workers = 0;
+    char *name;
+    int i, err, native = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|IiiiinOI", keywords,
+                                     &opts.flags, &thresholds[0],
+                                     &thresholds[1], &thresholds[2],
+                                     &thresholds[3], &target_limit,
+                                     &py_callable, &workers))
+        return NULL;
+
+    for (i = 0; i < 4; i++) {
+        if (thresholds[i] < 0 || thresholds[i] > 100) {
+            PyErr_SetString(PyExc_ValueError,
+                            "thresholds must be between 0 and 100");
+            return NULL;
+        }
+    }
+    if (target_limit < 0) {
+        PyErr_SetString(PyExc_ValueError, "target_limit must be positive");
+        return NULL;
+    }
+
+    opts.rename_threshold = (uint16_t)thresholds[0];
+    opts.copy_threshold = (uint16_t)thresholds[1];
+    opts.rename_from_rewrite_threshold = (uint16_t)thresholds[2];
+    opts.break_rewrite_threshold = (uint16_t)thresholds[3];
+    opts.target_limit = (size_t)target_limit;
+
+    if (PyUnicode_Check(py_callable) || PyBytes_Check(py_callable)) {
+        name = py_str_to_c_str(py_callable, NULL);
+        if (name == NULL)
+            return NULL;
+        native = (strcmp(name, "native") == 0);
+        free(name);
+        if (!native) {
+            PyErr_SetString(PyExc_ValueError, "unknown metric");
+            return NULL;
+        }
+    }
+    if (workers > 0 && !native) {
+        PyErr_SetString(PyExc_ValueError, "workers needs the 'native' metric");
+        return NULL;
+    }
+
+    /* libgit2's metric */
+    if (py_callable == Py_None) {
+        Py_BEGIN_ALLOW_THREADS
+        err = git_diff_find_similar(self->list, &opts);
+        Py_END_ALLOW_THREADS
+        if (err < 0)
+            return Error_set(err);
+
+        Py_RETURN_NONE;
+    }
+
+    /* A metric in Python */
+    if (!native) {
+        if (!PyCallable_Check(py_callable)) {
+            PyErr_SetString(PyExc_TypeError, "metric must be callable");
+            return NULL;
+        }
 
-    if (!PyArg_ParseTuple(args, "|i", &opts.flags))
+        py_metric.file_signature = diff_py_file_signature;
+        py_metric.buffer_signature = diff_py_buffer_signature;
+        py_metric.free_signature = diff_py_free_signature;
+        py_metric.similarity = diff_py_similarity;
+        py_metric.payload = py_callable;
+        opts.metric = &py_metric;
+
+        /* libgit2 does not always pass the error of a callback on */
+        err = git_diff_find_similar(self->list, &opts);
+        if (PyErr_Occurred())
+            return NULL;
+        if (err < 0)
+            return Error_set(err);
+
+        Py_RETURN_NONE;
+    }
+
+    /* Git's metric, computed natively */
+    cache = Repository_similarity(self->repo);
+    if (cache == NULL)
         return NULL;
 
+    similarity_metric_init(&metric, cache, opts.flags);
+    opts.metric = &metric.metric;
+
+    /* No flags means renames, unless the configuration tells otherwise */
+    Py_BEGIN_ALLOW_THREADS
+    similarity_prepare(&metric, self->repo->repo, self->list,
+                       opts.flags ? opts.flags : GIT_DIFF_FIND_RENAMES,
+                       workers > 0 ? workers : 1);
     err = git_diff_find_similar(self->list, &opts);
+    Py_END_ALLOW_THREADS
     if (err < 0)
         return Error_set(err);
 
@@ -406,6 +931,7 @@ Diff_iter(Diff *self)
 {
     DiffIter *iter;
 
+    READY_TYPE(DiffIterType, NULL)
     iter = PyObject_New(DiffIter, &DiffIterType);
     if (iter != NULL) {
         Py_INCREF(self);
@@ -426,7 +952,7 @@ Diff_getitem(Diff *self, PyObject *value)
 
     i = PyLong_AsUnsignedLong(value);
 
-    return diff_get_patch_byindex(self->list, i);
+    return diff_get_patch_byindex(self, i);
 }
 
 
@@ -451,7 +977,9 @@ PyMappingMethods Diff_as_mapping = {
 
 static PyMethodDef Diff_methods[] = {
     METHOD(Diff, merge, METH_VARARGS),
-    METHOD(Diff, find_similar, METH_VARARGS),
+    METHOD(Diff, deltas, METH_NOARGS),
+    METHOD(Diff, write_patch, METH_O),
+    METHOD(Diff, find_similar, METH_VARARGS | METH_KEYWORDS),
     {NULL}
 };
 
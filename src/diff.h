@@ -38,9 +38,60 @@
                   PyObject_TypeCheck(_y, _type_y)
 
 
+/*
+ * The options every diff function takes as keywords, after its own:
+ *
+ *   char *keywords[] = {"flags", ..., DIFF_OPTIONS_KEYWORDS, NULL};
+ *   diff_options options = DIFF_OPTIONS_INIT;
+ *
+ *   PyArg_ParseTupleAndKeywords(args, kwds, "|I..." DIFF_OPTIONS_FORMAT,
+ *                               keywords, &options.opts.flags, ...,
+ *                               DIFF_OPTIONS_ARGS(options));
+ *   diff_options_prepare(&options);
+ *   git_diff_...(..., &options.opts);
+ *   diff_options_free(&options);
+ */
+typedef struct {
+    git_diff_options opts;
+    PyObject *pathspec;
+    PY_LONG_LONG max_size;
+    int ignore_submodules;
+    int force_binary;   /* Not for libgit2, see Diff */
+} diff_options;
+
+#define DIFF_OPTIONS_INIT {GIT_DIFF_OPTIONS_INIT, NULL, 0, 0, 0}
+#define DIFF_OPTIONS_KEYWORDS "pathspec", "max_size", "ignore_submodules", \
+                              "old_prefix", "new_prefix", "force_binary"
+#define DIFF_OPTIONS_FORMAT "OLizzi"
+#define DIFF_OPTIONS_ARGS(o) &(o).pathspec, &(o).max_size, \
+                             &(o).ignore_submodules, &(o).opts.old_prefix, \
+                             &(o).opts.new_prefix, &(o).force_binary
+
+#define DIFF_OPTIONS_DOC \
+  "\n" \
+  "pathspec: a list of paths, or fnmatch patterns, to limit the diff to.\n" \
+  "   The trees outside of them are not looked into.\n" \
+  "\n" \
+  "max_size: the size from which blobs are treated as binary, and not\n" \
+  "   loaded (default 512MB).\n" \
+  "\n" \
+  "ignore_submodules: if true, leave the submodules out.\n" \
+  "\n" \
+  "old_prefix, new_prefix: the prefixes of the paths in the patches\n" \
+  "   (default 'a/' and 'b/').\n" \
+  "\n" \
+  "force_binary: if true, take every file as binary: the patches have no\n" \
+  "   hunks, and the contents of the files are not loaded. The text of the\n" \
+  "   patches (Diff.patch, Diff.write_patch, Patch.to_bytes) is the\n" \
+  "   exception, it is printed as without force_binary.\n"
+
+int diff_options_prepare(diff_options *options);
+void diff_options_free(diff_options *options);
+
 PyObject* Diff_changes(Diff *self);
 PyObject* Diff_patch(Diff *self);
 
-PyObject* wrap_diff(git_diff_list *diff, Repository *repo);
+PyObject* wrap_diff(git_diff_list *diff, Repository *repo,
+                    const diff_options *options);
 
 #endif
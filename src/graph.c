@@ -0,0 +1,567 @@
+/*
+ * Copyright 2010-2013 The pygit2 contributors
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * In addition to the permissions in the GNU General Public License,
+ * the authors give you unlimited permission to link the compiled
+ * version of this file into combinations with other programs,
+ * and to distribute those combinations without any restriction
+ * coming from the use of this file.  (The General Public License
+ * restrictions do apply in other respects; for example, they cover
+ * modification of the file, and distribution when not linked into
+ * a combined executable.)
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <pythread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "graph.h"
+
+/* Flags of the nodes, only meaningful during a query */
+#define GRAPH_PARENT1  (1 << 0)
+#define GRAPH_PARENT2  (1 << 1)
+#define GRAPH_STALE    (1 << 2)
+#define GRAPH_RESULT   (1 << 3)
+#define GRAPH_QUEUED   (1 << 4)
+
+typedef struct {
+    git_oid oid;
+    git_time_t time;
+    size_t parents;     /* Offset of the parents in graph->parents */
+    unsigned int parent_count;
+    unsigned int parsed;
+    unsigned int flags;
+} graph_node;
+
+typedef struct {
+    size_t *items;
+    size_t count;
+    size_t alloc;
+} graph_vector;
+
+struct commit_graph {
+    PyThread_type_lock lock;
+    graph_node *nodes;
+    size_t count;
+    size_t alloc;
+    graph_vector parents;
+    /* Open addressing, from oids to node indexes plus one (0 is empty) */
+    size_t *index;
+    size_t index_size;
+    /* Scratch space of a query */
+    git_odb *odb;
+    graph_vector queue;     /* Binary heap, the newest commit first */
+    graph_vector touched;   /* The nodes whose flags must be cleared */
+    graph_vector results;
+};
+
+
+static int
+graph_vector_push(graph_vector *vector, size_t item)
+{
+    size_t alloc;
+    size_t *items;
+
+    if (vector->count == vector->alloc) {
+        alloc = vector->alloc ? vector->alloc * 2 : 64;
+        items = realloc(vector->items, alloc * sizeof(size_t));
+        if (items == NULL) {
+            giterr_set_oom();
+            return GIT_ERROR;
+        }
+        vector->items = items;
+        vector->alloc = alloc;
+    }
+
+    vector->items[vector->count++] = item;
+    return 0;
+}
+
+
+commit_graph *
+commit_graph_new(void)
+{
+    commit_graph *graph;
+
+    graph = calloc(1, sizeof(commit_graph));
+    if (graph == NULL)
+        return NULL;
+
+    graph->lock = PyThread_allocate_lock();
+    if (graph->lock == NULL) {
+        free(graph);
+        return NULL;
+    }
+
+    return graph;
+}
+
+
+void
+commit_graph_free(commit_graph *graph)
+{
+    if (graph == NULL)
+        return;
+
+    PyThread_free_lock(graph->lock);
+    free(graph->nodes);
+    free(graph->parents.items);
+    free(graph->index);
+    free(graph->queue.items);
+    free(graph->touched.items);
+    free(graph->results.items);
+    free(graph);
+}
+
+
+static size_t
+graph_hash(const git_oid *oid)
+{
+    size_t hash;
+
+    /* Oids are already uniformly distributed */
+    memcpy(&hash, oid->id, sizeof(hash));
+    return hash;
+}
+
+
+static size_t *
+graph_index_find(commit_graph *graph, const git_oid *oid)
+{
+    size_t *slot;
+    size_t i, mask = graph->index_size - 1;
+
+    i = graph_hash(oid) & mask;
+    for (;;) {
+        slot = &graph->index[i];
+        if (*slot == 0 || git_oid_cmp(&graph->nodes[*slot - 1].oid, oid) == 0)
+            return slot;
+        i = (i + 1) & mask;
+    }
+}
+
+
+/* Find the node of the given commit, add it (not parsed yet) if missing */
+static int
+graph_node_get(size_t *out, commit_graph *graph, const git_oid *oid)
+{
+    graph_node *nodes;
+    size_t *index, *slot;
+    size_t i, alloc, old_size;
+
+    /* Keep the load of the index under one half */
+    if ((graph->count + 1) * 2 > graph->index_size) {
+        index = graph->index;
+        old_size = graph->index_size;
+        graph->index_size = old_size ? old_size * 2 : 1024;
+        graph->index = calloc(graph->index_size, sizeof(size_t));
+        if (graph->index == NULL) {
+            graph->index = index;
+            graph->index_size = old_size;
+            giterr_set_oom();
+            return GIT_ERROR;
+        }
+        for (i = 0; i < graph->count; i++)
+            *graph_index_find(graph, &graph->nodes[i].oid) = i + 1;
+        free(index);
+    }
+
+    slot = graph_index_find(graph, oid);
+    if (*slot) {
+        *out = *slot - 1;
+        return 0;
+    }
+
+    if (graph->count == graph->alloc) {
+        alloc = graph->alloc ? graph->alloc * 2 : 512;
+        nodes = realloc(graph->nodes, alloc * sizeof(graph_node));
+        if (nodes == NULL) {
+            giterr_set_oom();
+            return GIT_ERROR;
+        }
+        graph->nodes = nodes;
+        graph->alloc = alloc;
+    }
+
+    memset(&graph->nodes[graph->count], 0, sizeof(graph_node));
+    git_oid_cpy(&graph->nodes[graph->count].oid, oid);
+    *slot = graph->count + 1;
+    *out = graph->count++;
+    return 0;
+}
+
+
+/* Read the parents and the committer time of a commit, straight from the
+ * raw object */
+static int
+graph_node_parse(commit_graph *graph, size_t idx)
+{
+    git_odb_object *obj;
+    const char *data, *end, *line, *eol, *p;
+    git_oid parent;
+    size_t parent_idx, offset;
+    unsigned int parent_count = 0;
+    git_time_t time = 0;
+    int err;
+
+    if (graph->nodes[idx].parsed)
+        return 0;
+
+    err = git_odb_read(&obj, graph->odb, &graph->nodes[idx].oid);
+    if (err < 0)
+        return err;
+
+    if (git_odb_object_type(obj) != GIT_OBJ_COMMIT) {
+        git_odb_object_free(obj);
+        giterr_set_str(GITERR_INVALID, "the object is not a commit");
+        return GIT_ERROR;
+    }
+
+    data = git_odb_object_data(obj);
+    end = data + git_odb_object_size(obj);
+    offset = graph->parents.count;
+    for (line = data; line < end && *line != '\n'; line = eol + 1) {
+        eol = memchr(line, '\n', end - line);
+        if (eol == NULL)
+            eol = end;
+
+        if (eol - line >= 7 + GIT_OID_HEXSZ &&
+            memcmp(line, "parent ", 7) == 0) {
+            err = git_oid_fromstrn(&parent, line + 7, GIT_OID_HEXSZ);
+            if (err < 0)
+                break;
+            err = graph_node_get(&parent_idx, graph, &parent);
+            if (err < 0)
+                break;
+            err = graph_vector_push(&graph->parents, parent_idx);
+            if (err < 0)
+                break;
+            parent_count++;
+        }
+        else if (eol - line > 10 && memcmp(line, "committer ", 10) == 0) {
+            /* committer Name <email> time offset */
+            for (p = eol - 1; p > line && *p != '>'; p--);
+            time = (git_time_t)strtoll(p + 1, NULL, 10);
+        }
+    }
+
+    git_odb_object_free(obj);
+    if (err < 0) {
+        graph->parents.count = offset;
+        return err;
+    }
+
+    graph->nodes[idx].parents = offset;
+    graph->nodes[idx].parent_count = parent_count;
+    graph->nodes[idx].time = time;
+    graph->nodes[idx].parsed = 1;
+    return 0;
+}
+
+
+/*
+ * The priority queue, a binary heap with the newest commit first.
+ */
+
+#define GRAPH_NEWER(graph, a, b) \
+    ((graph)->nodes[a].time > (graph)->nodes[b].time)
+
+static int
+graph_queue_push(commit_graph *graph, size_t idx)
+{
+    size_t *heap, i, parent;
+    int err;
+
+    err = graph_vector_push(&graph->queue, idx);
+    if (err < 0)
+        return err;
+
+    heap = graph->queue.items;
+    for (i = graph->queue.count - 1; i > 0; i = parent) {
+        parent = (i - 1) / 2;
+        if (!GRAPH_NEWER(graph, heap[i], heap[parent]))
+            break;
+        heap[i] = heap[parent];
+        heap[parent] = idx;
+    }
+
+    graph->nodes[idx].flags |= GRAPH_QUEUED;
+    return 0;
+}
+
+static size_t
+graph_queue_pop(commit_graph *graph)
+{
+    size_t *heap = graph->queue.items;
+    size_t top, item, i, child, n;
+
+    top = heap[0];
+    n = --graph->queue.count;
+    item = heap[n];
+    for (i = 0; (child = 2 * i + 1) < n; i = child) {
+        if (child + 1 < n && GRAPH_NEWER(graph, heap[child + 1], heap[child]))
+            child++;
+        if (!GRAPH_NEWER(graph, heap[child], item))
+            break;
+        heap[i] = heap[child];
+    }
+    if (n > 0)
+        heap[i] = item;
+
+    graph->nodes[top].flags &= ~GRAPH_QUEUED;
+    return top;
+}
+
+
+/* Add flags to a node, and remember to clear them at the end of the query */
+static int
+graph_mark(commit_graph *graph, size_t idx, unsigned int flags)
+{
+    if (graph->nodes[idx].flags == 0) {
+        if (graph_vector_push(&graph->touched, idx) < 0)
+            return GIT_ERROR;
+    }
+
+    graph->nodes[idx].flags |= flags;
+    return 0;
+}
+
+static void
+graph_reset(commit_graph *graph)
+{
+    size_t i;
+
+    for (i = 0; i < graph->touched.count; i++)
+        graph->nodes[graph->touched.items[i]].flags = 0;
+    graph->touched.count = 0;
+    graph->queue.count = 0;
+}
+
+
+/*
+ * The merge bases of one and twos (as if they were merged), newest first,
+ * left as node indexes in graph->results. This is the algorithm of Git: the
+ * commits are painted with the side they are reachable from, newest first,
+ * until the remaining ones are all reachable from a common ancestor.
+ */
+static int
+graph_merge_bases(commit_graph *graph, size_t one, const size_t *twos,
+                  size_t twos_count)
+{
+    graph_node *node;
+    size_t idx, parent, i, j, nonstale = 0;
+    unsigned int flags;
+    int err;
+
+    graph->results.count = 0;
+
+    err = graph_node_parse(graph, one);
+    if (err < 0)
+        goto out;
+    err = graph_mark(graph, one, GRAPH_PARENT1);
+    if (err < 0)
+        goto out;
+    err = graph_queue_push(graph, one);
+    if (err < 0)
+        goto out;
+    nonstale++;
+
+    for (i = 0; i < twos_count; i++) {
+        err = graph_node_parse(graph, twos[i]);
+        if (err < 0)
+            goto out;
+        err = graph_mark(graph, twos[i], GRAPH_PARENT2);
+        if (err < 0)
+            goto out;
+        if (graph->nodes[twos[i]].flags & GRAPH_QUEUED)
+            continue;
+        err = graph_queue_push(graph, twos[i]);
+        if (err < 0)
+            goto out;
+        nonstale++;
+    }
+
+    while (nonstale > 0) {
+        idx = graph_queue_pop(graph);
+        node = &graph->nodes[idx];
+        if (!(node->flags & GRAPH_STALE))
+            nonstale--;
+
+        flags = node->flags & (GRAPH_PARENT1 | GRAPH_PARENT2 | GRAPH_STALE);
+        if (flags == (GRAPH_PARENT1 | GRAPH_PARENT2)) {
+            if (!(node->flags & GRAPH_RESULT)) {
+                node->flags |= GRAPH_RESULT;
+                err = graph_vector_push(&graph->results, idx);
+                if (err < 0)
+                    goto out;
+            }
+            /* Its ancestors are common too, but not the best ones */
+            flags |= GRAPH_STALE;
+        }
+
+        for (i = 0; i < graph->nodes[idx].parent_count; i++) {
+            parent = graph->parents.items[graph->nodes[idx].parents + i];
+            if ((graph->nodes[parent].flags & flags) == flags)
+                continue;
+
+            err = graph_node_parse(graph, parent);
+            if (err < 0)
+                goto out;
+
+            if (graph->nodes[parent].flags & GRAPH_QUEUED) {
+                if (!(graph->nodes[parent].flags & GRAPH_STALE) &&
+                    (flags & GRAPH_STALE))
+                    nonstale--;
+                graph->nodes[parent].flags |= flags;
+                continue;
+            }
+
+            err = graph_mark(graph, parent, flags);
+            if (err < 0)
+                goto out;
+            err = graph_queue_push(graph, parent);
+            if (err < 0)
+                goto out;
+            if (!(graph->nodes[parent].flags & GRAPH_STALE))
+                nonstale++;
+        }
+    }
+
+    /* Drop the results reachable from other results. They were found in
+     * the order of the queue, so the newest comes first. */
+    for (i = 0, j = 0; i < graph->results.count; i++) {
+        idx = graph->results.items[i];
+        if (!(graph->nodes[idx].flags & GRAPH_STALE))
+            graph->results.items[j++] = idx;
+    }
+    graph->results.count = j;
+
+out:
+    graph_reset(graph);
+    return err;
+}
+
+
+static int
+graph_begin(commit_graph *graph, git_repository *repo)
+{
+    int err;
+
+    PyThread_acquire_lock(graph->lock, WAIT_LOCK);
+    err = git_repository_odb(&graph->odb, repo);
+    if (err < 0)
+        PyThread_release_lock(graph->lock);
+    return err;
+}
+
+static void
+graph_end(commit_graph *graph)
+{
+    git_odb_free(graph->odb);
+    graph->odb = NULL;
+    PyThread_release_lock(graph->lock);
+}
+
+
+int
+commit_graph_merge_base_many(git_oid *out, int *found, commit_graph *graph,
+                             git_repository *repo, const git_oid *target,
+                             const git_oid *heads, size_t count)
+{
+    size_t one, two, i;
+    int err;
+
+    err = graph_begin(graph, repo);
+    if (err < 0)
+        return err;
+
+    err = graph_node_get(&one, graph, target);
+    for (i = 0; i < count && err == 0; i++) {
+        err = graph_node_get(&two, graph, &heads[i]);
+        if (err < 0)
+            break;
+        err = graph_merge_bases(graph, one, &two, 1);
+        if (err < 0)
+            break;
+
+        found[i] = graph->results.count > 0;
+        if (found[i])
+            git_oid_cpy(&out[i], &graph->nodes[graph->results.items[0]].oid);
+    }
+
+    graph_end(graph);
+    return err;
+}
+
+
+int
+commit_graph_merge_base_octopus(git_oid *out, commit_graph *graph,
+                                git_repository *repo, const git_oid *oids,
+                                size_t count)
+{
+    graph_vector bases = {NULL, 0, 0}, next = {NULL, 0, 0}, swap;
+    size_t idx, i, j, k, l;
+    int err;
+
+    if (count == 0) {
+        giterr_set_str(GITERR_INVALID, "no commits given");
+        return GIT_ERROR;
+    }
+
+    err = graph_begin(graph, repo);
+    if (err < 0)
+        return err;
+
+    err = graph_node_get(&idx, graph, &oids[0]);
+    if (err == 0)
+        err = graph_vector_push(&bases, idx);
+
+    /* The merge bases of the merge bases so far with every next commit */
+    for (i = 1; i < count && err == 0 && bases.count > 0; i++) {
+        err = graph_node_get(&idx, graph, &oids[i]);
+        next.count = 0;
+        for (j = 0; j < bases.count && err == 0; j++) {
+            err = graph_merge_bases(graph, idx, &bases.items[j], 1);
+            for (k = 0; k < graph->results.count && err == 0; k++) {
+                for (l = 0; l < next.count; l++)
+                    if (next.items[l] == graph->results.items[k])
+                        break;
+                if (l == next.count)
+                    err = graph_vector_push(&next, graph->results.items[k]);
+            }
+        }
+        swap = bases;
+        bases = next;
+        next = swap;
+    }
+
+    if (err == 0) {
+        if (bases.count > 0) {
+            git_oid_cpy(out, &graph->nodes[bases.items[0]].oid);
+        }
+        else {
+            giterr_set_str(GITERR_INVALID, "no merge base found");
+            err = GIT_ENOTFOUND;
+        }
+    }
+
+    graph_end(graph);
+    free(bases.items);
+    free(next.items);
+    return err;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2010-2013 The pygit2 contributors
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * In addition to the permissions in the GNU General Public License,
+ * the authors give you unlimited permission to link the compiled
+ * version of this file into combinations with other programs,
+ * and to distribute those combinations without any restriction
+ * coming from the use of this file.  (The General Public License
+ * restrictions do apply in other respects; for example, they cover
+ * modification of the file, and distribution when not linked into
+ * a combined executable.)
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDE_pygit2_graph_h
+#define INCLUDE_pygit2_graph_h
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <git2.h>
+
+/*
+ * The ancestry of the commits seen so far (parents and commit times), kept
+ * by a repository for the merge base queries. Commits never change, so the
+ * cache never goes stale. The queries take the lock of the graph and do not
+ * touch Python objects: call them with the GIL released.
+ */
+typedef struct commit_graph commit_graph;
+
+commit_graph *commit_graph_new(void);
+void commit_graph_free(commit_graph *graph);
+
+/* For every head, the best merge base of target and head; found[i] is set
+ * to 0 if they have no common ancestor */
+int commit_graph_merge_base_many(git_oid *out, int *found,
+                                 commit_graph *graph, git_repository *repo,
+                                 const git_oid *target, const git_oid *heads,
+                                 size_t count);
+
+/* The merge base of all the commits, as if they were merged at once.
+ * Returns GIT_ENOTFOUND if there is none. */
+int commit_graph_merge_base_octopus(git_oid *out, commit_graph *graph,
+                                    git_repository *repo,
+                                    const git_oid *oids, size_t count);
+
+#endif
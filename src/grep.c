@@ -0,0 +1,211 @@
+/*
+ * Copyright 2010-2013 The pygit2 contributors
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * In addition to the permissions in the GNU General Public License,
+ * the authors give you unlimited permission to link the compiled
+ * version of this file into combinations with other programs,
+ * and to distribute those combinations without any restriction
+ * coming from the use of this file.  (The General Public License
+ * restrictions do apply in other respects; for example, they cover
+ * modification of the file, and distribution when not linked into
+ * a combined executable.)
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stdlib.h>
+#include <string.h>
+#include "grep.h"
+
+/* Where git looks for a NUL to tell binary files */
+#define GREP_BINARY_CHECK 8000
+
+struct grep {
+    grep_match *matches;
+    size_t count;
+    size_t alloc;
+    char *text;
+    size_t text_len;
+    size_t text_alloc;
+};
+
+
+static int
+grep_append(grep *grep, size_t blob, size_t line_no, const char *line,
+            size_t len)
+{
+    grep_match *matches;
+    char *text;
+    size_t alloc;
+
+    if (grep->count == grep->alloc) {
+        alloc = grep->alloc ? grep->alloc * 2 : 64;
+        matches = realloc(grep->matches, alloc * sizeof(grep_match));
+        if (matches == NULL)
+            goto oom;
+        grep->matches = matches;
+        grep->alloc = alloc;
+    }
+
+    if (grep->text_len + len > grep->text_alloc) {
+        alloc = grep->text_alloc ? grep->text_alloc * 2 : 4096;
+        while (alloc < grep->text_len + len)
+            alloc *= 2;
+        text = realloc(grep->text, alloc);
+        if (text == NULL)
+            goto oom;
+        grep->text = text;
+        grep->text_alloc = alloc;
+    }
+
+    grep->matches[grep->count].blob = blob;
+    grep->matches[grep->count].line_no = line_no;
+    grep->matches[grep->count].offset = grep->text_len;
+    grep->matches[grep->count].len = len;
+    grep->count++;
+    memcpy(grep->text + grep->text_len, line, len);
+    grep->text_len += len;
+    return 0;
+
+oom:
+    giterr_set_oom();
+    return GIT_ERROR;
+}
+
+
+/* The first occurrence of the literal in [start, end), or NULL */
+static const char *
+grep_find(const char *start, const char *end, const char *literal,
+          size_t len)
+{
+    const char *p = start;
+
+    if (len == 0)
+        return start;
+
+    while ((size_t)(end - p) >= len) {
+        p = memchr(p, literal[0], (end - p) - len + 1);
+        if (p == NULL)
+            return NULL;
+        if (memcmp(p + 1, literal + 1, len - 1) == 0)
+            return p;
+        p++;
+    }
+
+    return NULL;
+}
+
+
+static int
+grep_blob(grep *grep, size_t blob, const char *data, size_t size,
+          const char *literal, size_t literal_len)
+{
+    const char *end = data + size, *line = data, *found, *eol;
+    size_t line_no = 1;
+    int err;
+
+    if (memchr(data, '\0', size < GREP_BINARY_CHECK ? size :
+                                                      GREP_BINARY_CHECK))
+        return 0;
+
+    while (line < end) {
+        found = grep_find(line, end, literal, literal_len);
+        if (found == NULL)
+            break;
+
+        /* Move to the line of the match, counting the lines on the way */
+        while ((eol = memchr(line, '\n', found - line)) != NULL) {
+            line = eol + 1;
+            line_no++;
+        }
+
+        eol = memchr(found, '\n', end - found);
+        if (eol == NULL)
+            eol = end;
+
+        err = grep_append(grep, blob, line_no, line, eol - line);
+        if (err < 0)
+            return err;
+
+        line = eol + 1;
+        line_no++;
+    }
+
+    return 0;
+}
+
+
+int
+grep_blobs(grep **out, git_repository *repo, const git_oid *oids,
+           size_t count, const char *literal, size_t literal_len)
+{
+    grep *grep;
+    git_blob *blob;
+    size_t i;
+    int err = 0;
+
+    grep = calloc(1, sizeof(struct grep));
+    if (grep == NULL) {
+        giterr_set_oom();
+        return GIT_ERROR;
+    }
+
+    for (i = 0; i < count && err == 0; i++) {
+        err = git_blob_lookup(&blob, repo, &oids[i]);
+        if (err < 0)
+            break;
+
+        err = grep_blob(grep, i, git_blob_rawcontent(blob),
+                        (size_t)git_blob_rawsize(blob), literal, literal_len);
+        git_blob_free(blob);
+    }
+
+    if (err < 0) {
+        grep_free(grep);
+        return err;
+    }
+
+    *out = grep;
+    return 0;
+}
+
+
+void
+grep_free(grep *grep)
+{
+    if (grep == NULL)
+        return;
+
+    free(grep->matches);
+    free(grep->text);
+    free(grep);
+}
+
+
+const grep_match *
+grep_results(grep *grep, size_t *count)
+{
+    *count = grep->count;
+    return grep->matches;
+}
+
+
+const char *
+grep_text(grep *grep)
+{
+    return grep->text;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2010-2013 The pygit2 contributors
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * In addition to the permissions in the GNU General Public License,
+ * the authors give you unlimited permission to link the compiled
+ * version of this file into combinations with other programs,
+ * and to distribute those combinations without any restriction
+ * coming from the use of this file.  (The General Public License
+ * restrictions do apply in other respects; for example, they cover
+ * modification of the file, and distribution when not linked into
+ * a combined executable.)
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDE_pygit2_grep_h
+#define INCLUDE_pygit2_grep_h
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <git2.h>
+
+/* A line containing the literal. Line numbers start at 1. The text of the
+ * line, without its end of line, is at offset in the grep buffer. */
+typedef struct {
+    size_t blob;
+    size_t line_no;
+    size_t offset;
+    size_t len;
+} grep_match;
+
+/*
+ * Scan the blobs for the lines which contain the literal, every line if it
+ * is empty. The blobs are read in place, only the matching lines are
+ * copied. Binary blobs (with a NUL in their first 8000 bytes, as git
+ * decides) are skipped. This does not touch Python objects, so it may run
+ * with the GIL released.
+ */
+typedef struct grep grep;
+
+int grep_blobs(grep **out, git_repository *repo, const git_oid *oids,
+               size_t count, const char *literal, size_t literal_len);
+void grep_free(grep *grep);
+
+const grep_match *grep_results(grep *grep, size_t *count);
+const char *grep_text(grep *grep);
+
+#endif
@@ -116,7 +116,10 @@ Index_clear(Index *self)
 
 
 PyDoc_STRVAR(Index_diff_to_workdir__doc__,
-  "diff_to_workdir([flag, context_lines, interhunk_lines]) -> Diff\n"
+  "diff_to_workdir([flag, context_lines, interhunk_lines, pathspec,\n"
+  "                 max_size, ignore_submodules, old_prefix, new_prefix,\n"
+  "                 force_binary])\n"
+  "    -> Diff\n"
   "\n"
   "Return a :py:class:`~pygit2.Diff` object with the differences between the\n"
   "index and the working copy.\n"
@@ -129,33 +132,48 @@ PyDoc_STRVAR(Index_diff_to_workdir__doc__,
   "   of a hunk (and to display before and after)\n"
   "\n"
   "interhunk_lines: the maximum number of unchanged lines between hunk\n"
-  "   boundaries before the hunks will be merged into a one.\n");
+  "   boundaries before the hunks will be merged into a one.\n"
+  DIFF_OPTIONS_DOC);
 
 PyObject *
-Index_diff_to_workdir(Index *self, PyObject *args)
+Index_diff_to_workdir(Index *self, PyObject *args, PyObject *kwds)
 {
-    git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+    diff_options options = DIFF_OPTIONS_INIT;
     git_diff_list *diff;
     int err;
+    char *keywords[] = {"flags", "context_lines", "interhunk_lines",
+                        DIFF_OPTIONS_KEYWORDS, NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|IHH" DIFF_OPTIONS_FORMAT,
+                                     keywords, &options.opts.flags,
+                                     &options.opts.context_lines,
+                                     &options.opts.interhunk_lines,
+                                     DIFF_OPTIONS_ARGS(options)))
+        return NULL;
 
-    if (!PyArg_ParseTuple(args, "|IHH", &opts.flags, &opts.context_lines,
-                                        &opts.interhunk_lines))
+    if (diff_options_prepare(&options) < 0) {
+        diff_options_free(&options);
         return NULL;
+    }
 
     err = git_diff_index_to_workdir(
             &diff,
             self->repo->repo,
             self->index,
-            &opts);
+            &options.opts);
+    diff_options_free(&options);
 
     if (err < 0)
         return Error_set(err);
 
-    return wrap_diff(diff, self->repo);
+    return wrap_diff(diff, self->repo, &options);
 }
 
 PyDoc_STRVAR(Index_diff_to_tree__doc__,
-  "diff_to_tree(tree [, flag, context_lines, interhunk_lines]) -> Diff\n"
+  "diff_to_tree(tree [, flag, context_lines, interhunk_lines, pathspec,\n"
+  "              max_size, ignore_submodules, old_prefix, new_prefix,\n"
+  "              force_binary])\n"
+  "    -> Diff\n"
   "\n"
   "Return a :py:class:`~pygit2.Diff` object with the differences between the\n"
   "index and the given tree.\n"
@@ -170,29 +188,42 @@ PyDoc_STRVAR(Index_diff_to_tree__doc__,
   "   of a hunk (and to display before and after)\n"
   "\n"
   "interhunk_lines: the maximum number of unchanged lines between hunk\n"
-  "   boundaries before the hunks will be merged into a one.\n");
+  "   boundaries before the hunks will be merged into a one.\n"
+  DIFF_OPTIONS_DOC);
 
 PyObject *
-Index_diff_to_tree(Index *self, PyObject *args)
+Index_diff_to_tree(Index *self, PyObject *args, PyObject *kwds)
 {
     Repository *py_repo;
-    git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+    diff_options options = DIFF_OPTIONS_INIT;
     git_diff_list *diff;
     int err;
+    char *keywords[] = {"tree", "flags", "context_lines", "interhunk_lines",
+                        DIFF_OPTIONS_KEYWORDS, NULL};
 
     Tree *py_tree = NULL;
 
-    if (!PyArg_ParseTuple(args, "O!|IHH", &TreeType, &py_tree, &opts.flags,
-                          &opts.context_lines, &opts.interhunk_lines))
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|IHH" DIFF_OPTIONS_FORMAT,
+                                     keywords, &TreeType, &py_tree,
+                                     &options.opts.flags,
+                                     &options.opts.context_lines,
+                                     &options.opts.interhunk_lines,
+                                     DIFF_OPTIONS_ARGS(options)))
+        return NULL;
+
+    if (diff_options_prepare(&options) < 0) {
+        diff_options_free(&options);
         return NULL;
+    }
 
     py_repo = py_tree->repo;
     err = git_diff_tree_to_index(&diff, py_repo->repo, py_tree->tree,
-                                 self->index, &opts);
+                                 self->index, &options.opts);
+    diff_options_free(&options);
     if (err < 0)
         return Error_set(err);
 
-    return wrap_diff(diff, py_repo);
+    return wrap_diff(diff, py_repo, &options);
 }
 
 
@@ -286,6 +317,7 @@ Index_iter(Index *self)
 {
     IndexIter *iter;
 
+    READY_TYPE(IndexIterType, NULL)
     iter = PyObject_New(IndexIter, &IndexIterType);
     if (iter) {
         Py_INCREF(self);
@@ -307,8 +339,11 @@ wrap_index_entry(const git_index_entry *entry, Index *index)
     IndexEntry *py_entry;
 
     py_entry = PyObject_New(IndexEntry, &IndexEntryType);
-    if (py_entry)
+    if (py_entry) {
+        Py_INCREF(index);
+        py_entry->owner = index;
         py_entry->entry = entry;
+    }
 
     return (PyObject*)py_entry;
 }
@@ -413,24 +448,105 @@ Index_write_tree(Index *self)
     git_oid oid;
     int err;
 
-    err = git_index_write_tree(&oid, self->index);
+    /* In-memory indexes, like the result of a merge, have no repository
+     * of their own */
+    if (self->repo)
+        err = git_index_write_tree_to(&oid, self->index, self->repo->repo);
+    else
+        err = git_index_write_tree(&oid, self->index);
     if (err < 0)
         return Error_set(err);
 
     return git_oid_to_python(&oid);
 }
 
+
+PyDoc_STRVAR(Index_conflicts__doc__,
+  "conflicts() -> {str: (IndexEntry, IndexEntry, IndexEntry)}\n"
+  "\n"
+  "Return the conflicts of the index, as a dictionary from the paths to\n"
+  "the (ancestor, ours, theirs) entries; an entry is None when the file is\n"
+  "missing on that side.");
+
+PyObject *
+Index_conflicts(Index *self)
+{
+    const git_index_entry *entry;
+    PyObject *py_conflicts, *py_path, *py_sides = NULL, *py_entry;
+    const char *path = NULL;
+    size_t i, n;
+    int stage, err;
+
+    py_conflicts = PyDict_New();
+    if (py_conflicts == NULL)
+        return NULL;
+
+    /* The stages of a path are sorted together, from 1 (ancestor) to 3 */
+    n = git_index_entrycount(self->index);
+    for (i = 0; i < n; i++) {
+        entry = git_index_get_byindex(self->index, i);
+        stage = git_index_entry_stage(entry);
+        if (stage == 0)
+            continue;
+
+        if (path == NULL || strcmp(path, entry->path) != 0) {
+            path = entry->path;
+            py_sides = Py_BuildValue("(OOO)", Py_None, Py_None, Py_None);
+            if (py_sides == NULL)
+                goto error;
+            py_path = to_path(path);
+            if (py_path == NULL) {
+                Py_DECREF(py_sides);
+                goto error;
+            }
+            err = PyDict_SetItem(py_conflicts, py_path, py_sides);
+            Py_DECREF(py_path);
+            Py_DECREF(py_sides);
+            if (err < 0)
+                goto error;
+        }
+
+        py_entry = wrap_index_entry(entry, self);
+        if (py_entry == NULL)
+            goto error;
+        Py_DECREF(PyTuple_GET_ITEM(py_sides, stage - 1));
+        PyTuple_SET_ITEM(py_sides, stage - 1, py_entry);
+    }
+
+    return py_conflicts;
+
+error:
+    Py_DECREF(py_conflicts);
+    return NULL;
+}
+
+
+PyDoc_STRVAR(Index_has_conflicts__doc__,
+  "Whether the index has conflicts, see conflicts().");
+
+PyObject *
+Index_has_conflicts__get__(Index *self)
+{
+    return PyBool_FromLong(git_index_has_conflicts(self->index));
+}
+
 PyMethodDef Index_methods[] = {
     METHOD(Index, add, METH_VARARGS),
     METHOD(Index, remove, METH_VARARGS),
     METHOD(Index, clear, METH_NOARGS),
-    METHOD(Index, diff_to_workdir, METH_VARARGS),
-    METHOD(Index, diff_to_tree, METH_VARARGS),
+    METHOD(Index, diff_to_workdir, METH_VARARGS | METH_KEYWORDS),
+    METHOD(Index, diff_to_tree, METH_VARARGS | METH_KEYWORDS),
     METHOD(Index, _find, METH_O),
     METHOD(Index, read, METH_NOARGS),
     METHOD(Index, write, METH_NOARGS),
     METHOD(Index, read_tree, METH_O),
     METHOD(Index, write_tree, METH_NOARGS),
+    METHOD(Index, conflicts, METH_NOARGS),
+    {NULL}
+};
+
+PyGetSetDef Index_getseters[] = {
+    GETTER(Index, has_conflicts),
     {NULL}
 };
 
@@ -485,7 +601,7 @@ PyTypeObject IndexType = {
     0,                                         /* tp_iternext       */
     Index_methods,                             /* tp_methods        */
     0,                                         /* tp_members        */
-    0,                                         /* tp_getset         */
+    Index_getseters,                           /* tp_getset         */
     0,                                         /* tp_base           */
     0,                                         /* tp_dict           */
     0,                                         /* tp_descr_get      */
@@ -553,6 +669,7 @@ PyTypeObject IndexIterType = {
 void
 IndexEntry_dealloc(IndexEntry *self)
 {
+    Py_CLEAR(self->owner);
     PyObject_Del(self);
 }
 
@@ -181,6 +181,10 @@ wrap_object(git_object *c_object, Repository *repo)
     switch (git_object_type(c_object)) {
         case GIT_OBJ_COMMIT:
             py_obj = PyObject_New(Object, &CommitType);
+            if (py_obj) {
+                ((Commit*)py_obj)->author = NULL;
+                ((Commit*)py_obj)->committer = NULL;
+            }
             break;
         case GIT_OBJ_TREE:
             py_obj = PyObject_New(Object, &TreeType);
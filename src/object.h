@@ -33,6 +33,7 @@
 #include <git2.h>
 #include "types.h"
 
+void Object_dealloc(Object* self);
 PyObject* Object_get_oid(Object *self);
 PyObject* Object_get_hex(Object *self);
 PyObject* Object_get_type(Object *self);
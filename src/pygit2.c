@@ -47,6 +47,7 @@ extern PyTypeObject PatchType;
 extern PyTypeObject HunkType;
 extern PyTypeObject TreeType;
 extern PyTypeObject TreeBuilderType;
+extern PyTypeObject TreeEditorType;
 extern PyTypeObject TreeEntryType;
 extern PyTypeObject TreeIterType;
 extern PyTypeObject BlobType;
@@ -58,6 +59,7 @@ extern PyTypeObject WalkerType;
 extern PyTypeObject ConfigType;
 extern PyTypeObject ReferenceType;
 extern PyTypeObject RefLogIterType;
+extern PyTypeObject RefTransactionType;
 extern PyTypeObject RefLogEntryType;
 extern PyTypeObject BranchType;
 extern PyTypeObject SignatureType;
@@ -280,8 +282,8 @@ moduleinit(PyObject* m)
     INIT_TYPE(SignatureType, NULL, PyType_GenericNew)
     INIT_TYPE(TreeType, &ObjectType, NULL)
     INIT_TYPE(TreeEntryType, NULL, NULL)
-    INIT_TYPE(TreeIterType, NULL, NULL)
     INIT_TYPE(TreeBuilderType, NULL, PyType_GenericNew)
+    INIT_TYPE(TreeEditorType, NULL, NULL)
     INIT_TYPE(BlobType, &ObjectType, NULL)
     INIT_TYPE(TagType, &ObjectType, NULL)
     ADD_TYPE(m, Object)
@@ -290,6 +292,7 @@ moduleinit(PyObject* m)
     ADD_TYPE(m, Tree)
     ADD_TYPE(m, TreeEntry)
     ADD_TYPE(m, TreeBuilder)
+    ADD_TYPE(m, TreeEditor)
     ADD_TYPE(m, Blob)
     ADD_TYPE(m, Tag)
     ADD_CONSTANT_INT(m, GIT_OBJ_ANY)
@@ -304,6 +307,9 @@ moduleinit(PyObject* m)
     ADD_CONSTANT_INT(m, GIT_FILEMODE_BLOB_EXECUTABLE)
     ADD_CONSTANT_INT(m, GIT_FILEMODE_LINK)
     ADD_CONSTANT_INT(m, GIT_FILEMODE_COMMIT)
+    /* Tree walk modes */
+    ADD_CONSTANT_INT(m, GIT_TREEWALK_PRE)
+    ADD_CONSTANT_INT(m, GIT_TREEWALK_POST)
 
     /*
      * Log
@@ -319,12 +325,12 @@ moduleinit(PyObject* m)
      */
     INIT_TYPE(ReferenceType, NULL, PyType_GenericNew)
     INIT_TYPE(RefLogEntryType, NULL, NULL)
-    INIT_TYPE(RefLogIterType, NULL, NULL)
     INIT_TYPE(NoteType, NULL, NULL)
-    INIT_TYPE(NoteIterType, NULL, NULL)
+    INIT_TYPE(RefTransactionType, NULL, NULL)
     ADD_TYPE(m, Reference)
     ADD_TYPE(m, RefLogEntry)
     ADD_TYPE(m, Note)
+    ADD_TYPE(m, RefTransaction)
     ADD_CONSTANT_INT(m, GIT_REF_INVALID)
     ADD_CONSTANT_INT(m, GIT_REF_OID)
     ADD_CONSTANT_INT(m, GIT_REF_SYMBOLIC)
@@ -343,7 +349,6 @@ moduleinit(PyObject* m)
      */
     INIT_TYPE(IndexType, NULL, PyType_GenericNew)
     INIT_TYPE(IndexEntryType, NULL, NULL)
-    INIT_TYPE(IndexIterType, NULL, NULL)
     ADD_TYPE(m, Index)
     ADD_TYPE(m, IndexEntry)
     /* Status */
@@ -372,7 +377,6 @@ moduleinit(PyObject* m)
      * Diff
      */
     INIT_TYPE(DiffType, NULL, NULL)
-    INIT_TYPE(DiffIterType, NULL, NULL)
     INIT_TYPE(PatchType, NULL, NULL)
     INIT_TYPE(HunkType, NULL, NULL)
     ADD_TYPE(m, Diff)
@@ -409,6 +413,17 @@ moduleinit(PyObject* m)
     ADD_CONSTANT_INT(m, GIT_DIFF_FIND_COPIES_FROM_UNMODIFIED)
     /* --break-rewrites=/M */
     ADD_CONSTANT_INT(m, GIT_DIFF_FIND_AND_BREAK_REWRITES)
+    ADD_CONSTANT_INT(m, GIT_DIFF_FIND_ALL)
+    /* Whitespace in the similarity of files */
+    ADD_CONSTANT_INT(m, GIT_DIFF_FIND_IGNORE_WHITESPACE)
+    ADD_CONSTANT_INT(m, GIT_DIFF_FIND_DONT_IGNORE_WHITESPACE)
+
+    /* Merge */
+    ADD_CONSTANT_INT(m, GIT_MERGE_TREE_FIND_RENAMES)
+    ADD_CONSTANT_INT(m, GIT_MERGE_AUTOMERGE_NORMAL)
+    ADD_CONSTANT_INT(m, GIT_MERGE_AUTOMERGE_NONE)
+    ADD_CONSTANT_INT(m, GIT_MERGE_AUTOMERGE_FAVOR_OURS)
+    ADD_CONSTANT_INT(m, GIT_MERGE_AUTOMERGE_FAVOR_THEIRS)
 
     /* Config */
     INIT_TYPE(ConfigType, NULL, PyType_GenericNew)
@@ -50,18 +50,16 @@ void RefLogIter_dealloc(RefLogIter *self)
 
 PyObject* RefLogIter_iternext(RefLogIter *self)
 {
-    const git_reflog_entry *entry;
     RefLogEntry *py_entry;
 
     if (self->i < self->size) {
-        entry = git_reflog_entry_byindex(self->reflog, self->i);
         py_entry = PyObject_New(RefLogEntry, &RefLogEntryType);
+        if (py_entry == NULL)
+            return NULL;
 
-        py_entry->oid_old = git_oid_allocfmt(git_reflog_entry_id_old(entry));
-        py_entry->oid_new = git_oid_allocfmt(git_reflog_entry_id_new(entry));
-        py_entry->message = strdup(git_reflog_entry_message(entry));
-        py_entry->signature = git_signature_dup(
-            git_reflog_entry_committer(entry));
+        Py_INCREF(self);
+        py_entry->owner = self;
+        py_entry->entry = git_reflog_entry_byindex(self->reflog, self->i);
 
         ++(self->i);
 
@@ -105,6 +103,63 @@ PyTypeObject RefLogIterType = {
     (iternextfunc)RefLogIter_iternext,         /* tp_iternext       */
 };
 
+void
+ReferenceIter_dealloc(ReferenceIter *self)
+{
+    git_reference_iterator_free(self->iter);
+    Py_CLEAR(self->owner);
+    PyObject_Del(self);
+}
+
+PyObject *
+ReferenceIter_iternext(ReferenceIter *self)
+{
+    const char *name;
+    int err;
+
+    err = git_reference_next(&name, self->iter);
+    if (err == GIT_ITEROVER)
+        return NULL;
+    if (err < 0)
+        return Error_set(err);
+
+    return to_path(name);
+}
+
+
+PyDoc_STRVAR(ReferenceIter__doc__, "Internal reference names iterator.");
+
+PyTypeObject ReferenceIterType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_pygit2.ReferenceIter",                   /* tp_name           */
+    sizeof(ReferenceIter),                     /* tp_basicsize      */
+    0,                                         /* tp_itemsize       */
+    (destructor)ReferenceIter_dealloc,         /* tp_dealloc        */
+    0,                                         /* tp_print          */
+    0,                                         /* tp_getattr        */
+    0,                                         /* tp_setattr        */
+    0,                                         /* tp_compare        */
+    0,                                         /* tp_repr           */
+    0,                                         /* tp_as_number      */
+    0,                                         /* tp_as_sequence    */
+    0,                                         /* tp_as_mapping     */
+    0,                                         /* tp_hash           */
+    0,                                         /* tp_call           */
+    0,                                         /* tp_str            */
+    0,                                         /* tp_getattro       */
+    0,                                         /* tp_setattro       */
+    0,                                         /* tp_as_buffer      */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,  /* tp_flags          */
+    ReferenceIter__doc__,                      /* tp_doc            */
+    0,                                         /* tp_traverse       */
+    0,                                         /* tp_clear          */
+    0,                                         /* tp_richcompare    */
+    0,                                         /* tp_weaklistoffset */
+    PyObject_SelfIter,                         /* tp_iter           */
+    (iternextfunc)ReferenceIter_iternext,      /* tp_iternext       */
+};
+
+
 void
 Reference_dealloc(Reference *self)
 {
@@ -300,19 +355,93 @@ PyObject *
 Reference_log(Reference *self)
 {
     RefLogIter *iter;
+    git_reflog *reflog;
+    int err;
 
     CHECK_REFERENCE(self);
+    READY_TYPE(RefLogIterType, NULL)
+
+    err = git_reflog_read(&reflog, self->reference);
+    if (err < 0)
+        return Error_set(err);
 
     iter = PyObject_New(RefLogIter, &RefLogIterType);
-    if (iter != NULL) {
-        git_reflog_read(&iter->reflog, self->reference);
-        iter->size = git_reflog_entrycount(iter->reflog);
-        iter->i = 0;
+    if (iter == NULL) {
+        git_reflog_free(reflog);
+        return NULL;
     }
+
+    iter->reflog = reflog;
+    iter->size = git_reflog_entrycount(reflog);
+    iter->i = 0;
     return (PyObject*)iter;
 }
 
 
+PyDoc_STRVAR(Reference_log_table__doc__,
+  "log_table() -> (oids_old, oids_new, times, offsets)\n"
+  "\n"
+  "Return the reference log as four columns, in the same order as log(),\n"
+  "without creating an object for each entry: oids_old and oids_new are\n"
+  "bytes strings with the raw (20 bytes) oids one after the other, times a\n"
+  "bytes string of native signed 64 bits integers (the committer times, in\n"
+  "seconds since the epoch) and offsets one of native ints (the committer\n"
+  "time zones, in minutes). See the array and struct modules.");
+
+PyObject *
+Reference_log_table(Reference *self)
+{
+    git_reflog *reflog;
+    const git_reflog_entry *entry;
+    const git_signature *committer;
+    PyObject *py_old, *py_new, *py_times, *py_offsets;
+    char *oids_old, *oids_new;
+    PY_LONG_LONG *times;
+    int *offsets;
+    size_t i, n;
+    int err;
+
+    CHECK_REFERENCE(self);
+
+    err = git_reflog_read(&reflog, self->reference);
+    if (err < 0)
+        return Error_set(err);
+
+    n = git_reflog_entrycount(reflog);
+    py_old = PyBytes_FromStringAndSize(NULL, n * GIT_OID_RAWSZ);
+    py_new = PyBytes_FromStringAndSize(NULL, n * GIT_OID_RAWSZ);
+    py_times = PyBytes_FromStringAndSize(NULL, n * sizeof(PY_LONG_LONG));
+    py_offsets = PyBytes_FromStringAndSize(NULL, n * sizeof(int));
+    if (py_old == NULL || py_new == NULL || py_times == NULL ||
+        py_offsets == NULL) {
+        Py_XDECREF(py_old);
+        Py_XDECREF(py_new);
+        Py_XDECREF(py_times);
+        Py_XDECREF(py_offsets);
+        git_reflog_free(reflog);
+        return NULL;
+    }
+
+    oids_old = PyBytes_AS_STRING(py_old);
+    oids_new = PyBytes_AS_STRING(py_new);
+    times = (PY_LONG_LONG *)PyBytes_AS_STRING(py_times);
+    offsets = (int *)PyBytes_AS_STRING(py_offsets);
+    for (i = 0; i < n; i++) {
+        entry = git_reflog_entry_byindex(reflog, i);
+        memcpy(oids_old + i * GIT_OID_RAWSZ,
+               git_reflog_entry_id_old(entry)->id, GIT_OID_RAWSZ);
+        memcpy(oids_new + i * GIT_OID_RAWSZ,
+               git_reflog_entry_id_new(entry)->id, GIT_OID_RAWSZ);
+        committer = git_reflog_entry_committer(entry);
+        times[i] = committer->when.time;
+        offsets[i] = committer->when.offset;
+    }
+
+    git_reflog_free(reflog);
+    return Py_BuildValue("(NNNN)", py_old, py_new, py_times, py_offsets);
+}
+
+
 PyDoc_STRVAR(Reference_get_object__doc__,
   "get_object() -> object\n"
   "\n"
@@ -334,45 +463,60 @@ Reference_get_object(Reference *self)
 }
 
 
-PyDoc_STRVAR(RefLogEntry_committer__doc__, "Committer.");
+PyDoc_STRVAR(RefLogEntry_oid_old__doc__, "Old oid.");
 
 PyObject *
-RefLogEntry_committer__get__(RefLogEntry *self)
+RefLogEntry_oid_old__get__(RefLogEntry *self)
 {
-    return build_signature((Object*) self, self->signature, "utf-8");
+    return git_oid_to_py_str(git_reflog_entry_id_old(self->entry));
 }
 
 
-static int
-RefLogEntry_init(RefLogEntry *self, PyObject *args, PyObject *kwds)
+PyDoc_STRVAR(RefLogEntry_oid_new__doc__, "New oid.");
+
+PyObject *
+RefLogEntry_oid_new__get__(RefLogEntry *self)
 {
-    self->oid_old   = NULL;
-    self->oid_new   = NULL;
-    self->message   = NULL;
-    self->signature = NULL;
+    return git_oid_to_py_str(git_reflog_entry_id_new(self->entry));
+}
 
-    return 0;
+
+PyDoc_STRVAR(RefLogEntry_message__doc__, "Message.");
+
+PyObject *
+RefLogEntry_message__get__(RefLogEntry *self)
+{
+    const char *message;
+
+    message = git_reflog_entry_message(self->entry);
+    if (message == NULL)
+        Py_RETURN_NONE;
+
+    return to_unicode(message, "utf-8", "strict");
+}
+
+
+PyDoc_STRVAR(RefLogEntry_committer__doc__, "Committer.");
+
+PyObject *
+RefLogEntry_committer__get__(RefLogEntry *self)
+{
+    return build_signature((Object*) self,
+                           git_reflog_entry_committer(self->entry), "utf-8");
 }
 
 
 static void
 RefLogEntry_dealloc(RefLogEntry *self)
 {
-    free(self->oid_old);
-    free(self->oid_new);
-    free(self->message);
-    git_signature_free(self->signature);
+    Py_CLEAR(self->owner);
     PyObject_Del(self);
 }
 
-PyMemberDef RefLogEntry_members[] = {
-    MEMBER(RefLogEntry, oid_new, T_STRING, "New oid."),
-    MEMBER(RefLogEntry, oid_old, T_STRING, "Old oid."),
-    MEMBER(RefLogEntry, message, T_STRING, "Message."),
-    {NULL}
-};
-
 PyGetSetDef RefLogEntry_getseters[] = {
+    GETTER(RefLogEntry, oid_old),
+    GETTER(RefLogEntry, oid_new),
+    GETTER(RefLogEntry, message),
     GETTER(RefLogEntry, committer),
     {NULL}
 };
@@ -409,14 +553,14 @@ PyTypeObject RefLogEntryType = {
     0,                                         /* tp_iter           */
     0,                                         /* tp_iternext       */
     0,                                         /* tp_methods        */
-    RefLogEntry_members,                       /* tp_members        */
+    0,                                         /* tp_members        */
     RefLogEntry_getseters,                     /* tp_getset         */
     0,                                         /* tp_base           */
     0,                                         /* tp_dict           */
     0,                                         /* tp_descr_get      */
     0,                                         /* tp_descr_set      */
     0,                                         /* tp_dictoffset     */
-    (initproc)RefLogEntry_init,                /* tp_init           */
+    0,                                         /* tp_init           */
     0,                                         /* tp_alloc          */
     0,                                         /* tp_new            */
 };
@@ -426,6 +570,7 @@ PyMethodDef Reference_methods[] = {
     METHOD(Reference, rename, METH_O),
     METHOD(Reference, resolve, METH_NOARGS),
     METHOD(Reference, log, METH_NOARGS),
+    METHOD(Reference, log_table, METH_NOARGS),
     METHOD(Reference, get_object, METH_NOARGS),
     {NULL}
 };
@@ -0,0 +1,496 @@
+/*
+ * Copyright 2010-2013 The pygit2 contributors
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * In addition to the permissions in the GNU General Public License,
+ * the authors give you unlimited permission to link the compiled
+ * version of this file into combinations with other programs,
+ * and to distribute those combinations without any restriction
+ * coming from the use of this file.  (The General Public License
+ * restrictions do apply in other respects; for example, they cover
+ * modification of the file, and distribution when not linked into
+ * a combined executable.)
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <string.h>
+#include "error.h"
+#include "utils.h"
+#include "oid.h"
+#include "reftransaction.h"
+
+extern PyTypeObject SignatureType;
+
+#define REFTX_CREATE 1
+#define REFTX_UPDATE 2
+#define REFTX_DELETE 3
+
+
+static void
+reftransaction_clear(RefTransaction *self)
+{
+    size_t i;
+
+    for (i = 0; i < self->count; i++) {
+        free(self->ops[i].name);
+        git_reference_free(self->ops[i].ref);
+    }
+    self->count = 0;
+}
+
+void
+RefTransaction_dealloc(RefTransaction *self)
+{
+    reftransaction_clear(self);
+    free(self->ops);
+    Py_CLEAR(self->repo);
+    PyObject_Del(self);
+}
+
+
+/* Queues an operation. py_target and py_old may be NULL (or None). */
+static PyObject *
+reftransaction_add(RefTransaction *self, int kind, PyObject *py_name,
+                   PyObject *py_target, PyObject *py_old)
+{
+    RefTransactionOp *op, *tmp;
+    git_oid target, old;
+    size_t alloc;
+    char *name;
+    int err;
+
+    if (py_target != NULL) {
+        err = py_oid_to_git_oid_expand(self->repo->repo, py_target, &target);
+        if (err < 0)
+            return NULL;
+    }
+
+    if (py_old != NULL && py_old != Py_None) {
+        err = py_oid_to_git_oid_expand(self->repo->repo, py_old, &old);
+        if (err < 0)
+            return NULL;
+    }
+
+    name = py_str_to_c_str(py_name, NULL);
+    if (name == NULL)
+        return NULL;
+
+    if (self->count == self->alloc) {
+        alloc = (self->alloc == 0) ? 16 : self->alloc * 2;
+        tmp = realloc(self->ops, alloc * sizeof(RefTransactionOp));
+        if (tmp == NULL) {
+            free(name);
+            return PyErr_NoMemory();
+        }
+        self->ops = tmp;
+        self->alloc = alloc;
+    }
+
+    op = &self->ops[self->count++];
+    memset(op, 0, sizeof(RefTransactionOp));
+    op->name = name;
+    op->kind = kind;
+    if (py_target != NULL)
+        git_oid_cpy(&op->target, &target);
+    if (py_old != NULL && py_old != Py_None) {
+        op->has_old = 1;
+        git_oid_cpy(&op->old, &old);
+    }
+
+    Py_RETURN_NONE;
+}
+
+
+PyDoc_STRVAR(RefTransaction_create__doc__,
+  "create(name, target)\n"
+  "\n"
+  "Queue the creation of a direct reference. The reference must not exist\n"
+  "when the transaction is committed.");
+
+PyObject *
+RefTransaction_create(RefTransaction *self, PyObject *args)
+{
+    PyObject *py_name, *py_target;
+
+    if (!PyArg_ParseTuple(args, "OO", &py_name, &py_target))
+        return NULL;
+
+    return reftransaction_add(self, REFTX_CREATE, py_name, py_target, NULL);
+}
+
+
+PyDoc_STRVAR(RefTransaction_update__doc__,
+  "update(name, target[, old_target])\n"
+  "\n"
+  "Queue the update of a direct reference. If old_target is given, the\n"
+  "reference must point to it when the transaction is committed; otherwise\n"
+  "the reference is created if missing.");
+
+PyObject *
+RefTransaction_update(RefTransaction *self, PyObject *args)
+{
+    PyObject *py_name, *py_target, *py_old = NULL;
+
+    if (!PyArg_ParseTuple(args, "OO|O", &py_name, &py_target, &py_old))
+        return NULL;
+
+    return reftransaction_add(self, REFTX_UPDATE, py_name, py_target, py_old);
+}
+
+
+PyDoc_STRVAR(RefTransaction_delete__doc__,
+  "delete(name[, old_target])\n"
+  "\n"
+  "Queue the deletion of a reference, which must exist (and point to\n"
+  "old_target, if given) when the transaction is committed.");
+
+PyObject *
+RefTransaction_delete(RefTransaction *self, PyObject *args)
+{
+    PyObject *py_name, *py_old = NULL;
+
+    if (!PyArg_ParseTuple(args, "O|O", &py_name, &py_old))
+        return NULL;
+
+    return reftransaction_add(self, REFTX_DELETE, py_name, NULL, py_old);
+}
+
+
+static int
+reftransaction_op_cmp(const void *a, const void *b)
+{
+    return strcmp((*(RefTransactionOp * const *)a)->name,
+                  (*(RefTransactionOp * const *)b)->name);
+}
+
+/* Fails if a reference is queued more than once. */
+static int
+reftransaction_check_names(RefTransaction *self)
+{
+    RefTransactionOp **sorted;
+    size_t i;
+    int err = 0;
+
+    if (self->count < 2)
+        return 0;
+
+    sorted = malloc(self->count * sizeof(RefTransactionOp *));
+    if (sorted == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (i = 0; i < self->count; i++)
+        sorted[i] = &self->ops[i];
+
+    qsort(sorted, self->count, sizeof(RefTransactionOp *),
+          reftransaction_op_cmp);
+    for (i = 1; i < self->count; i++) {
+        if (strcmp(sorted[i - 1]->name, sorted[i]->name) == 0) {
+            PyErr_Format(PyExc_ValueError, "reference '%s' queued twice",
+                         sorted[i]->name);
+            err = -1;
+            break;
+        }
+    }
+
+    free(sorted);
+    return err;
+}
+
+/* Looks up the reference and checks the expected old value. */
+static int
+reftransaction_prepare(git_repository *repo, RefTransactionOp *op)
+{
+    int err;
+
+    err = git_reference_lookup(&op->ref, repo, op->name);
+    if (err == GIT_ENOTFOUND) {
+        op->ref = NULL;
+        if (op->kind == REFTX_CREATE)
+            return 0;
+        if (op->kind == REFTX_UPDATE && !op->has_old)
+            return 0;
+        giterr_set_str(GITERR_REFERENCE, "reference not found");
+        return GIT_ERROR;
+    }
+    if (err < 0)
+        return err;
+
+    op->existed = 1;
+    if (op->kind == REFTX_CREATE) {
+        giterr_set_str(GITERR_REFERENCE, "reference already exists");
+        return GIT_ERROR;
+    }
+
+    if (git_reference_type(op->ref) != GIT_REF_OID) {
+        if (op->kind == REFTX_DELETE && !op->has_old)
+            return 0;
+        giterr_set_str(GITERR_REFERENCE, "reference is symbolic");
+        return GIT_ERROR;
+    }
+
+    git_oid_cpy(&op->previous, git_reference_target(op->ref));
+    if (op->has_old && git_oid_cmp(&op->previous, &op->old) != 0) {
+        giterr_set_str(GITERR_REFERENCE,
+                       "reference does not point to the expected target");
+        return GIT_ERROR;
+    }
+
+    return 0;
+}
+
+static int
+reftransaction_apply(git_repository *repo, RefTransactionOp *op,
+                     const git_signature *signature, const char *message)
+{
+    git_reference *new_ref = NULL;
+    git_reflog *reflog;
+    int err;
+
+    if (op->kind == REFTX_DELETE)
+        return git_reference_delete(op->ref);
+
+    if (op->ref != NULL)
+        err = git_reference_set_target(&new_ref, op->ref, &op->target);
+    else
+        err = git_reference_create(&new_ref, repo, op->name, &op->target, 0);
+    if (err < 0)
+        return err;
+
+    if (signature != NULL) {
+        err = git_reflog_read(&reflog, new_ref);
+        if (err == 0) {
+            err = git_reflog_append(reflog, &op->target, signature, message);
+            if (err == 0)
+                err = git_reflog_write(reflog);
+            git_reflog_free(reflog);
+        }
+    }
+
+    git_reference_free(new_ref);
+    return err;
+}
+
+/* Best effort, puts the references back as they were */
+static void
+reftransaction_rollback(git_repository *repo, RefTransaction *self)
+{
+    RefTransactionOp *op;
+    git_reference *ref;
+    size_t i;
+
+    for (i = self->count; i > 0; i--) {
+        op = &self->ops[i - 1];
+        if (!op->applied)
+            continue;
+
+        if (!op->existed) {
+            if (git_reference_lookup(&ref, repo, op->name) == 0) {
+                git_reference_delete(ref);
+                git_reference_free(ref);
+            }
+        }
+        else if (op->kind == REFTX_DELETE &&
+                 git_reference_type(op->ref) != GIT_REF_OID) {
+            ref = NULL;
+            git_reference_symbolic_create(
+                &ref, repo, op->name,
+                git_reference_symbolic_target(op->ref), 1);
+            git_reference_free(ref);
+        }
+        else {
+            ref = NULL;
+            git_reference_create(&ref, repo, op->name, &op->previous, 1);
+            git_reference_free(ref);
+        }
+    }
+}
+
+
+static PyObject *
+reftransaction_commit(RefTransaction *self, const git_signature *signature,
+                      const char *message)
+{
+    git_repository *repo = self->repo->repo;
+    RefTransactionOp *op;
+    size_t i;
+    int err;
+
+    if (reftransaction_check_names(self) < 0) {
+        reftransaction_clear(self);
+        return NULL;
+    }
+
+    /* Check everything first */
+    for (i = 0; i < self->count; i++) {
+        op = &self->ops[i];
+        err = reftransaction_prepare(repo, op);
+        if (err < 0) {
+            Error_set_str(err, op->name);
+            reftransaction_clear(self);
+            return NULL;
+        }
+    }
+
+    /* Apply */
+    for (i = 0; i < self->count; i++) {
+        op = &self->ops[i];
+        err = reftransaction_apply(repo, op, signature, message);
+        if (err < 0) {
+            /* Set the error first, the rollback may overwrite it */
+            Error_set_str(err, op->name);
+            reftransaction_rollback(repo, self);
+            reftransaction_clear(self);
+            return NULL;
+        }
+        op->applied = 1;
+    }
+
+    reftransaction_clear(self);
+    Py_RETURN_NONE;
+}
+
+
+PyDoc_STRVAR(RefTransaction_commit__doc__,
+  "commit([signature, message])\n"
+  "\n"
+  "Apply the queued changes. First every reference is checked against its\n"
+  "expected state, and nothing is changed if one of them does not match.\n"
+  "Then the changes are applied; if one fails, those already applied are\n"
+  "reverted. Either way the queue is emptied.\n"
+  "\n"
+  "If a signature is given, one reflog entry is written for every created\n"
+  "or updated reference, with the given message.");
+
+PyObject *
+RefTransaction_commit(RefTransaction *self, PyObject *args)
+{
+    Signature *py_signature = NULL;
+    char *message = NULL;
+
+    if (!PyArg_ParseTuple(args, "|O!s", &SignatureType, &py_signature,
+                          &message))
+        return NULL;
+
+    return reftransaction_commit(
+        self, py_signature ? py_signature->signature : NULL, message);
+}
+
+
+PyDoc_STRVAR(RefTransaction___enter____doc__, "Return the transaction.");
+
+PyObject *
+RefTransaction___enter__(RefTransaction *self)
+{
+    Py_INCREF(self);
+    return (PyObject*)self;
+}
+
+
+PyDoc_STRVAR(RefTransaction___exit____doc__,
+  "Commit the transaction, unless an exception was raised.");
+
+PyObject *
+RefTransaction___exit__(RefTransaction *self, PyObject *args)
+{
+    PyObject *py_type, *py_value, *py_traceback, *py_result;
+
+    if (!PyArg_ParseTuple(args, "OOO", &py_type, &py_value, &py_traceback))
+        return NULL;
+
+    if (py_type != Py_None) {
+        reftransaction_clear(self);
+        Py_RETURN_FALSE;
+    }
+
+    py_result = reftransaction_commit(self, NULL, NULL);
+    if (py_result == NULL)
+        return NULL;
+    Py_DECREF(py_result);
+    Py_RETURN_FALSE;
+}
+
+
+PyMethodDef RefTransaction_methods[] = {
+    METHOD(RefTransaction, create, METH_VARARGS),
+    METHOD(RefTransaction, update, METH_VARARGS),
+    METHOD(RefTransaction, delete, METH_VARARGS),
+    METHOD(RefTransaction, commit, METH_VARARGS),
+    METHOD(RefTransaction, __enter__, METH_NOARGS),
+    METHOD(RefTransaction, __exit__, METH_VARARGS),
+    {NULL}
+};
+
+
+Py_ssize_t
+RefTransaction_len(RefTransaction *self)
+{
+    return (Py_ssize_t)self->count;
+}
+
+
+PyMappingMethods RefTransaction_as_mapping = {
+    (lenfunc)RefTransaction_len,  /* mp_length */
+    0,                            /* mp_subscript */
+    0,                            /* mp_ass_subscript */
+};
+
+
+PyDoc_STRVAR(RefTransaction__doc__,
+  "Reference transactions, to change many references in one go. The\n"
+  "length of a transaction is the number of queued changes.");
+
+PyTypeObject RefTransactionType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_pygit2.RefTransaction",                  /* tp_name           */
+    sizeof(RefTransaction),                    /* tp_basicsize      */
+    0,                                         /* tp_itemsize       */
+    (destructor)RefTransaction_dealloc,        /* tp_dealloc        */
+    0,                                         /* tp_print          */
+    0,                                         /* tp_getattr        */
+    0,                                         /* tp_setattr        */
+    0,                                         /* tp_compare        */
+    0,                                         /* tp_repr           */
+    0,                                         /* tp_as_number      */
+    0,                                         /* tp_as_sequence    */
+    &RefTransaction_as_mapping,                /* tp_as_mapping     */
+    0,                                         /* tp_hash           */
+    0,                                         /* tp_call           */
+    0,                                         /* tp_str            */
+    0,                                         /* tp_getattro       */
+    0,                                         /* tp_setattro       */
+    0,                                         /* tp_as_buffer      */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,  /* tp_flags          */
+    RefTransaction__doc__,                     /* tp_doc            */
+    0,                                         /* tp_traverse       */
+    0,                                         /* tp_clear          */
+    0,                                         /* tp_richcompare    */
+    0,                                         /* tp_weaklistoffset */
+    0,                                         /* tp_iter           */
+    0,                                         /* tp_iternext       */
+    RefTransaction_methods,                    /* tp_methods        */
+    0,                                         /* tp_members        */
+    0,                                         /* tp_getset         */
+    0,                                         /* tp_base           */
+    0,                                         /* tp_dict           */
+    0,                                         /* tp_descr_get      */
+    0,                                         /* tp_descr_set      */
+    0,                                         /* tp_dictoffset     */
+    0,                                         /* tp_init           */
+    0,                                         /* tp_alloc          */
+    0,                                         /* tp_new            */
+};
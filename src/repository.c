@@ -37,6 +37,12 @@
 #include "repository.h"
 #include "remote.h"
 #include "branch.h"
+#include "treebuilder.h"
+#include "rewrite.h"
+#include "graph.h"
+#include "blame.h"
+#include "grep.h"
+#include "similarity.h"
 #include <git2/odb_backend.h>
 
 extern PyObject *GitError;
@@ -48,6 +54,10 @@ extern PyTypeObject ObjectType;
 extern PyTypeObject CommitType;
 extern PyTypeObject TreeType;
 extern PyTypeObject TreeBuilderType;
+extern PyTypeObject TreeEditorType;
+extern PyTypeObject ReferenceIterType;
+extern PyTypeObject BlameIterType;
+extern PyTypeObject RefTransactionType;
 extern PyTypeObject ConfigType;
 extern PyTypeObject DiffType;
 extern PyTypeObject RemoteType;
@@ -90,6 +100,9 @@ Repository_init(Repository *self, PyObject *args, PyObject *kwds)
 
     self->config = NULL;
     self->index = NULL;
+    self->graph = NULL;
+    self->similarity = NULL;
+    self->strings = NULL;
 
     return 0;
 }
@@ -100,6 +113,9 @@ Repository_dealloc(Repository *self)
     PyObject_GC_UnTrack(self);
     Py_CLEAR(self->index);
     Py_CLEAR(self->config);
+    Py_CLEAR(self->strings);
+    commit_graph_free(self->graph);
+    similarity_cache_free(self->similarity);
     git_repository_free(self->repo);
     PyObject_GC_Del(self);
 }
@@ -570,6 +586,597 @@ Repository_merge_base(Repository *self, PyObject *args)
     return git_oid_to_python(&oid);
 }
 
+static commit_graph *
+Repository_graph(Repository *self)
+{
+    if (self->graph == NULL) {
+        self->graph = commit_graph_new();
+        if (self->graph == NULL)
+            PyErr_NoMemory();
+    }
+
+    return self->graph;
+}
+
+similarity_cache *
+Repository_similarity(Repository *self)
+{
+    if (self->similarity == NULL) {
+        self->similarity = similarity_cache_new();
+        if (self->similarity == NULL)
+            PyErr_NoMemory();
+    }
+
+    return self->similarity;
+}
+
+
+PyDoc_STRVAR(Repository_merge_base_many__doc__,
+  "merge_base_many(target, heads) -> [Oid or None, ...]\n"
+  "\n"
+  "Find the merge base of the target with every head, None if they have no\n"
+  "common ancestor. The ancestry of the commits is cached by the\n"
+  "repository, so later queries against the same target, or parts of the\n"
+  "same history, do not read the commits again.");
+
+PyObject *
+Repository_merge_base_many(Repository *self, PyObject *args)
+{
+    PyObject *py_target, *py_heads, *py_seq, *py_oid, *py_result = NULL;
+    commit_graph *graph;
+    git_oid target, *heads = NULL, *bases = NULL;
+    int *found = NULL;
+    Py_ssize_t i, n;
+    int err;
+
+    if (!PyArg_ParseTuple(args, "OO", &py_target, &py_heads))
+        return NULL;
+
+    err = py_oid_to_git_oid_expand(self->repo, py_target, &target);
+    if (err < 0)
+        return NULL;
+
+    graph = Repository_graph(self);
+    if (graph == NULL)
+        return NULL;
+
+    py_seq = PySequence_Fast(py_heads, "expected a sequence of oids");
+    if (py_seq == NULL)
+        return NULL;
+
+    n = PySequence_Fast_GET_SIZE(py_seq);
+    heads = malloc(n * sizeof(git_oid) + 1);
+    bases = malloc(n * sizeof(git_oid) + 1);
+    found = malloc(n * sizeof(int) + 1);
+    if (heads == NULL || bases == NULL || found == NULL) {
+        PyErr_NoMemory();
+        goto out;
+    }
+
+    for (i = 0; i < n; i++) {
+        err = py_oid_to_git_oid_expand(self->repo,
+                                       PySequence_Fast_GET_ITEM(py_seq, i),
+                                       &heads[i]);
+        if (err < 0)
+            goto out;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    err = commit_graph_merge_base_many(bases, found, graph, self->repo,
+                                       &target, heads, n);
+    Py_END_ALLOW_THREADS
+    if (err < 0) {
+        Error_set(err);
+        goto out;
+    }
+
+    py_result = PyList_New(n);
+    if (py_result == NULL)
+        goto out;
+
+    for (i = 0; i < n; i++) {
+        if (found[i]) {
+            py_oid = git_oid_to_python(&bases[i]);
+            if (py_oid == NULL) {
+                Py_CLEAR(py_result);
+                goto out;
+            }
+        }
+        else {
+            Py_INCREF(Py_None);
+            py_oid = Py_None;
+        }
+        PyList_SET_ITEM(py_result, i, py_oid);
+    }
+
+out:
+    free(heads);
+    free(bases);
+    free(found);
+    Py_DECREF(py_seq);
+    return py_result;
+}
+
+
+PyDoc_STRVAR(Repository_merge_base_octopus__doc__,
+  "merge_base_octopus(oids) -> Oid\n"
+  "\n"
+  "Find the merge base of all the given commits, as needed to merge them\n"
+  "together at once (an octopus merge). Uses the same cache as\n"
+  "merge_base_many().");
+
+PyObject *
+Repository_merge_base_octopus(Repository *self, PyObject *py_oids)
+{
+    PyObject *py_seq, *py_result = NULL;
+    commit_graph *graph;
+    git_oid base, *oids = NULL;
+    Py_ssize_t i, n;
+    int err;
+
+    graph = Repository_graph(self);
+    if (graph == NULL)
+        return NULL;
+
+    py_seq = PySequence_Fast(py_oids, "expected a sequence of oids");
+    if (py_seq == NULL)
+        return NULL;
+
+    n = PySequence_Fast_GET_SIZE(py_seq);
+    oids = malloc(n * sizeof(git_oid) + 1);
+    if (oids == NULL) {
+        PyErr_NoMemory();
+        goto out;
+    }
+
+    for (i = 0; i < n; i++) {
+        err = py_oid_to_git_oid_expand(self->repo,
+                                       PySequence_Fast_GET_ITEM(py_seq, i),
+                                       &oids[i]);
+        if (err < 0)
+            goto out;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    err = commit_graph_merge_base_octopus(&base, graph, self->repo, oids, n);
+    Py_END_ALLOW_THREADS
+    if (err < 0)
+        Error_set(err);
+    else
+        py_result = git_oid_to_python(&base);
+
+out:
+    free(oids);
+    Py_DECREF(py_seq);
+    return py_result;
+}
+
+
+PyDoc_STRVAR(Repository_merge_trees__doc__,
+  "merge_trees(ancestor, ours, theirs[, flags, rename_threshold,\n"
+  "            target_limit, automerge]) -> Index\n"
+  "\n"
+  "Merge two trees, with the given common ancestor (which may be None),\n"
+  "and return the result as an in-memory Index. Conflicting files are left\n"
+  "in it, see Index.conflicts(). Neither the working copy nor the index of\n"
+  "the repository are touched, and the GIL is released, so trial merges may\n"
+  "run in parallel threads.\n"
+  "\n"
+  "Arguments:\n"
+  "\n"
+  "flags: GIT_MERGE_TREE_FIND_RENAMES to detect renames.\n"
+  "\n"
+  "rename_threshold: similarity to consider a file renamed (default 50).\n"
+  "\n"
+  "target_limit: maximum similarity sources to examine (default 200).\n"
+  "\n"
+  "automerge: a GIT_MERGE_AUTOMERGE_* constant, how to resolve the\n"
+  "   conflicting changes in a file (default GIT_MERGE_AUTOMERGE_NORMAL).");
+
+PyObject *
+Repository_merge_trees(Repository *self, PyObject *args, PyObject *kwds)
+{
+    char *keywords[] = {"ancestor", "ours", "theirs", "flags",
+                        "rename_threshold", "target_limit", "automerge",
+                        NULL};
+    git_merge_tree_opts opts = GIT_MERGE_TREE_OPTS_INIT;
+    PyObject *py_ancestor;
+    Tree *ours, *theirs;
+    git_tree *ancestor = NULL;
+    git_index *index;
+    Index *py_index;
+    unsigned int flags = 0;
+    int automerge = GIT_MERGE_AUTOMERGE_NORMAL;
+    int err;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO!O!|IIIi", keywords,
+                                     &py_ancestor, &TreeType, &ours,
+                                     &TreeType, &theirs, &flags,
+                                     &opts.rename_threshold,
+                                     &opts.target_limit, &automerge))
+        return NULL;
+
+    if (py_ancestor != Py_None) {
+        if (!PyObject_TypeCheck(py_ancestor, &TreeType)) {
+            PyErr_SetString(PyExc_TypeError, "ancestor must be a Tree or None");
+            return NULL;
+        }
+        ancestor = ((Tree*)py_ancestor)->tree;
+    }
+
+    opts.flags = flags;
+    opts.automerge_flags = automerge;
+
+    Py_BEGIN_ALLOW_THREADS
+    err = git_merge_trees(&index, self->repo, ancestor, ours->tree,
+                          theirs->tree, &opts);
+    Py_END_ALLOW_THREADS
+    if (err < 0)
+        return Error_set(err);
+
+    py_index = PyObject_GC_New(Index, &IndexType);
+    if (py_index == NULL) {
+        git_index_free(index);
+        return NULL;
+    }
+
+    Py_INCREF(self);
+    py_index->repo = self;
+    py_index->index = index;
+    PyObject_GC_Track(py_index);
+    return (PyObject*)py_index;
+}
+
+
+PyDoc_STRVAR(Repository_ahead_behind__doc__,
+  "ahead_behind(local, upstream) -> (int, int)\n"
+  "\n"
+  "Count the commits reachable from local but not from upstream (ahead),\n"
+  "and the other way around (behind).");
+
+PyObject *
+Repository_ahead_behind(Repository *self, PyObject *args)
+{
+    PyObject *py_local, *py_upstream;
+    git_oid local, upstream;
+    size_t ahead, behind;
+    int err;
+
+    if (!PyArg_ParseTuple(args, "OO", &py_local, &py_upstream))
+        return NULL;
+
+    err = py_oid_to_git_oid_expand(self->repo, py_local, &local);
+    if (err < 0)
+        return NULL;
+
+    err = py_oid_to_git_oid_expand(self->repo, py_upstream, &upstream);
+    if (err < 0)
+        return NULL;
+
+    Py_BEGIN_ALLOW_THREADS
+    err = git_graph_ahead_behind(&ahead, &behind, self->repo, &local,
+                                 &upstream);
+    Py_END_ALLOW_THREADS
+    if (err < 0)
+        return Error_set(err);
+
+    return Py_BuildValue("(nn)", (Py_ssize_t)ahead, (Py_ssize_t)behind);
+}
+
+
+PyDoc_STRVAR(Repository_ahead_behind_many__doc__,
+  "ahead_behind_many(pairs) -> [(int, int), ...]\n"
+  "\n"
+  "Same as ahead_behind() for every (local, upstream) pair of the given\n"
+  "sequence, for instance all the branches of a repository with their\n"
+  "upstreams. The counts are returned in the same order.");
+
+PyObject *
+Repository_ahead_behind_many(Repository *self, PyObject *py_pairs)
+{
+    PyObject *py_seq, *py_pair, *py_result = NULL;
+    git_oid *oids = NULL;
+    size_t *counts = NULL;
+    Py_ssize_t i, n;
+    int err = 0;
+
+    py_seq = PySequence_Fast(py_pairs, "expected a sequence of pairs");
+    if (py_seq == NULL)
+        return NULL;
+
+    n = PySequence_Fast_GET_SIZE(py_seq);
+    oids = malloc(2 * n * sizeof(git_oid) + 1);
+    counts = malloc(2 * n * sizeof(size_t) + 1);
+    if (oids == NULL || counts == NULL) {
+        PyErr_NoMemory();
+        goto out;
+    }
+
+    for (i = 0; i < n; i++) {
+        py_pair = PySequence_Fast_GET_ITEM(py_seq, i);
+        if (!PyTuple_Check(py_pair) || PyTuple_GET_SIZE(py_pair) != 2) {
+            PyErr_SetString(PyExc_TypeError,
+                            "expected a (local, upstream) pair");
+            goto out;
+        }
+
+        err = py_oid_to_git_oid_expand(self->repo,
+                                       PyTuple_GET_ITEM(py_pair, 0),
+                                       &oids[2 * i]);
+        if (err < 0)
+            goto out;
+
+        err = py_oid_to_git_oid_expand(self->repo,
+                                       PyTuple_GET_ITEM(py_pair, 1),
+                                       &oids[2 * i + 1]);
+        if (err < 0)
+            goto out;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < n && err == 0; i++)
+        err = git_graph_ahead_behind(&counts[2 * i], &counts[2 * i + 1],
+                                     self->repo, &oids[2 * i],
+                                     &oids[2 * i + 1]);
+    Py_END_ALLOW_THREADS
+    if (err < 0) {
+        Error_set(err);
+        goto out;
+    }
+
+    py_result = PyList_New(n);
+    if (py_result == NULL)
+        goto out;
+
+    for (i = 0; i < n; i++) {
+        py_pair = Py_BuildValue("(nn)", (Py_ssize_t)counts[2 * i],
+                                (Py_ssize_t)counts[2 * i + 1]);
+        if (py_pair == NULL) {
+            Py_CLEAR(py_result);
+            goto out;
+        }
+        PyList_SET_ITEM(py_result, i, py_pair);
+    }
+
+out:
+    free(oids);
+    free(counts);
+    Py_DECREF(py_seq);
+    return py_result;
+}
+
+
+PyDoc_STRVAR(Repository_descendant_of__doc__,
+  "descendant_of(oid, ancestor) -> bool\n"
+  "\n"
+  "Return whether the first commit descends from the second one. A commit\n"
+  "is not a descendant of itself.");
+
+PyObject *
+Repository_descendant_of(Repository *self, PyObject *args)
+{
+    PyObject *py_commit, *py_ancestor;
+    git_oid commit, ancestor, base;
+    int err;
+
+    if (!PyArg_ParseTuple(args, "OO", &py_commit, &py_ancestor))
+        return NULL;
+
+    err = py_oid_to_git_oid_expand(self->repo, py_commit, &commit);
+    if (err < 0)
+        return NULL;
+
+    err = py_oid_to_git_oid_expand(self->repo, py_ancestor, &ancestor);
+    if (err < 0)
+        return NULL;
+
+    if (git_oid_equal(&commit, &ancestor))
+        Py_RETURN_FALSE;
+
+    /* The merge base of a commit and one of its ancestors is the ancestor */
+    Py_BEGIN_ALLOW_THREADS
+    err = git_merge_base(&base, self->repo, &commit, &ancestor);
+    Py_END_ALLOW_THREADS
+    if (err == GIT_ENOTFOUND)
+        Py_RETURN_FALSE;
+    if (err < 0)
+        return Error_set(err);
+
+    return PyBool_FromLong(git_oid_equal(&base, &ancestor));
+}
+
+
+PyDoc_STRVAR(Repository_grep_blobs__doc__,
+  "grep_blobs(oids, literal) -> [(int, int, bytes), ...]\n"
+  "\n"
+  "Find the lines of the blobs which contain the literal (a bytes string),\n"
+  "or every line if it is empty. The oids are given as a bytes string of\n"
+  "raw oids, see Tree.walk. Return a list of (blob, line_no, line) tuples,\n"
+  "where blob is the position of the blob in oids, line numbers start at 1,\n"
+  "and the lines have no end of line. Binary blobs are skipped.\n"
+  "\n"
+  "The blobs are scanned in place, with the GIL released. This is the low\n"
+  "level part of Repository.grep.");
+
+PyObject *
+Repository_grep_blobs(Repository *self, PyObject *args)
+{
+    const char *oids, *literal, *text;
+    Py_ssize_t oids_len, literal_len;
+    const grep_match *matches;
+    PyObject *py_result, *py_match;
+    grep *grep;
+    size_t i, count;
+    int err;
+
+    if (!PyArg_ParseTuple(args, "s#s#", &oids, &oids_len, &literal,
+                          &literal_len))
+        return NULL;
+
+    if (oids_len % GIT_OID_RAWSZ != 0) {
+        PyErr_SetString(PyExc_ValueError,
+                        "oids must be a sequence of raw oids");
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    err = grep_blobs(&grep, self->repo, (const git_oid *)oids,
+                     oids_len / GIT_OID_RAWSZ, literal, literal_len);
+    Py_END_ALLOW_THREADS
+    if (err < 0)
+        return Error_set(err);
+
+    matches = grep_results(grep, &count);
+    text = grep_text(grep);
+    py_result = PyList_New(count);
+    for (i = 0; i < count && py_result != NULL; i++) {
+        py_match = Py_BuildValue(
+        #if PY_MAJOR_VERSION == 2
+            "(nns#)",
+        #else
+            "(nny#)",
+        #endif
+            (Py_ssize_t)matches[i].blob, (Py_ssize_t)matches[i].line_no,
+            text + matches[i].offset, (Py_ssize_t)matches[i].len);
+        if (py_match == NULL)
+            Py_CLEAR(py_result);
+        else
+            PyList_SET_ITEM(py_result, i, py_match);
+    }
+
+    grep_free(grep);
+    return py_result;
+}
+
+
+PyDoc_STRVAR(Repository_blame__doc__,
+  "blame(path[, newest, oldest, min_line, max_line, incremental])\n"
+  "    -> [(int, int, Oid, int, bool), ...]\n"
+  "\n"
+  "Find the commits that last changed the lines of a file. The result is a\n"
+  "list of hunks (final_start, lines, commit, orig_start, boundary), sorted\n"
+  "by line: the lines from final_start (line numbers start at 1) were last\n"
+  "changed by the commit, where they started at orig_start. Boundary is\n"
+  "True if the lines are as old as the oldest commit, or older.\n"
+  "\n"
+  "Arguments:\n"
+  "\n"
+  "newest: the commit to start from (default HEAD).\n"
+  "\n"
+  "oldest: the commit where to stop (default none, stop at the roots).\n"
+  "\n"
+  "min_line, max_line: the lines to blame (default all of them).\n"
+  "\n"
+  "incremental: if True return an iterator, which yields the hunks as they\n"
+  "   are found, newest commits first. They are not merged nor sorted.\n"
+  "\n"
+  "Renames and copies are not followed. The GIL is released while the\n"
+  "history is walked.");
+
+PyObject *
+Repository_blame(Repository *self, PyObject *args, PyObject *kwds)
+{
+    char *keywords[] = {"path", "newest", "oldest", "min_line", "max_line",
+                        "incremental", NULL};
+    PyObject *py_newest = Py_None, *py_oldest = Py_None, *py_result;
+    PyObject *py_hunk;
+    BlameIter *py_iter;
+    const blame_hunk *hunks;
+    blame *blame;
+    git_oid newest, oldest;
+    char *path;
+    Py_ssize_t min_line = 1, max_line = 0;
+    size_t i, count;
+    int incremental = 0, empty, err;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|OOnni", keywords, &path,
+                                     &py_newest, &py_oldest, &min_line,
+                                     &max_line, &incremental))
+        return NULL;
+
+    if (py_newest == Py_None)
+        err = git_reference_name_to_id(&newest, self->repo, "HEAD");
+    else
+        err = py_oid_to_git_oid_expand(self->repo, py_newest, &newest);
+    if (err < 0)
+        return py_newest == Py_None ? Error_set(err) : NULL;
+
+    if (py_oldest != Py_None) {
+        err = py_oid_to_git_oid_expand(self->repo, py_oldest, &oldest);
+        if (err < 0)
+            return NULL;
+    }
+
+    err = blame_new(&blame, self->repo, path, &newest,
+                    py_oldest == Py_None ? NULL : &oldest);
+    if (err < 0)
+        return Error_set_str(err, path);
+
+    count = blame_line_count(blame);
+    /* The whole of an empty file is no line at all, and no hunk */
+    empty = (count == 0 && min_line == 1 && max_line == 0);
+    if (max_line == 0)
+        max_line = count;
+    if (!empty &&
+        (min_line < 1 || max_line < min_line || (size_t)max_line > count)) {
+        blame_free(blame);
+        PyErr_SetString(PyExc_ValueError, "line range out of the file");
+        return NULL;
+    }
+
+    err = blame_start(blame, min_line, max_line);
+    if (err < 0)
+        goto error;
+
+    if (incremental) {
+        READY_TYPE(BlameIterType, NULL)
+        py_iter = PyObject_New(BlameIter, &BlameIterType);
+        if (py_iter == NULL) {
+            blame_free(blame);
+            return NULL;
+        }
+
+        Py_INCREF(self);
+        py_iter->owner = self;
+        py_iter->blame = blame;
+        py_iter->emitted = 0;
+        py_iter->done = 0;
+        return (PyObject*)py_iter;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    while ((err = blame_step(blame)) > 0);
+    if (err == 0)
+        blame_coalesce(blame);
+    Py_END_ALLOW_THREADS
+    if (err < 0)
+        goto error;
+
+    hunks = blame_results(blame, &count);
+    py_result = PyList_New(count);
+    if (py_result == NULL) {
+        blame_free(blame);
+        return NULL;
+    }
+
+    for (i = 0; i < count; i++) {
+        py_hunk = wrap_blame_hunk(&hunks[i]);
+        if (py_hunk == NULL) {
+            Py_CLEAR(py_result);
+            break;
+        }
+        PyList_SET_ITEM(py_result, i, py_hunk);
+    }
+
+    blame_free(blame);
+    return py_result;
+
+error:
+    blame_free(blame);
+    return Error_set(err);
+}
+
+
 PyDoc_STRVAR(Repository_walk__doc__,
   "walk(oid, sort_mode) -> iterator\n"
   "\n"
@@ -641,6 +1248,11 @@ Repository_walk(Repository *self, PyObject *args)
     Py_INCREF(self);
     py_walker->repo = self;
     py_walker->walk = walk;
+    py_walker->paths = NULL;
+    py_walker->paths_count = 0;
+    py_walker->follow_renames = 0;
+    py_walker->follow_path = NULL;
+    py_walker->walking = 0;
     return (PyObject*)py_walker;
 }
 
@@ -718,88 +1330,564 @@ Repository_create_blob_fromdisk(Repository *self, PyObject *args)
 }
 
 
-PyDoc_STRVAR(Repository_create_commit__doc__,
-  "create_commit(reference, author, committer, message, tree, parents[, encoding]) -> Oid\n"
+/* Formats a signature line of a commit buffer, like libgit2 does. */
+static char *
+format_signature(char *p, const char *header, const git_signature *sig)
+{
+    int offset = sig->when.offset;
+    char sign = '+';
+
+    if (offset < 0) {
+        sign = '-';
+        offset = -offset;
+    }
+
+    return p + sprintf(p, "%s%s <%s> %u %c%02d%02d\n", header, sig->name,
+                       sig->email, (unsigned)sig->when.time, sign,
+                       offset / 60, offset % 60);
+}
+
+/*
+ * Writes a commit object straight from the given ids, without loading the
+ * tree nor the parents (the caller vouches they exist). The buffer is the
+ * same git_commit_create would write.
+ */
+int
+write_commit(git_oid *out, git_odb *odb, const git_oid *tree,
+             const git_oid *parents, size_t parent_count,
+             const git_signature *author, const git_signature *committer,
+             const char *encoding, const char *message)
+{
+    char *buffer, *p;
+    size_t i, size;
+    int err;
+
+    size = (6 + GIT_OID_HEXSZ) + parent_count * (8 + GIT_OID_HEXSZ)
+         + strlen(author->name) + strlen(author->email) + 48
+         + strlen(committer->name) + strlen(committer->email) + 48
+         + (encoding ? strlen(encoding) + 10 : 0)
+         + strlen(message) + 2;
+
+    buffer = malloc(size);
+    if (buffer == NULL) {
+        giterr_set_oom();
+        return GIT_ERROR;
+    }
+
+    p = buffer;
+    p += sprintf(p, "tree ");
+    git_oid_fmt(p, tree);
+    p += GIT_OID_HEXSZ;
+    *p++ = '\n';
+    for (i = 0; i < parent_count; i++) {
+        p += sprintf(p, "parent ");
+        git_oid_fmt(p, &parents[i]);
+        p += GIT_OID_HEXSZ;
+        *p++ = '\n';
+    }
+    p = format_signature(p, "author ", author);
+    p = format_signature(p, "committer ", committer);
+    if (encoding)
+        p += sprintf(p, "encoding %s\n", encoding);
+    *p++ = '\n';
+    p += sprintf(p, "%s", message);
+
+    err = git_odb_write(out, odb, buffer, p - buffer, GIT_OBJ_COMMIT);
+    free(buffer);
+    return err;
+}
+
+/* Points the given reference, or the one it refers to if it is symbolic
+ * (like HEAD), to the given oid. The reference is created if missing. */
+int
+update_reference_terminal(git_repository *repo, const char *name,
+                          const git_oid *oid)
+{
+    git_reference *ref, *new_ref = NULL;
+    char *target = NULL;
+    int err, depth;
+
+    for (depth = 0; depth < 5; depth++) {
+        err = git_reference_lookup(&ref, repo, name);
+        if (err == GIT_ENOTFOUND) {
+            err = git_reference_create(&new_ref, repo, name, oid, 0);
+            break;
+        }
+        if (err < 0)
+            break;
+
+        if (git_reference_type(ref) == GIT_REF_OID) {
+            err = git_reference_set_target(&new_ref, ref, oid);
+            git_reference_free(ref);
+            break;
+        }
+
+        /* Symbolic, follow it */
+        free(target);
+        target = strdup(git_reference_symbolic_target(ref));
+        git_reference_free(ref);
+        if (target == NULL) {
+            giterr_set_oom();
+            err = GIT_ERROR;
+            break;
+        }
+        name = target;
+    }
+
+    if (depth == 5) {
+        giterr_set_str(GITERR_REFERENCE, "too many nested symbolic references");
+        err = GIT_ERROR;
+    }
+
+    free(target);
+    git_reference_free(new_ref);
+    return err;
+}
+
+
+PyDoc_STRVAR(Repository_create_commit__doc__,
+  "create_commit(reference, author, committer, message, tree, parents[, encoding, lookup]) -> Oid\n"
+  "\n"
+  "Create a new commit object, return its oid.\n"
+  "\n"
+  "The tree and the parents are looked up, to check that they exist and\n"
+  "are of the right type. With lookup=False, if they are all given as full\n"
+  "oids, the commit is written straight from their ids instead: it is then\n"
+  "up to the caller to make sure they exist. Short oids are always looked\n"
+  "up, to be expanded.");
+
+PyObject *
+Repository_create_commit(Repository *self, PyObject *args, PyObject *kwds)
+{
+    char *keywords[] = {"reference", "author", "committer", "message", "tree",
+                        "parents", "encoding", "lookup", NULL};
+    Signature *py_author, *py_committer;
+    PyObject *py_oid, *py_message, *py_parents, *py_parent;
+    PyObject *py_result = NULL;
+    char *message = NULL;
+    char *update_ref = NULL;
+    char *encoding = NULL;
+    git_oid oid;
+    git_oid *parent_oids = NULL;
+    git_odb *odb = NULL;
+    git_tree *tree = NULL;
+    int parent_count;
+    git_commit **parents = NULL;
+    int err = 0, i = 0, lookup = 1, full;
+    size_t len;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "zO!O!OOO!|si", keywords,
+                                     &update_ref,
+                                     &SignatureType, &py_author,
+                                     &SignatureType, &py_committer,
+                                     &py_message,
+                                     &py_oid,
+                                     &PyList_Type, &py_parents,
+                                     &encoding,
+                                     &lookup))
+        return NULL;
+
+    message = py_str_to_c_str(py_message, encoding);
+    if (message == NULL)
+        goto out;
+
+    /* Convert the oids, the first one is the tree */
+    full = !lookup;
+    parent_count = (int)PyList_Size(py_parents);
+    parent_oids = malloc((parent_count + 1) * sizeof(git_oid));
+    if (parent_oids == NULL) {
+        PyErr_SetNone(PyExc_MemoryError);
+        goto out;
+    }
+    for (i = 0; i <= parent_count; i++) {
+        py_parent = i ? PyList_GET_ITEM(py_parents, i - 1) : py_oid;
+        len = py_oid_to_git_oid(py_parent, &parent_oids[i]);
+        if (len == 0)
+            goto out;
+        if (len != GIT_OID_HEXSZ)
+            full = 0;
+    }
+    i = 0;
+
+    /* Fast path, asked for: write the commit from the ids */
+    if (full) {
+        err = git_repository_odb(&odb, self->repo);
+        if (err == 0)
+            err = write_commit(&oid, odb, &parent_oids[0], parent_oids + 1,
+                               parent_count, py_author->signature,
+                               py_committer->signature, encoding, message);
+        if (err == 0 && update_ref != NULL)
+            err = update_reference_terminal(self->repo, update_ref, &oid);
+        if (err < 0) {
+            Error_set(err);
+            goto out;
+        }
+
+        py_result = git_oid_to_python(&oid);
+        goto out;
+    }
+
+    len = py_oid_to_git_oid(py_oid, &oid);
+    err = git_tree_lookup_prefix(&tree, self->repo, &oid, len);
+    if (err < 0) {
+        Error_set(err);
+        goto out;
+    }
+
+    parents = malloc(parent_count * sizeof(git_commit*));
+    if (parents == NULL) {
+        PyErr_SetNone(PyExc_MemoryError);
+        goto out;
+    }
+    for (; i < parent_count; i++) {
+        py_parent = PyList_GET_ITEM(py_parents, i);
+        len = py_oid_to_git_oid(py_parent, &oid);
+        if (len == 0)
+            goto out;
+        err = git_commit_lookup_prefix(&parents[i], self->repo, &oid, len);
+        if (err < 0) {
+            Error_set(err);
+            goto out;
+        }
+    }
+
+    err = git_commit_create(&oid, self->repo, update_ref,
+                            py_author->signature, py_committer->signature,
+                            encoding, message, tree, parent_count,
+                            (const git_commit**)parents);
+    if (err < 0) {
+        Error_set(err);
+        goto out;
+    }
+
+    py_result = git_oid_to_python(&oid);
+
+out:
+    free(message);
+    free(parent_oids);
+    git_odb_free(odb);
+    git_tree_free(tree);
+    if (parents == NULL)
+        i = 0;
+    while (i > 0) {
+        i--;
+        git_commit_free(parents[i]);
+    }
+    free(parents);
+    return py_result;
+}
+
+
+PyDoc_STRVAR(Repository_create_commits__doc__,
+  "create_commits(commits[, reference]) -> [Oid, ...]\n"
+  "\n"
+  "Create many commits at once, return their oids.\n"
+  "\n"
+  "commits is a list of (author, committer, message, tree, parents[,\n"
+  "encoding]) tuples. Like create_commit, but the tree and parents must be\n"
+  "full oids, as nothing is looked up; besides, a parent may be given as an\n"
+  "integer, the index of an earlier commit in the list, so a whole chain of\n"
+  "commits can be created in a single call.\n"
+  "\n"
+  "If given, the reference is updated to point to the last commit.");
+
+PyObject *
+Repository_create_commits(Repository *self, PyObject *args)
+{
+    PyObject *py_commits, *py_item, *py_message, *py_tree, *py_parents;
+    PyObject *py_parent, *py_result = NULL;
+    Signature *py_author, *py_committer;
+    char *update_ref = NULL, *encoding, *message;
+    git_oid *oids = NULL, *parents = NULL;
+    git_odb *odb = NULL;
+    Py_ssize_t i, j, n, parent_count, parent_alloc = 0;
+    long index;
+    void *tmp;
+    int err;
+
+    if (!PyArg_ParseTuple(args, "O!|z", &PyList_Type, &py_commits,
+                          &update_ref))
+        return NULL;
+
+    n = PyList_GET_SIZE(py_commits);
+    oids = malloc((n > 0 ? n : 1) * sizeof(git_oid));
+    if (oids == NULL)
+        return PyErr_NoMemory();
+
+    err = git_repository_odb(&odb, self->repo);
+    if (err < 0) {
+        Error_set(err);
+        goto out;
+    }
+
+    for (i = 0; i < n; i++) {
+        py_item = PyList_GET_ITEM(py_commits, i);
+        encoding = NULL;
+        if (!PyArg_ParseTuple(py_item, "O!O!OOO!|s",
+                              &SignatureType, &py_author,
+                              &SignatureType, &py_committer,
+                              &py_message, &py_tree,
+                              &PyList_Type, &py_parents,
+                              &encoding))
+            goto out;
+
+        /* Parents */
+        parent_count = PyList_GET_SIZE(py_parents);
+        if (parent_count > parent_alloc) {
+            tmp = realloc(parents, parent_count * sizeof(git_oid));
+            if (tmp == NULL) {
+                PyErr_NoMemory();
+                goto out;
+            }
+            parents = tmp;
+            parent_alloc = parent_count;
+        }
+        for (j = 0; j <= parent_count; j++) {
+            /* The tree goes in oids[i], overwritten by the commit */
+            py_parent = j ? PyList_GET_ITEM(py_parents, j - 1) : py_tree;
+            if (j && PyLong_Check(py_parent)) {
+                index = PyLong_AsLong(py_parent);
+                if (index == -1 && PyErr_Occurred())
+                    goto out;
+                if (index < 0 || index >= i) {
+                    PyErr_SetObject(PyExc_IndexError, py_parent);
+                    goto out;
+                }
+                git_oid_cpy(&parents[j - 1], &oids[index]);
+                continue;
+            }
+
+            if (py_oid_to_git_oid(py_parent, j ? &parents[j - 1] : &oids[i])
+                != GIT_OID_HEXSZ) {
+                if (!PyErr_Occurred())
+                    PyErr_SetString(PyExc_ValueError,
+                                    "full oids are required");
+                goto out;
+            }
+        }
+
+        message = py_str_to_c_str(py_message, encoding);
+        if (message == NULL)
+            goto out;
+
+        err = write_commit(&oids[i], odb, &oids[i], parents, parent_count,
+                           py_author->signature, py_committer->signature,
+                           encoding, message);
+        free(message);
+        if (err < 0) {
+            Error_set(err);
+            goto out;
+        }
+    }
+
+    if (update_ref != NULL && n > 0) {
+        err = update_reference_terminal(self->repo, update_ref, &oids[n - 1]);
+        if (err < 0) {
+            Error_set(err);
+            goto out;
+        }
+    }
+
+    py_result = PyList_New(n);
+    if (py_result == NULL)
+        goto out;
+    for (i = 0; i < n; i++) {
+        py_item = git_oid_to_python(&oids[i]);
+        if (py_item == NULL) {
+            Py_CLEAR(py_result);
+            goto out;
+        }
+        PyList_SET_ITEM(py_result, i, py_item);
+    }
+
+out:
+    git_odb_free(odb);
+    free(oids);
+    free(parents);
+    return py_result;
+}
+
+
+PyDoc_STRVAR(Repository_rewrite_history__doc__,
+  "rewrite_history(start_refs[, tree_filter, commit_filter, path_filter, author_map]) -> dict\n"
+  "\n"
+  "Rewrite the history of the given references (a list of names), like\n"
+  "git filter-branch does, and update them. Returns a dict from the\n"
+  "reference names to their new targets (None if every commit was\n"
+  "dropped).\n"
+  "\n"
+  "The references may point to annotated tags: the tags are written again,\n"
+  "pointing to the new commits (without their signatures), like\n"
+  "'git filter-branch --tag-name-filter cat' does.\n"
+  "\n"
+  "The commits are visited parents first. Trees are rewritten once per\n"
+  "distinct tree, and the commits that do not change are kept as they are.\n"
+  "The declarative filters run natively; Python is only called for the\n"
+  "callbacks, when given.\n"
+  "\n"
+  "Arguments:\n"
+  "\n"
+  "path_filter: a list of paths (files or directories) to remove from\n"
+  "   every tree.\n"
+  "\n"
+  "author_map: a dict from emails to (name, email) tuples, applied to the\n"
+  "   authors and committers.\n"
   "\n"
-  "Create a new commit object, return its oid.");
+  "tree_filter: a callable, called with the oid of every distinct root\n"
+  "   tree (after path_filter), returning the oid of the new tree (or None\n"
+  "   to keep it).\n"
+  "\n"
+  "commit_filter: a callable, called with every original commit, returning\n"
+  "   an (author, committer, message) tuple, or None to drop the commit\n"
+  "   (its children are then attached to its first parent). author_map is\n"
+  "   applied to the returned signatures.\n");
 
 PyObject *
-Repository_create_commit(Repository *self, PyObject *args)
+Repository_rewrite_history(Repository *self, PyObject *args, PyObject *kwds)
 {
-    Signature *py_author, *py_committer;
-    PyObject *py_oid, *py_message, *py_parents, *py_parent;
-    PyObject *py_result = NULL;
-    char *message = NULL;
-    char *update_ref = NULL;
-    char *encoding = NULL;
-    git_oid oid;
-    git_tree *tree = NULL;
-    int parent_count;
-    git_commit **parents = NULL;
-    int err = 0, i = 0;
-    size_t len;
+    PyObject *py_refs, *py_item, *py_key, *py_value, *py_result = NULL;
+    PyObject *py_path_filter = NULL, *py_author_map = NULL;
+    PyObject *py_tree_filter = NULL, *py_commit_filter = NULL;
+    PyObject *py_name, *py_email;
+    rewrite_opts opts;
+    rewrite_author *author;
+    Py_ssize_t i, n, pos = 0;
+    int err;
+    char *keywords[] = {"start_refs", "tree_filter", "commit_filter",
+                        "path_filter", "author_map", NULL};
 
-    if (!PyArg_ParseTuple(args, "zO!O!OOO!|s",
-                          &update_ref,
-                          &SignatureType, &py_author,
-                          &SignatureType, &py_committer,
-                          &py_message,
-                          &py_oid,
-                          &PyList_Type, &py_parents,
-                          &encoding))
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OOOO", keywords, &py_refs,
+                                     &py_tree_filter, &py_commit_filter,
+                                     &py_path_filter, &py_author_map))
         return NULL;
 
-    len = py_oid_to_git_oid(py_oid, &oid);
-    if (len == 0)
-        goto out;
-
-    message = py_str_to_c_str(py_message, encoding);
-    if (message == NULL)
-        goto out;
+    memset(&opts, 0, sizeof(opts));
+    opts.repo = self;
+    if (py_tree_filter != Py_None)
+        opts.tree_filter = py_tree_filter;
+    if (py_commit_filter != Py_None)
+        opts.commit_filter = py_commit_filter;
 
-    err = git_tree_lookup_prefix(&tree, self->repo, &oid, len);
-    if (err < 0) {
-        Error_set(err);
+    /* References */
+    py_refs = PySequence_Fast(py_refs, "start_refs must be a list");
+    if (py_refs == NULL)
+        return NULL;
+    n = PySequence_Fast_GET_SIZE(py_refs);
+    opts.refs = calloc(n + 1, sizeof(char *));
+    opts.new_targets = calloc(n + 1, sizeof(git_oid));
+    opts.dropped = calloc(n + 1, sizeof(int));
+    if (opts.refs == NULL || opts.new_targets == NULL || opts.dropped == NULL) {
+        PyErr_NoMemory();
         goto out;
     }
+    for (i = 0; i < n; i++) {
+        opts.refs[i] = py_str_to_c_str(PySequence_Fast_GET_ITEM(py_refs, i),
+                                       NULL);
+        if (opts.refs[i] == NULL)
+            goto out;
+        opts.refs_count++;
+    }
 
-    parent_count = (int)PyList_Size(py_parents);
-    parents = malloc(parent_count * sizeof(git_commit*));
-    if (parents == NULL) {
-        PyErr_SetNone(PyExc_MemoryError);
-        goto out;
+    /* Paths to remove */
+    if (py_path_filter != NULL && py_path_filter != Py_None) {
+        py_path_filter = PySequence_Fast(py_path_filter,
+                                         "path_filter must be a list");
+        if (py_path_filter == NULL)
+            goto out;
+        n = PySequence_Fast_GET_SIZE(py_path_filter);
+        opts.remove_paths = calloc(n + 1, sizeof(char *));
+        if (opts.remove_paths == NULL) {
+            Py_DECREF(py_path_filter);
+            PyErr_NoMemory();
+            goto out;
+        }
+        for (i = 0; i < n; i++) {
+            py_item = PySequence_Fast_GET_ITEM(py_path_filter, i);
+            opts.remove_paths[i] = py_path_to_c_str(py_item);
+            if (opts.remove_paths[i] == NULL)
+                break;
+            opts.remove_paths_count++;
+        }
+        Py_DECREF(py_path_filter);
+        if (PyErr_Occurred())
+            goto out;
     }
-    for (; i < parent_count; i++) {
-        py_parent = PyList_GET_ITEM(py_parents, i);
-        len = py_oid_to_git_oid(py_parent, &oid);
-        if (len == 0)
+
+    /* Author map */
+    if (py_author_map != NULL && py_author_map != Py_None) {
+        if (!PyDict_Check(py_author_map)) {
+            PyErr_SetString(PyExc_TypeError, "author_map must be a dict");
             goto out;
-        err = git_commit_lookup_prefix(&parents[i], self->repo, &oid, len);
-        if (err < 0) {
-            Error_set(err);
+        }
+        n = PyDict_Size(py_author_map);
+        opts.authors = calloc(n + 1, sizeof(rewrite_author));
+        if (opts.authors == NULL) {
+            PyErr_NoMemory();
             goto out;
         }
+        while (PyDict_Next(py_author_map, &pos, &py_key, &py_value)) {
+            if (!PyTuple_Check(py_value) || PyTuple_GET_SIZE(py_value) != 2) {
+                PyErr_SetString(PyExc_TypeError,
+                                "author_map values must be (name, email) "
+                                "tuples");
+                goto out;
+            }
+            py_name = PyTuple_GET_ITEM(py_value, 0);
+            py_email = PyTuple_GET_ITEM(py_value, 1);
+            author = &opts.authors[opts.authors_count++];
+            author->old_email = py_str_to_c_str(py_key, NULL);
+            author->name = py_str_to_c_str(py_name, NULL);
+            author->email = py_str_to_c_str(py_email, NULL);
+            if (!author->old_email || !author->name || !author->email)
+                goto out;
+        }
     }
 
-    err = git_commit_create(&oid, self->repo, update_ref,
-                            py_author->signature, py_committer->signature,
-                            encoding, message, tree, parent_count,
-                            (const git_commit**)parents);
+    err = rewrite_history(&opts);
+    if (err == GIT_EUSER)
+        goto out;
     if (err < 0) {
         Error_set(err);
         goto out;
     }
 
-    py_result = git_oid_to_python(&oid);
+    /* The new targets */
+    py_result = PyDict_New();
+    if (py_result == NULL)
+        goto out;
+    for (i = 0; i < (Py_ssize_t)opts.refs_count; i++) {
+        if (opts.dropped[i]) {
+            Py_INCREF(Py_None);
+            py_value = Py_None;
+        }
+        else {
+            py_value = git_oid_to_python(&opts.new_targets[i]);
+        }
+        err = PyDict_SetItem(py_result, PySequence_Fast_GET_ITEM(py_refs, i),
+                             py_value);
+        Py_DECREF(py_value);
+        if (err < 0) {
+            Py_CLEAR(py_result);
+            goto out;
+        }
+    }
 
 out:
-    free(message);
-    git_tree_free(tree);
-    while (i > 0) {
-        i--;
-        git_commit_free(parents[i]);
+    Py_DECREF(py_refs);
+    for (i = 0; i < (Py_ssize_t)opts.refs_count; i++)
+        free(opts.refs[i]);
+    for (i = 0; i < (Py_ssize_t)opts.remove_paths_count; i++)
+        free(opts.remove_paths[i]);
+    for (i = 0; i < (Py_ssize_t)opts.authors_count; i++) {
+        free(opts.authors[i].old_email);
+        free(opts.authors[i].name);
+        free(opts.authors[i].email);
     }
-    free(parents);
+    free(opts.refs);
+    free(opts.new_targets);
+    free(opts.dropped);
+    free(opts.remove_paths);
+    free(opts.authors);
     return py_result;
 }
 
@@ -915,44 +2003,309 @@ out:
 }
 
 
+PyDoc_STRVAR(Repository_references_snapshot__doc__,
+  "references_snapshot([glob, peel]) -> [(name, target, peeled), ...]\n"
+  "\n"
+  "Return the references in the repository (only those matching the glob\n"
+  "pattern, if given, e.g. 'refs/tags/*') with their targets, without\n"
+  "creating Reference objects.\n"
+  "\n"
+  "This is not a bulk read: libgit2 lists the names only, and every\n"
+  "reference is then looked up.  Packed references are found in the\n"
+  "packed-refs file, which libgit2 parses once and keeps, but each loose\n"
+  "reference is still a file to read.  Pack the references for speed.\n"
+  "\n"
+  "target is an Oid for direct references, or the name of the target for\n"
+  "symbolic references. peeled is the Oid of the object the reference\n"
+  "ultimately points to, with symbolic references resolved and tags\n"
+  "peeled; it is None if the reference is dangling, or if peel is false.");
+
+struct references_snapshot_s {
+    git_repository *repo;
+    git_odb *odb;
+    int peel;
+    PyObject *list;
+};
+
+/* The oid the given direct reference ultimately points to. Only tags are
+ * loaded, the type of other objects is read from their header. */
+static int
+references_snapshot_peel(git_oid *out, struct references_snapshot_s *s,
+                         git_reference *ref)
+{
+    git_object *obj;
+    git_otype type;
+    size_t size;
+    int err;
+
+    err = git_odb_read_header(&size, &type, s->odb, git_reference_target(ref));
+    if (err < 0)
+        return err;
+
+    if (type != GIT_OBJ_TAG) {
+        git_oid_cpy(out, git_reference_target(ref));
+        return 0;
+    }
+
+    err = git_reference_peel(&obj, ref, GIT_OBJ_ANY);
+    if (err < 0)
+        return err;
+    git_oid_cpy(out, git_object_id(obj));
+    git_object_free(obj);
+    return 0;
+}
+
+/* One lookup per name, as git_reference_foreach gives nothing more */
+static int
+references_snapshot_cb(const char *name, void *payload)
+{
+    struct references_snapshot_s *s = payload;
+    git_reference *ref = NULL, *resolved = NULL;
+    PyObject *py_target, *py_peeled = NULL, *py_item;
+    git_oid peeled;
+    int err;
+
+    err = git_reference_lookup(&ref, s->repo, name);
+    if (err < 0) {
+        Error_set(err);
+        return -1;
+    }
+
+    if (git_reference_type(ref) == GIT_REF_OID)
+        py_target = git_oid_to_python(git_reference_target(ref));
+    else
+        py_target = to_path(git_reference_symbolic_target(ref));
+    if (py_target == NULL)
+        goto error;
+
+    /* Peel, broken references are not an error */
+    err = s->peel ? git_reference_resolve(&resolved, ref) : -1;
+    if (err == 0)
+        err = references_snapshot_peel(&peeled, s, resolved);
+    if (err == 0) {
+        py_peeled = git_oid_to_python(&peeled);
+        if (py_peeled == NULL) {
+            Py_DECREF(py_target);
+            goto error;
+        }
+    }
+    else {
+        giterr_clear();
+        Py_INCREF(Py_None);
+        py_peeled = Py_None;
+    }
+
+    py_item = Py_BuildValue("(NNN)", to_path(name), py_target, py_peeled);
+    if (py_item == NULL)
+        goto error;
+    err = PyList_Append(s->list, py_item);
+    Py_DECREF(py_item);
+    if (err < 0)
+        goto error;
+
+    git_reference_free(resolved);
+    git_reference_free(ref);
+    return 0;
+
+error:
+    git_reference_free(resolved);
+    git_reference_free(ref);
+    return -1;
+}
+
+PyObject *
+Repository_references_snapshot(Repository *self, PyObject *args,
+                               PyObject *kwds)
+{
+    struct references_snapshot_s s;
+    char *glob = NULL;
+    int err;
+    char *keywords[] = {"glob", "peel", NULL};
+
+    s.peel = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|zi", keywords, &glob,
+                                     &s.peel))
+        return NULL;
+
+    s.repo = self->repo;
+    err = git_repository_odb(&s.odb, self->repo);
+    if (err < 0)
+        return Error_set(err);
+
+    s.list = PyList_New(0);
+    if (s.list == NULL)
+        goto out;
+
+    if (glob)
+        err = git_reference_foreach_glob(self->repo, glob,
+                                         references_snapshot_cb, &s);
+    else
+        err = git_reference_foreach(self->repo, references_snapshot_cb, &s);
+    if (err < 0) {
+        if (err != GIT_EUSER)
+            Error_set(err);
+        Py_CLEAR(s.list);
+    }
+
+out:
+    git_odb_free(s.odb);
+    return s.list;
+}
+
+
+PyDoc_STRVAR(Repository_references_iter__doc__,
+  "references_iter([glob]) -> iterator\n"
+  "\n"
+  "Return an iterator over the names of the references in the repository,\n"
+  "or of those matching the glob pattern if given (e.g. 'refs/heads/*').\n"
+  "Unlike listall_references, the names are not loaded all at once.");
+
+static int
+references_iterator_new(git_reference_iterator **out, git_repository *repo,
+                        const char *glob)
+{
+    if (glob)
+        return git_reference_iterator_glob_new(out, repo, glob);
+    return git_reference_iterator_new(out, repo);
+}
+
+PyObject *
+Repository_references_iter(Repository *self, PyObject *args)
+{
+    ReferenceIter *py_iter;
+    git_reference_iterator *iter;
+    char *glob = NULL;
+    int err;
+
+    if (!PyArg_ParseTuple(args, "|z", &glob))
+        return NULL;
+
+    err = references_iterator_new(&iter, self->repo, glob);
+    if (err < 0)
+        return Error_set(err);
+
+    READY_TYPE(ReferenceIterType, NULL)
+    py_iter = PyObject_New(ReferenceIter, &ReferenceIterType);
+    if (py_iter == NULL) {
+        git_reference_iterator_free(iter);
+        return NULL;
+    }
+
+    Py_INCREF(self);
+    py_iter->owner = self;
+    py_iter->iter = iter;
+    return (PyObject*)py_iter;
+}
+
+
+PyDoc_STRVAR(Repository_references_count__doc__,
+  "references_count([glob]) -> int\n"
+  "\n"
+  "Return the number of references in the repository, or of those matching\n"
+  "the glob pattern if given, without creating their names.");
+
+PyObject *
+Repository_references_count(Repository *self, PyObject *args)
+{
+    git_reference_iterator *iter;
+    const char *name;
+    char *glob = NULL;
+    size_t count = 0;
+    int err;
+
+    if (!PyArg_ParseTuple(args, "|z", &glob))
+        return NULL;
+
+    err = references_iterator_new(&iter, self->repo, glob);
+    if (err < 0)
+        return Error_set(err);
+
+    while ((err = git_reference_next(&name, iter)) == 0)
+        count++;
+    git_reference_iterator_free(iter);
+    if (err != GIT_ITEROVER)
+        return Error_set(err);
+
+    return PyLong_FromSize_t(count);
+}
+
+
+PyDoc_STRVAR(Repository_pack_references__doc__,
+  "pack_references()\n"
+  "\n"
+  "Move all the loose references into the packed-refs file. Lookups then\n"
+  "read a single file, instead of one per reference.");
+
+PyObject *
+Repository_pack_references(Repository *self)
+{
+    git_refdb *refdb;
+    int err;
+
+    err = git_repository_refdb(&refdb, self->repo);
+    if (err < 0)
+        return Error_set(err);
+
+    err = git_refdb_compress(refdb);
+    git_refdb_free(refdb);
+    if (err < 0)
+        return Error_set(err);
+
+    Py_RETURN_NONE;
+}
+
+
+PyDoc_STRVAR(Repository_ref_transaction__doc__,
+  "ref_transaction() -> RefTransaction\n"
+  "\n"
+  "Create a transaction, to queue many reference changes and apply them\n"
+  "together. It may be used as a context manager, committing on exit:\n"
+  "\n"
+  "  >>> with repo.ref_transaction() as tx:\n"
+  "  ...     tx.update('refs/heads/master', new_oid, old_oid)\n"
+  "  ...     tx.delete('refs/heads/old')\n");
+
+PyObject *
+Repository_ref_transaction(Repository *self)
+{
+    RefTransaction *tx;
+
+    tx = PyObject_New(RefTransaction, &RefTransactionType);
+    if (tx) {
+        Py_INCREF(self);
+        tx->repo = self;
+        tx->ops = NULL;
+        tx->count = 0;
+        tx->alloc = 0;
+    }
+
+    return (PyObject*)tx;
+}
+
+
 PyDoc_STRVAR(Repository_listall_branches__doc__,
   "listall_branches([flags]) -> (str, ...)\n"
   "\n"
   "Return a tuple with all the branches in the repository.");
 
-struct branch_foreach_s {
-    PyObject *tuple;
-    Py_ssize_t pos;
-};
-
 int
 branch_foreach_cb(const char *branch_name, git_branch_t branch_type, void *payload)
 {
     /* This is the callback that will be called in git_branch_foreach. It
      * will be called for every branch.
-     * payload is a struct branch_foreach_s.
+     * payload is the list the names are appended to.
      */
+    PyObject *py_list = (PyObject *)payload;
+    PyObject *py_branch_name;
     int err;
-    struct branch_foreach_s *payload_s = (struct branch_foreach_s *)payload;
-
-    if (PyTuple_Size(payload_s->tuple) <= payload_s->pos)
-    {
-        err = _PyTuple_Resize(&(payload_s->tuple), payload_s->pos * 2);
-        if (err) {
-            Py_CLEAR(payload_s->tuple);
-            return GIT_ERROR;
-        }
-    }
-
-    PyObject *py_branch_name = to_path(branch_name);
-    if (py_branch_name == NULL) {
-        Py_CLEAR(payload_s->tuple);
-        return GIT_ERROR;
-    }
 
-    PyTuple_SET_ITEM(payload_s->tuple, payload_s->pos++, py_branch_name);
+    py_branch_name = to_path(branch_name);
+    if (py_branch_name == NULL)
+        return -1;
 
-    return GIT_OK;
+    err = PyList_Append(py_list, py_branch_name);
+    Py_DECREF(py_branch_name);
+    return err;
 }
 
 
@@ -960,6 +2313,7 @@ PyObject *
 Repository_listall_branches(Repository *self, PyObject *args)
 {
     unsigned int list_flags = GIT_BRANCH_LOCAL;
+    PyObject *py_list, *py_result;
     int err;
 
     /* 1- Get list_flags */
@@ -967,22 +2321,23 @@ Repository_listall_branches(Repository *self, PyObject *args)
         return NULL;
 
     /* 2- Get the C result */
-    struct branch_foreach_s payload;
-    payload.tuple = PyTuple_New(4);
-    if (payload.tuple == NULL)
+    py_list = PyList_New(0);
+    if (py_list == NULL)
         return NULL;
 
-    payload.pos = 0;
-    err = git_branch_foreach(self->repo, list_flags, branch_foreach_cb, &payload);
-    if (err != GIT_OK)
-        return Error_set(err);
-
-    /* 3- Trim the tuple */
-    err = _PyTuple_Resize(&payload.tuple, payload.pos);
-    if (err)
+    err = git_branch_foreach(self->repo, list_flags, branch_foreach_cb,
+                             py_list);
+    if (err < 0) {
+        Py_DECREF(py_list);
+        if (err == GIT_EUSER)
+            return NULL;
         return Error_set(err);
+    }
 
-    return payload.tuple;
+    /* 3- Return a tuple, as always */
+    py_result = PyList_AsTuple(py_list);
+    Py_DECREF(py_list);
+    return py_result;
 }
 
 
@@ -1155,7 +2510,10 @@ Repository_status_file(Repository *self, PyObject *value)
 PyDoc_STRVAR(Repository_TreeBuilder__doc__,
   "TreeBuilder([tree]) -> TreeBuilder\n"
   "\n"
-  "Create a TreeBuilder object for this repository.");
+  "Create a TreeBuilder object for this repository.\n"
+  "\n"
+  "The builder starts from the given tree (a Tree or an oid), or from the\n"
+  "given entries: a dict or a list, see TreeBuilder.insert_many.");
 
 PyObject *
 Repository_TreeBuilder(Repository *self, PyObject *args)
@@ -1166,13 +2524,17 @@ Repository_TreeBuilder(Repository *self, PyObject *args)
     git_oid oid;
     git_tree *tree = NULL;
     git_tree *must_free = NULL;
+    PyObject *py_entries = NULL;
     int err;
 
     if (!PyArg_ParseTuple(args, "|O", &py_src))
         return NULL;
 
     if (py_src) {
-        if (PyObject_TypeCheck(py_src, &TreeType)) {
+        if (PyDict_Check(py_src) || PyList_Check(py_src) ||
+            PyTuple_Check(py_src)) {
+            py_entries = py_src;
+        } else if (PyObject_TypeCheck(py_src, &TreeType)) {
             Tree *py_tree = (Tree *)py_src;
             if (py_tree->repo->repo != self->repo) {
                 /* return Error_set(GIT_EINVALIDARGS); */
@@ -1198,6 +2560,11 @@ Repository_TreeBuilder(Repository *self, PyObject *args)
     if (err < 0)
         return Error_set(err);
 
+    if (py_entries && TreeBuilder_insert_entries(bld, py_entries) < 0) {
+        git_treebuilder_free(bld);
+        return NULL;
+    }
+
     builder = PyObject_New(TreeBuilder, &TreeBuilderType);
     if (builder) {
         builder->repo = self;
@@ -1209,6 +2576,52 @@ Repository_TreeBuilder(Repository *self, PyObject *args)
 }
 
 
+PyDoc_STRVAR(Repository_TreeEditor__doc__,
+  "TreeEditor([tree]) -> TreeEditor\n"
+  "\n"
+  "Create a TreeEditor object for this repository, to edit the given tree\n"
+  "(or an empty one) by full paths.");
+
+PyObject *
+Repository_TreeEditor(Repository *self, PyObject *args)
+{
+    TreeEditor *editor;
+    PyObject *py_src = NULL;
+    git_oid oid;
+    int err;
+
+    if (!PyArg_ParseTuple(args, "|O", &py_src))
+        return NULL;
+
+    if (py_src) {
+        if (PyObject_TypeCheck(py_src, &TreeType)) {
+            Tree *py_tree = (Tree *)py_src;
+            if (py_tree->repo->repo != self->repo)
+                return Error_set(GIT_ERROR);
+            git_oid_cpy(&oid, git_tree_id(py_tree->tree));
+        } else {
+            err = py_oid_to_git_oid_expand(self->repo, py_src, &oid);
+            if (err < 0)
+                return NULL;
+        }
+    }
+
+    editor = PyObject_New(TreeEditor, &TreeEditorType);
+    if (editor) {
+        editor->repo = self;
+        Py_INCREF(self);
+        editor->has_base = (py_src != NULL);
+        if (py_src)
+            git_oid_cpy(&editor->base, &oid);
+        editor->ops = NULL;
+        editor->count = 0;
+        editor->alloc = 0;
+    }
+
+    return (PyObject*)editor;
+}
+
+
 PyDoc_STRVAR(Repository_create_remote__doc__,
   "create_remote(name, url) -> Remote\n"
   "\n"
@@ -1349,6 +2762,7 @@ Repository_notes(Repository *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "|s", &ref))
         return NULL;
 
+    READY_TYPE(NoteIterType, NULL)
     iter = PyObject_New(NoteIter, &NoteIterType);
     if (iter != NULL) {
         iter->repo = self;
@@ -1427,16 +2841,32 @@ PyMethodDef Repository_methods[] = {
     METHOD(Repository, create_blob, METH_VARARGS),
     METHOD(Repository, create_blob_fromworkdir, METH_VARARGS),
     METHOD(Repository, create_blob_fromdisk, METH_VARARGS),
-    METHOD(Repository, create_commit, METH_VARARGS),
+    METHOD(Repository, create_commit, METH_VARARGS | METH_KEYWORDS),
+    METHOD(Repository, create_commits, METH_VARARGS),
+    METHOD(Repository, rewrite_history, METH_VARARGS | METH_KEYWORDS),
     METHOD(Repository, create_tag, METH_VARARGS),
     METHOD(Repository, TreeBuilder, METH_VARARGS),
+    METHOD(Repository, TreeEditor, METH_VARARGS),
     METHOD(Repository, walk, METH_VARARGS),
+    METHOD(Repository, blame, METH_VARARGS | METH_KEYWORDS),
+    METHOD(Repository, grep_blobs, METH_VARARGS),
     METHOD(Repository, merge_base, METH_VARARGS),
+    METHOD(Repository, merge_base_many, METH_VARARGS),
+    METHOD(Repository, merge_base_octopus, METH_O),
+    METHOD(Repository, merge_trees, METH_VARARGS | METH_KEYWORDS),
+    METHOD(Repository, ahead_behind, METH_VARARGS),
+    METHOD(Repository, ahead_behind_many, METH_O),
+    METHOD(Repository, descendant_of, METH_VARARGS),
     METHOD(Repository, read, METH_O),
     METHOD(Repository, write, METH_VARARGS),
     METHOD(Repository, create_reference_direct, METH_VARARGS),
     METHOD(Repository, create_reference_symbolic, METH_VARARGS),
     METHOD(Repository, listall_references, METH_NOARGS),
+    METHOD(Repository, references_snapshot, METH_VARARGS | METH_KEYWORDS),
+    METHOD(Repository, references_iter, METH_VARARGS),
+    METHOD(Repository, references_count, METH_VARARGS),
+    METHOD(Repository, ref_transaction, METH_NOARGS),
+    METHOD(Repository, pack_references, METH_NOARGS),
     METHOD(Repository, lookup_reference, METH_O),
     METHOD(Repository, revparse_single, METH_O),
     METHOD(Repository, status, METH_NOARGS),
@@ -41,6 +41,16 @@ int  Repository_contains(Repository *self, PyObject *value);
 git_odb_object*
 Repository_read_raw(git_repository *repo, const git_oid *oid, size_t len);
 
+int write_commit(git_oid *out, git_odb *odb, const git_oid *tree,
+                 const git_oid *parents, size_t parent_count,
+                 const git_signature *author, const git_signature *committer,
+                 const char *encoding, const char *message);
+int update_reference_terminal(git_repository *repo, const char *name,
+                              const git_oid *oid);
+
+/* The cache of the similarity signatures, created on demand */
+struct similarity_cache *Repository_similarity(Repository *self);
+
 PyObject* Repository_head(Repository *self);
 PyObject* Repository_getitem(Repository *self, PyObject *value);
 PyObject* Repository_read(Repository *self, PyObject *py_hex);
@@ -52,19 +62,29 @@ PyObject* Repository_get_config(Repository *self, void *closure);
 PyObject* Repository_walk(Repository *self, PyObject *args);
 PyObject* Repository_create_blob(Repository *self, PyObject *args);
 PyObject* Repository_create_blob_fromfile(Repository *self, PyObject *args);
-PyObject* Repository_create_commit(Repository *self, PyObject *args);
+PyObject* Repository_create_commit(Repository *self, PyObject *args,
+                                   PyObject *kwds);
+PyObject* Repository_create_commits(Repository *self, PyObject *args);
+PyObject* Repository_rewrite_history(Repository *self, PyObject *args,
+                                     PyObject *kwds);
 PyObject* Repository_create_tag(Repository *self, PyObject *args);
 PyObject* Repository_create_branch(Repository *self, PyObject *args);
 PyObject* Repository_listall_references(Repository *self, PyObject *args);
+PyObject* Repository_references_snapshot(Repository *self, PyObject *args,
+                                         PyObject *kwds);
+PyObject* Repository_references_iter(Repository *self, PyObject *args);
+PyObject* Repository_references_count(Repository *self, PyObject *args);
+PyObject* Repository_ref_transaction(Repository *self);
 PyObject* Repository_listall_branches(Repository *self, PyObject *args);
 PyObject* Repository_lookup_reference(Repository *self, PyObject *py_name);
 
 PyObject*
 Repository_create_reference(Repository *self, PyObject *args, PyObject* kw);
 
-PyObject* Repository_packall_references(Repository *self,  PyObject *args);
+PyObject* Repository_pack_references(Repository *self);
 PyObject* Repository_status(Repository *self, PyObject *args);
 PyObject* Repository_status_file(Repository *self, PyObject *value);
 PyObject* Repository_TreeBuilder(Repository *self, PyObject *args);
+PyObject* Repository_TreeEditor(Repository *self, PyObject *args);
 
 #endif
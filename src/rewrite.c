@@ -0,0 +1,766 @@
+/*
+ * Copyright 2010-2013 The pygit2 contributors
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * In addition to the permissions in the GNU General Public License,
+ * the authors give you unlimited permission to link the compiled
+ * version of this file into combinations with other programs,
+ * and to distribute those combinations without any restriction
+ * coming from the use of this file.  (The General Public License
+ * restrictions do apply in other respects; for example, they cover
+ * modification of the file, and distribution when not linked into
+ * a combined executable.)
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <string.h>
+#include "error.h"
+#include "utils.h"
+#include "oid.h"
+#include "object.h"
+#include "repository.h"
+#include "rewrite.h"
+
+extern PyTypeObject SignatureType;
+
+/*
+ * A minimal hash table from oids to oids, so the commit map and the tree
+ * memos do not involve Python objects.
+ */
+
+#define OIDMAP_EMPTY  0
+#define OIDMAP_OID    1  /* Maps to value */
+#define OIDMAP_NONE   2  /* Maps to nothing (dropped commit, empty tree) */
+
+typedef struct {
+    git_oid key;
+    git_oid value;
+    int state;
+} oidmap_entry;
+
+typedef struct {
+    oidmap_entry *entries;
+    size_t size;
+    size_t count;
+} oidmap;
+
+static size_t
+oidmap_hash(const git_oid *oid)
+{
+    size_t hash;
+
+    /* Oids are already uniformly distributed */
+    memcpy(&hash, oid->id, sizeof(hash));
+    return hash;
+}
+
+static oidmap_entry *
+oidmap_find(oidmap *map, const git_oid *key)
+{
+    oidmap_entry *entry;
+    size_t i;
+
+    if (map->size == 0)
+        return NULL;
+
+    i = oidmap_hash(key) & (map->size - 1);
+    for (;;) {
+        entry = &map->entries[i];
+        if (entry->state == OIDMAP_EMPTY)
+            return entry;
+        if (git_oid_cmp(&entry->key, key) == 0)
+            return entry;
+        i = (i + 1) & (map->size - 1);
+    }
+}
+
+static oidmap_entry *
+oidmap_get(oidmap *map, const git_oid *key)
+{
+    oidmap_entry *entry = oidmap_find(map, key);
+
+    if (entry == NULL || entry->state == OIDMAP_EMPTY)
+        return NULL;
+    return entry;
+}
+
+static int
+oidmap_put(oidmap *map, const git_oid *key, const git_oid *value)
+{
+    oidmap_entry *entry, *old_entries;
+    size_t i, old_size;
+
+    /* Keep the load under one half */
+    if ((map->count + 1) * 2 > map->size) {
+        old_entries = map->entries;
+        old_size = map->size;
+        map->size = old_size ? old_size * 2 : 64;
+        map->entries = calloc(map->size, sizeof(oidmap_entry));
+        if (map->entries == NULL) {
+            map->entries = old_entries;
+            map->size = old_size;
+            giterr_set_oom();
+            return GIT_ERROR;
+        }
+        map->count = 0;
+        for (i = 0; i < old_size; i++) {
+            if (old_entries[i].state == OIDMAP_EMPTY)
+                continue;
+            entry = oidmap_find(map, &old_entries[i].key);
+            *entry = old_entries[i];
+            map->count++;
+        }
+        free(old_entries);
+    }
+
+    entry = oidmap_find(map, key);
+    if (entry->state == OIDMAP_EMPTY)
+        map->count++;
+    git_oid_cpy(&entry->key, key);
+    if (value) {
+        git_oid_cpy(&entry->value, value);
+        entry->state = OIDMAP_OID;
+    }
+    else {
+        entry->state = OIDMAP_NONE;
+    }
+    return 0;
+}
+
+
+/*
+ * The paths to remove, as a tree of path components. Every node memoizes
+ * the rewritten trees found at its location.
+ */
+
+typedef struct path_node {
+    char *name;
+    int remove;
+    struct path_node *children;
+    size_t children_count;
+    oidmap memo;
+} path_node;
+
+static void
+path_node_free(path_node *node)
+{
+    size_t i;
+
+    for (i = 0; i < node->children_count; i++)
+        path_node_free(&node->children[i]);
+    free(node->children);
+    free(node->memo.entries);
+    free(node->name);
+}
+
+static path_node *
+path_node_child(path_node *node, const char *name, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < node->children_count; i++) {
+        if (strncmp(node->children[i].name, name, len) == 0 &&
+            node->children[i].name[len] == '\0')
+            return &node->children[i];
+    }
+    return NULL;
+}
+
+static int
+path_node_add(path_node *root, const char *path)
+{
+    path_node *node = root, *child, *tmp;
+    size_t len;
+
+    while (*path) {
+        len = strcspn(path, "/");
+        if (len == 0) {
+            path++;
+            continue;
+        }
+
+        child = path_node_child(node, path, len);
+        if (child == NULL) {
+            tmp = realloc(node->children,
+                          (node->children_count + 1) * sizeof(path_node));
+            if (tmp == NULL)
+                goto nomem;
+            node->children = tmp;
+            child = &node->children[node->children_count];
+            memset(child, 0, sizeof(path_node));
+            child->name = malloc(len + 1);
+            if (child->name == NULL)
+                goto nomem;
+            memcpy(child->name, path, len);
+            child->name[len] = '\0';
+            node->children_count++;
+        }
+
+        node = child;
+        path += len;
+    }
+
+    node->remove = 1;
+    return 0;
+
+nomem:
+    giterr_set_oom();
+    return GIT_ERROR;
+}
+
+/*
+ * Removes the paths below the given node from the tree. Sets *empty if
+ * nothing is left, otherwise *out is the new oid (the same if unchanged).
+ */
+static int
+remove_paths(git_oid *out, int *empty, git_repository *repo, path_node *node,
+             const git_oid *tree_oid)
+{
+    git_tree *tree;
+    git_treebuilder *bld = NULL;
+    const git_tree_entry *entry;
+    const char *name;
+    path_node *child;
+    oidmap_entry *memo;
+    git_oid sub_oid;
+    size_t i, n;
+    int err, sub_empty;
+
+    memo = oidmap_get(&node->memo, tree_oid);
+    if (memo != NULL) {
+        *empty = (memo->state == OIDMAP_NONE);
+        git_oid_cpy(out, &memo->value);
+        return 0;
+    }
+
+    err = git_tree_lookup(&tree, repo, tree_oid);
+    if (err < 0)
+        return err;
+
+    n = git_tree_entrycount(tree);
+    for (i = 0; i < n; i++) {
+        entry = git_tree_entry_byindex(tree, i);
+        name = git_tree_entry_name(entry);
+        child = path_node_child(node, name, strlen(name));
+        if (child == NULL)
+            continue;
+
+        if (child->remove) {
+            sub_empty = 1;
+        }
+        else if (git_tree_entry_type(entry) == GIT_OBJ_TREE) {
+            err = remove_paths(&sub_oid, &sub_empty, repo, child,
+                               git_tree_entry_id(entry));
+            if (err < 0)
+                goto out;
+            if (!sub_empty && git_oid_cmp(&sub_oid,
+                                          git_tree_entry_id(entry)) == 0)
+                continue;
+        }
+        else {
+            continue;
+        }
+
+        /* The tree changes */
+        if (bld == NULL) {
+            err = git_treebuilder_create(&bld, tree);
+            if (err < 0)
+                goto out;
+        }
+        if (sub_empty)
+            err = git_treebuilder_remove(bld, name);
+        else
+            err = git_treebuilder_insert(NULL, bld, name, &sub_oid,
+                                         GIT_FILEMODE_TREE);
+        if (err < 0)
+            goto out;
+    }
+
+    *empty = 0;
+    if (bld == NULL)
+        git_oid_cpy(out, tree_oid);
+    else if (git_treebuilder_entrycount(bld) == 0)
+        *empty = 1;
+    else {
+        err = git_treebuilder_write(out, repo, bld);
+        if (err < 0)
+            goto out;
+    }
+
+    err = oidmap_put(&node->memo, tree_oid, *empty ? NULL : out);
+
+out:
+    git_treebuilder_free(bld);
+    git_tree_free(tree);
+    return err;
+}
+
+
+/*
+ * The rewrite itself
+ */
+
+typedef struct {
+    rewrite_opts *opts;
+    git_repository *repo;
+    git_odb *odb;
+    path_node paths;
+    oidmap commits;
+    oidmap trees;
+    git_oid *parents;
+    size_t parents_alloc;
+} rewrite_state;
+
+static int
+rewrite_tree(git_oid *out, rewrite_state *st, const git_oid *tree_oid)
+{
+    git_treebuilder *bld;
+    oidmap_entry *memo;
+    PyObject *py_oid, *py_result;
+    int err, empty = 0;
+
+    memo = oidmap_get(&st->trees, tree_oid);
+    if (memo != NULL) {
+        git_oid_cpy(out, &memo->value);
+        return 0;
+    }
+
+    git_oid_cpy(out, tree_oid);
+
+    /* Declarative */
+    if (st->paths.children_count > 0) {
+        err = remove_paths(out, &empty, st->repo, &st->paths, tree_oid);
+        if (err < 0)
+            return err;
+
+        /* Trees may be empty, but not the root tree of a commit */
+        if (empty) {
+            err = git_treebuilder_create(&bld, NULL);
+            if (err < 0)
+                return err;
+            err = git_treebuilder_write(out, st->repo, bld);
+            git_treebuilder_free(bld);
+            if (err < 0)
+                return err;
+        }
+    }
+
+    /* Callback */
+    if (st->opts->tree_filter) {
+        py_oid = git_oid_to_python(out);
+        if (py_oid == NULL)
+            return GIT_EUSER;
+        py_result = PyObject_CallFunctionObjArgs(st->opts->tree_filter, py_oid,
+                                                 NULL);
+        Py_DECREF(py_oid);
+        if (py_result == NULL)
+            return GIT_EUSER;
+        if (py_result != Py_None) {
+            err = py_oid_to_git_oid_expand(st->repo, py_result, out);
+            if (err < 0) {
+                Py_DECREF(py_result);
+                return GIT_EUSER;
+            }
+        }
+        Py_DECREF(py_result);
+    }
+
+    return oidmap_put(&st->trees, tree_oid, out);
+}
+
+static int
+rewrite_author_cmp(const void *a, const void *b)
+{
+    return strcmp(((const rewrite_author *)a)->old_email,
+                  ((const rewrite_author *)b)->old_email);
+}
+
+/* Applies the author map, *out is NULL if the signature does not change */
+static int
+rewrite_signature(git_signature **out, rewrite_state *st,
+                  const git_signature *sig)
+{
+    rewrite_author key, *author;
+
+    *out = NULL;
+    if (st->opts->authors_count == 0)
+        return 0;
+
+    key.old_email = sig->email;
+    author = bsearch(&key, st->opts->authors, st->opts->authors_count,
+                     sizeof(rewrite_author), rewrite_author_cmp);
+    if (author == NULL)
+        return 0;
+
+    return git_signature_new(out, author->name, author->email, sig->when.time,
+                             sig->when.offset);
+}
+
+static int
+signature_equal(const git_signature *a, const git_signature *b)
+{
+    return (strcmp(a->name, b->name) == 0 && strcmp(a->email, b->email) == 0 &&
+            a->when.time == b->when.time && a->when.offset == b->when.offset);
+}
+
+/* Adds the parent to the new parents, unless it is already there. */
+static int
+rewrite_add_parent(rewrite_state *st, size_t *count, const git_oid *oid)
+{
+    git_oid *tmp;
+    size_t i;
+
+    for (i = 0; i < *count; i++) {
+        if (git_oid_cmp(&st->parents[i], oid) == 0)
+            return 0;
+    }
+
+    if (*count == st->parents_alloc) {
+        st->parents_alloc = st->parents_alloc ? st->parents_alloc * 2 : 8;
+        tmp = realloc(st->parents, st->parents_alloc * sizeof(git_oid));
+        if (tmp == NULL) {
+            giterr_set_oom();
+            return GIT_ERROR;
+        }
+        st->parents = tmp;
+    }
+
+    git_oid_cpy(&st->parents[(*count)++], oid);
+    return 0;
+}
+
+static int
+rewrite_commit(rewrite_state *st, const git_oid *oid)
+{
+    git_commit *commit;
+    PyObject *py_commit = NULL, *py_result = NULL;
+    PyObject *py_author, *py_committer, *py_message;
+    const git_signature *author, *committer;
+    git_signature *new_author = NULL, *new_committer = NULL;
+    const char *message, *encoding;
+    char *new_message = NULL;
+    oidmap_entry *mapped;
+    git_oid tree_oid, new_oid;
+    size_t i, n, parent_count = 0;
+    int err, changed = 0;
+
+    err = git_commit_lookup(&commit, st->repo, oid);
+    if (err < 0)
+        return err;
+
+    author = git_commit_author(commit);
+    committer = git_commit_committer(commit);
+    message = git_commit_message(commit);
+    encoding = git_commit_message_encoding(commit);
+
+    /* Parents */
+    n = git_commit_parentcount(commit);
+    for (i = 0; i < n; i++) {
+        mapped = oidmap_get(&st->commits, git_commit_parent_id(commit, i));
+        if (mapped == NULL)
+            err = rewrite_add_parent(st, &parent_count,
+                                     git_commit_parent_id(commit, i));
+        else if (mapped->state == OIDMAP_OID)
+            err = rewrite_add_parent(st, &parent_count, &mapped->value);
+        if (err < 0)
+            goto out;
+    }
+    if (parent_count != n)
+        changed = 1;
+    for (i = 0; i < parent_count && !changed; i++) {
+        if (git_oid_cmp(&st->parents[i], git_commit_parent_id(commit, i)))
+            changed = 1;
+    }
+
+    /* Tree */
+    err = rewrite_tree(&tree_oid, st, git_commit_tree_id(commit));
+    if (err < 0)
+        goto out;
+    if (git_oid_cmp(&tree_oid, git_commit_tree_id(commit)))
+        changed = 1;
+
+    /* Callback, it may drop the commit (returns None) */
+    if (st->opts->commit_filter) {
+        py_commit = wrap_object((git_object*)commit, st->opts->repo);
+        if (py_commit == NULL) {
+            err = GIT_EUSER;
+            goto out;
+        }
+
+        py_result = PyObject_CallFunctionObjArgs(st->opts->commit_filter,
+                                                 py_commit, NULL);
+        if (py_result == NULL) {
+            err = GIT_EUSER;
+            goto out;
+        }
+
+        if (py_result == Py_None) {
+            /* Children are reparented on the first parent */
+            err = oidmap_put(&st->commits, oid,
+                             parent_count ? &st->parents[0] : NULL);
+            goto out;
+        }
+
+        if (!PyArg_ParseTuple(py_result, "O!O!O", &SignatureType, &py_author,
+                              &SignatureType, &py_committer, &py_message)) {
+            err = GIT_EUSER;
+            goto out;
+        }
+
+        author = ((Signature*)py_author)->signature;
+        committer = ((Signature*)py_committer)->signature;
+        new_message = py_str_to_c_str(py_message, encoding);
+        if (new_message == NULL) {
+            err = GIT_EUSER;
+            goto out;
+        }
+        message = new_message;
+        if (!signature_equal(author, git_commit_author(commit)) ||
+            !signature_equal(committer, git_commit_committer(commit)) ||
+            strcmp(message, git_commit_message(commit)) != 0)
+            changed = 1;
+    }
+
+    /* Author map */
+    err = rewrite_signature(&new_author, st, author);
+    if (err < 0)
+        goto out;
+    err = rewrite_signature(&new_committer, st, committer);
+    if (err < 0)
+        goto out;
+    if (new_author != NULL) {
+        if (!signature_equal(new_author, author))
+            changed = 1;
+        author = new_author;
+    }
+    if (new_committer != NULL) {
+        if (!signature_equal(new_committer, committer))
+            changed = 1;
+        committer = new_committer;
+    }
+
+    /* Write, unless nothing changed */
+    if (changed) {
+        err = write_commit(&new_oid, st->odb, &tree_oid, st->parents,
+                           parent_count, author, committer, encoding,
+                           message);
+        if (err < 0)
+            goto out;
+        st->opts->commits_written++;
+    }
+    else {
+        git_oid_cpy(&new_oid, oid);
+    }
+
+    err = oidmap_put(&st->commits, oid, &new_oid);
+
+out:
+    st->opts->commits_count++;
+    git_signature_free(new_author);
+    git_signature_free(new_committer);
+    free(new_message);
+    Py_XDECREF(py_result);
+    /* The Python object owns the commit, if there is one */
+    if (py_commit)
+        Py_DECREF(py_commit);
+    else
+        git_commit_free(commit);
+    return err;
+}
+
+#define REWRITE_TAG_SIGNATURE "-----BEGIN PGP SIGNATURE-----"
+
+/*
+ * The new target of a start reference. A commit is looked up in the commit
+ * map; an annotated tag is written again pointing to the new target, like
+ * 'git filter-branch --tag-name-filter cat' does, without its signature.
+ * The state is that of the map: OIDMAP_EMPTY if the target was not
+ * rewritten (the reference moved meanwhile), OIDMAP_NONE if dropped.
+ */
+static int
+rewrite_target(git_oid *out, int *state, rewrite_state *st,
+               const git_oid *oid)
+{
+    git_odb_object *obj;
+    oidmap_entry *mapped;
+    const char *data, *rest, *sig;
+    char *buf;
+    git_oid target, new_target;
+    size_t len, rest_len;
+    int err;
+
+    mapped = oidmap_get(&st->commits, oid);
+    if (mapped != NULL) {
+        *state = mapped->state;
+        git_oid_cpy(out, &mapped->value);
+        return 0;
+    }
+
+    *state = OIDMAP_EMPTY;
+    err = git_odb_read(&obj, st->odb, oid);
+    if (err < 0)
+        return err;
+
+    /* A tag starts with "object <hex>\ntype <type>\n" */
+    data = git_odb_object_data(obj);
+    len = git_odb_object_size(obj);
+    if (git_odb_object_type(obj) != GIT_OBJ_TAG ||
+        len < 7 + GIT_OID_HEXSZ + 1 || memcmp(data, "object ", 7) != 0 ||
+        git_oid_fromstrn(&target, data + 7, GIT_OID_HEXSZ) < 0) {
+        giterr_clear();
+        goto done;
+    }
+
+    err = rewrite_target(&new_target, state, st, &target);
+    if (err < 0 || *state != OIDMAP_OID)
+        goto done;
+    if (git_oid_cmp(&target, &new_target) == 0) {
+        git_oid_cpy(out, oid);
+        goto done;
+    }
+
+    /* The signature does not match the new tag */
+    rest = data + 7 + GIT_OID_HEXSZ;
+    rest_len = len - 7 - GIT_OID_HEXSZ;
+    for (sig = rest; sig + sizeof(REWRITE_TAG_SIGNATURE) - 1 <= data + len;
+         sig++) {
+        if ((sig == rest || sig[-1] == '\n') &&
+            memcmp(sig, REWRITE_TAG_SIGNATURE,
+                   sizeof(REWRITE_TAG_SIGNATURE) - 1) == 0) {
+            rest_len = sig - rest;
+            break;
+        }
+    }
+
+    buf = malloc(7 + GIT_OID_HEXSZ + rest_len);
+    if (buf == NULL) {
+        giterr_set_oom();
+        err = GIT_ERROR;
+        goto done;
+    }
+    memcpy(buf, "object ", 7);
+    git_oid_fmt(buf + 7, &new_target);
+    memcpy(buf + 7 + GIT_OID_HEXSZ, rest, rest_len);
+    err = git_odb_write(out, st->odb, buf, 7 + GIT_OID_HEXSZ + rest_len,
+                        GIT_OBJ_TAG);
+    free(buf);
+
+done:
+    git_odb_object_free(obj);
+    return err;
+}
+
+int
+rewrite_history(rewrite_opts *opts)
+{
+    rewrite_state st;
+    git_revwalk *walk = NULL;
+    git_reference *ref;
+    git_object *commit;
+    git_oid oid, new_oid;
+    PyThreadState *save = NULL;
+    size_t i;
+    int err, state;
+
+    memset(&st, 0, sizeof(st));
+    st.opts = opts;
+    st.repo = opts->repo->repo;
+
+    for (i = 0; i < opts->remove_paths_count; i++) {
+        err = path_node_add(&st.paths, opts->remove_paths[i]);
+        if (err < 0)
+            goto out;
+    }
+    qsort(opts->authors, opts->authors_count, sizeof(rewrite_author),
+          rewrite_author_cmp);
+
+    err = git_repository_odb(&st.odb, st.repo);
+    if (err < 0)
+        goto out;
+
+    /* Parents before children */
+    err = git_revwalk_new(&walk, st.repo);
+    if (err < 0)
+        goto out;
+    git_revwalk_sorting(walk, GIT_SORT_TOPOLOGICAL | GIT_SORT_REVERSE);
+    for (i = 0; i < opts->refs_count; i++) {
+        /* The revwalk only takes commits, not the tags */
+        err = git_reference_lookup(&ref, st.repo, opts->refs[i]);
+        if (err < 0)
+            goto out;
+        err = git_reference_peel(&commit, ref, GIT_OBJ_COMMIT);
+        git_reference_free(ref);
+        if (err < 0)
+            goto out;
+        err = git_revwalk_push(walk, git_object_id(commit));
+        git_object_free(commit);
+        if (err < 0)
+            goto out;
+    }
+
+    /* Only the callbacks need the GIL */
+    if (opts->tree_filter == NULL && opts->commit_filter == NULL)
+        save = PyEval_SaveThread();
+    while ((err = git_revwalk_next(&oid, walk)) == 0) {
+        err = rewrite_commit(&st, &oid);
+        if (err < 0)
+            break;
+    }
+    if (save)
+        PyEval_RestoreThread(save);
+    if (err == GIT_ITEROVER)
+        err = 0;
+    if (err < 0)
+        goto out;
+
+    /* Update the references */
+    for (i = 0; i < opts->refs_count; i++) {
+        err = git_reference_name_to_id(&oid, st.repo, opts->refs[i]);
+        if (err < 0)
+            goto out;
+
+        err = rewrite_target(&new_oid, &state, &st, &oid);
+        if (err < 0)
+            goto out;
+        if (state == OIDMAP_EMPTY) {
+            /* Moved by someone else meanwhile, leave it alone */
+            git_oid_cpy(&opts->new_targets[i], &oid);
+            continue;
+        }
+
+        opts->dropped[i] = (state == OIDMAP_NONE);
+        if (opts->dropped[i])
+            continue;
+
+        git_oid_cpy(&opts->new_targets[i], &new_oid);
+        if (git_oid_cmp(&oid, &new_oid) == 0)
+            continue;
+
+        err = update_reference_terminal(st.repo, opts->refs[i], &new_oid);
+        if (err < 0)
+            goto out;
+    }
+
+out:
+    git_revwalk_free(walk);
+    git_odb_free(st.odb);
+    path_node_free(&st.paths);
+    free(st.commits.entries);
+    free(st.trees.entries);
+    free(st.parents);
+    return err;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2010-2013 The pygit2 contributors
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * In addition to the permissions in the GNU General Public License,
+ * the authors give you unlimited permission to link the compiled
+ * version of this file into combinations with other programs,
+ * and to distribute those combinations without any restriction
+ * coming from the use of this file.  (The General Public License
+ * restrictions do apply in other respects; for example, they cover
+ * modification of the file, and distribution when not linked into
+ * a combined executable.)
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDE_pygit2_rewrite_h
+#define INCLUDE_pygit2_rewrite_h
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <git2.h>
+#include "types.h"
+
+/* An entry of the author map: signatures with the given email get the new
+ * name and email */
+typedef struct {
+    char *old_email;
+    char *name;
+    char *email;
+} rewrite_author;
+
+typedef struct {
+    Repository *repo;
+    /* The references to rewrite, and their new targets (out) */
+    char **refs;
+    git_oid *new_targets;
+    int *dropped;
+    size_t refs_count;
+    /* Declarative filters */
+    char **remove_paths;
+    size_t remove_paths_count;
+    rewrite_author *authors;
+    size_t authors_count;
+    /* Callbacks, may be NULL */
+    PyObject *tree_filter;
+    PyObject *commit_filter;
+    /* Statistics (out) */
+    size_t commits_count;
+    size_t commits_written;
+} rewrite_opts;
+
+int rewrite_history(rewrite_opts *opts);
+
+#endif
@@ -66,6 +66,8 @@ Signature_init(Signature *self, PyObject *args, PyObject *kwds)
 
     self->obj = NULL;
     self->signature = signature;
+    self->name = NULL;
+    self->email = NULL;
 
     if (encoding) {
         self->encoding = strdup(encoding);
@@ -81,6 +83,8 @@ Signature_init(Signature *self, PyObject *args, PyObject *kwds)
 void
 Signature_dealloc(Signature *self)
 {
+    Py_CLEAR(self->name);
+    Py_CLEAR(self->email);
     if (self->obj)
         Py_CLEAR(self->obj);
     else {
@@ -130,7 +134,15 @@ PyDoc_STRVAR(Signature_name__doc__, "Name.");
 PyObject *
 Signature_name__get__(Signature *self)
 {
-    return to_unicode(self->signature->name, self->encoding, "strict");
+    if (self->name == NULL) {
+        self->name = to_unicode(self->signature->name, self->encoding,
+                                "strict");
+        if (self->name == NULL)
+            return NULL;
+    }
+
+    Py_INCREF(self->name);
+    return self->name;
 }
 
 
@@ -139,7 +151,15 @@ PyDoc_STRVAR(Signature_email__doc__, "Email address.");
 PyObject *
 Signature_email__get__(Signature *self)
 {
-    return to_unicode(self->signature->email, self->encoding, "strict");
+    if (self->email == NULL) {
+        self->email = to_unicode(self->signature->email, self->encoding,
+                                 "strict");
+        if (self->email == NULL)
+            return NULL;
+    }
+
+    Py_INCREF(self->email);
+    return self->email;
 }
 
 
@@ -215,6 +235,10 @@ PyTypeObject SignatureType = {
     0,                                         /* tp_new            */
 };
 
+/*
+ * The signature and encoding belong to obj.  Without obj the Signature owns
+ * them, and frees them when it is deallocated.
+ */
 PyObject *
 build_signature(Object *obj, const git_signature *signature,
                 const char *encoding)
@@ -224,10 +248,12 @@ build_signature(Object *obj, const git_signature *signature,
     py_signature = PyObject_New(Signature, &SignatureType);
 
     if (py_signature) {
-        Py_INCREF(obj);
+        Py_XINCREF(obj);
         py_signature->obj = obj;
         py_signature->signature = signature;
         py_signature->encoding = encoding;
+        py_signature->name = NULL;
+        py_signature->email = NULL;
     }
     return (PyObject*)py_signature;
 }
@@ -40,6 +40,8 @@ PyObject* Signature_get_name(Signature *self);
 PyObject* Signature_get_email(Signature *self);
 PyObject* Signature_get_time(Signature *self);
 PyObject* Signature_get_offset(Signature *self);
+PyObject* Signature_name__get__(Signature *self);
+PyObject* Signature_email__get__(Signature *self);
 
 PyObject*
 build_signature(Object *obj, const git_signature *signature,
@@ -0,0 +1,651 @@
+/*
+ * Copyright 2010-2013 The pygit2 contributors
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * In addition to the permissions in the GNU General Public License,
+ * the authors give you unlimited permission to link the compiled
+ * version of this file into combinations with other programs,
+ * and to distribute those combinations without any restriction
+ * coming from the use of this file.  (The General Public License
+ * restrictions do apply in other respects; for example, they cover
+ * modification of the file, and distribution when not linked into
+ * a combined executable.)
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <pythread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "similarity.h"
+
+/* As in git, see diffcore-delta.c */
+#define SIMILARITY_HASHBASE   107927
+#define SIMILARITY_CHUNK_MAX  64
+
+/* When the cache holds this many signatures, it starts again */
+#define SIMILARITY_CACHE_MAX  100000
+
+typedef struct {
+    uint32_t hash;
+    uint32_t bytes;
+} similarity_chunk;
+
+/* Sorted by hash, every hash once */
+typedef struct {
+    size_t refcount;
+    size_t bytes;
+    size_t count;
+    similarity_chunk chunks[1];
+} similarity_sig;
+
+typedef struct similarity_entry {
+    git_oid oid;
+    int ignore_whitespace;
+    similarity_sig *sig;
+    struct similarity_entry *next;
+} similarity_entry;
+
+struct similarity_cache {
+    PyThread_type_lock lock;
+    similarity_entry **buckets;
+    size_t bucket_count;
+    size_t count;
+};
+
+
+/*
+ * Signatures
+ */
+
+static int
+similarity_chunk_cmp(const void *a, const void *b)
+{
+    uint32_t x = ((const similarity_chunk *)a)->hash;
+    uint32_t y = ((const similarity_chunk *)b)->hash;
+
+    return x < y ? -1 : x > y;
+}
+
+static int
+similarity_sig_add(similarity_sig **sig, size_t *alloc, uint32_t hash,
+                   size_t bytes)
+{
+    similarity_sig *new_sig;
+
+    if ((*sig)->count == *alloc) {
+        *alloc *= 2;
+        new_sig = realloc(*sig, sizeof(similarity_sig) +
+                                *alloc * sizeof(similarity_chunk));
+        if (new_sig == NULL)
+            return -1;
+        *sig = new_sig;
+    }
+
+    (*sig)->chunks[(*sig)->count].hash = hash;
+    (*sig)->chunks[(*sig)->count].bytes = (uint32_t)bytes;
+    (*sig)->count++;
+    (*sig)->bytes += bytes;
+    return 0;
+}
+
+static similarity_sig *
+similarity_sig_new(const char *buf, size_t len, int ignore_whitespace)
+{
+    similarity_sig *sig;
+    uint32_t accum1 = 0, accum2 = 0, old;
+    size_t i, j, n = 0, alloc = 256;
+    unsigned char c;
+
+    sig = malloc(sizeof(similarity_sig) + alloc * sizeof(similarity_chunk));
+    if (sig == NULL)
+        return NULL;
+    sig->refcount = 1;
+    sig->bytes = 0;
+    sig->count = 0;
+
+    for (i = 0; i < len; i++) {
+        c = (unsigned char)buf[i];
+        if (c == '\r' && i + 1 < len && buf[i + 1] == '\n')
+            continue;
+        if (ignore_whitespace && (c == ' ' || c == '\t' || c == '\r'))
+            continue;
+
+        old = accum1;
+        accum1 = (accum1 << 7) ^ (accum2 >> 25);
+        accum2 = (accum2 << 7) ^ (old >> 25);
+        accum1 += c;
+        if (++n < SIMILARITY_CHUNK_MAX && c != '\n')
+            continue;
+
+        if (similarity_sig_add(&sig, &alloc, (accum1 + accum2 * 0x61) %
+                               SIMILARITY_HASHBASE, n) < 0)
+            goto oom;
+        n = 0;
+        accum1 = accum2 = 0;
+    }
+
+    if (n > 0 && similarity_sig_add(&sig, &alloc, (accum1 + accum2 * 0x61) %
+                                    SIMILARITY_HASHBASE, n) < 0)
+        goto oom;
+
+    /* Sort, and add up the chunks with the same hash */
+    qsort(sig->chunks, sig->count, sizeof(similarity_chunk),
+          similarity_chunk_cmp);
+    for (i = 0, j = 0; i < sig->count; i++) {
+        if (j > 0 && sig->chunks[j - 1].hash == sig->chunks[i].hash)
+            sig->chunks[j - 1].bytes += sig->chunks[i].bytes;
+        else
+            sig->chunks[j++] = sig->chunks[i];
+    }
+    sig->count = j;
+
+    return sig;
+
+oom:
+    free(sig);
+    return NULL;
+}
+
+static int
+similarity_score(const similarity_sig *a, const similarity_sig *b)
+{
+    size_t i = 0, j = 0, common = 0, max;
+
+    max = a->bytes > b->bytes ? a->bytes : b->bytes;
+    if (max == 0)
+        return 100;
+
+    while (i < a->count && j < b->count) {
+        if (a->chunks[i].hash < b->chunks[j].hash) {
+            i++;
+        }
+        else if (a->chunks[i].hash > b->chunks[j].hash) {
+            j++;
+        }
+        else {
+            common += a->chunks[i].bytes < b->chunks[j].bytes ?
+                      a->chunks[i].bytes : b->chunks[j].bytes;
+            i++;
+            j++;
+        }
+    }
+
+    return (int)(common * 100 / max);
+}
+
+
+/*
+ * The cache
+ */
+
+similarity_cache *
+similarity_cache_new(void)
+{
+    similarity_cache *cache;
+
+    cache = calloc(1, sizeof(similarity_cache));
+    if (cache == NULL)
+        return NULL;
+
+    cache->lock = PyThread_allocate_lock();
+    if (cache->lock == NULL) {
+        free(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+static void
+similarity_sig_decref(similarity_cache *cache, similarity_sig *sig)
+{
+    size_t refcount;
+
+    PyThread_acquire_lock(cache->lock, WAIT_LOCK);
+    refcount = --sig->refcount;
+    PyThread_release_lock(cache->lock);
+    if (refcount == 0)
+        free(sig);
+}
+
+/* With the lock held */
+static void
+similarity_cache_clear(similarity_cache *cache)
+{
+    similarity_entry *entry, *next;
+    size_t i;
+
+    for (i = 0; i < cache->bucket_count; i++) {
+        for (entry = cache->buckets[i]; entry; entry = next) {
+            next = entry->next;
+            if (--entry->sig->refcount == 0)
+                free(entry->sig);
+            free(entry);
+        }
+        cache->buckets[i] = NULL;
+    }
+    cache->count = 0;
+}
+
+void
+similarity_cache_free(similarity_cache *cache)
+{
+    if (cache == NULL)
+        return;
+
+    similarity_cache_clear(cache);
+    free(cache->buckets);
+    PyThread_free_lock(cache->lock);
+    free(cache);
+}
+
+static size_t
+similarity_hash(const git_oid *oid)
+{
+    size_t hash;
+
+    memcpy(&hash, oid->id, sizeof(hash));
+    return hash;
+}
+
+/* A new reference to the signature of the blob, or NULL */
+static similarity_sig *
+similarity_cache_get(similarity_cache *cache, const git_oid *oid,
+                     int ignore_whitespace)
+{
+    similarity_entry *entry;
+    similarity_sig *sig = NULL;
+
+    PyThread_acquire_lock(cache->lock, WAIT_LOCK);
+    if (cache->count > 0) {
+        entry = cache->buckets[similarity_hash(oid) &
+                               (cache->bucket_count - 1)];
+        for (; entry; entry = entry->next) {
+            if (entry->ignore_whitespace == ignore_whitespace &&
+                git_oid_cmp(&entry->oid, oid) == 0) {
+                sig = entry->sig;
+                sig->refcount++;
+                break;
+            }
+        }
+    }
+    PyThread_release_lock(cache->lock);
+
+    return sig;
+}
+
+/* Keep the signature, unless it is there already (computed meanwhile by
+ * another thread). Errors are not reported, the cache is only a help. */
+static void
+similarity_cache_put(similarity_cache *cache, const git_oid *oid,
+                     int ignore_whitespace, similarity_sig *sig)
+{
+    similarity_entry *entry, **buckets, *next;
+    size_t i, count, bucket;
+
+    PyThread_acquire_lock(cache->lock, WAIT_LOCK);
+
+    if (cache->count >= SIMILARITY_CACHE_MAX)
+        similarity_cache_clear(cache);
+
+    /* Grow the table, keeping one entry per bucket on average */
+    if (cache->count >= cache->bucket_count) {
+        count = cache->bucket_count ? cache->bucket_count * 2 : 256;
+        buckets = calloc(count, sizeof(similarity_entry *));
+        if (buckets == NULL)
+            goto out;
+
+        for (i = 0; i < cache->bucket_count; i++) {
+            for (entry = cache->buckets[i]; entry; entry = next) {
+                next = entry->next;
+                bucket = similarity_hash(&entry->oid) & (count - 1);
+                entry->next = buckets[bucket];
+                buckets[bucket] = entry;
+            }
+        }
+        free(cache->buckets);
+        cache->buckets = buckets;
+        cache->bucket_count = count;
+    }
+
+    bucket = similarity_hash(oid) & (cache->bucket_count - 1);
+    for (entry = cache->buckets[bucket]; entry; entry = entry->next)
+        if (entry->ignore_whitespace == ignore_whitespace &&
+            git_oid_cmp(&entry->oid, oid) == 0)
+            goto out;
+
+    entry = malloc(sizeof(similarity_entry));
+    if (entry == NULL)
+        goto out;
+
+    git_oid_cpy(&entry->oid, oid);
+    entry->ignore_whitespace = ignore_whitespace;
+    entry->sig = sig;
+    entry->next = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+    cache->count++;
+    sig->refcount++;
+
+out:
+    PyThread_release_lock(cache->lock);
+}
+
+
+/*
+ * The metric
+ */
+
+int
+similarity_read_file(char **out, size_t *len, const char *path)
+{
+    FILE *file;
+    char *buf = NULL, *new_buf;
+    size_t size = 0, alloc = 0, n;
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        giterr_set_str(GITERR_OS, "failed to open file");
+        return GIT_ERROR;
+    }
+
+    do {
+        if (size == alloc) {
+            alloc = alloc ? alloc * 2 : 8192;
+            new_buf = realloc(buf, alloc);
+            if (new_buf == NULL) {
+                free(buf);
+                fclose(file);
+                giterr_set_oom();
+                return GIT_ERROR;
+            }
+            buf = new_buf;
+        }
+        n = fread(buf + size, 1, alloc - size, file);
+        size += n;
+    } while (n > 0);
+
+    if (ferror(file)) {
+        free(buf);
+        fclose(file);
+        giterr_set_str(GITERR_OS, "failed to read file");
+        return GIT_ERROR;
+    }
+
+    fclose(file);
+    *out = buf;
+    *len = size;
+    return 0;
+}
+
+static int
+similarity_buffer_signature(void **out, const git_diff_file *file,
+                            const char *buf, size_t len, void *payload)
+{
+    similarity_metric *metric = payload;
+    similarity_sig *sig;
+    int zero = git_oid_iszero(&file->oid);
+
+    if (!zero) {
+        sig = similarity_cache_get(metric->cache, &file->oid,
+                                   metric->ignore_whitespace);
+        if (sig != NULL) {
+            *out = sig;
+            return 0;
+        }
+    }
+
+    sig = similarity_sig_new(buf, len, metric->ignore_whitespace);
+    if (sig == NULL) {
+        giterr_set_oom();
+        return GIT_ERROR;
+    }
+
+    if (!zero)
+        similarity_cache_put(metric->cache, &file->oid,
+                             metric->ignore_whitespace, sig);
+    *out = sig;
+    return 0;
+}
+
+static int
+similarity_file_signature(void **out, const git_diff_file *file,
+                          const char *path, void *payload)
+{
+    similarity_metric *metric = payload;
+    similarity_sig *sig;
+    char *buf;
+    size_t len;
+    int err;
+
+    if (!git_oid_iszero(&file->oid)) {
+        sig = similarity_cache_get(metric->cache, &file->oid,
+                                   metric->ignore_whitespace);
+        if (sig != NULL) {
+            *out = sig;
+            return 0;
+        }
+    }
+
+    err = similarity_read_file(&buf, &len, path);
+    if (err < 0)
+        return err;
+
+    err = similarity_buffer_signature(out, file, buf, len, payload);
+    free(buf);
+    return err;
+}
+
+static void
+similarity_free_signature(void *sig, void *payload)
+{
+    similarity_metric *metric = payload;
+
+    if (sig != NULL)
+        similarity_sig_decref(metric->cache, sig);
+}
+
+static int
+similarity_similarity(int *score, void *a, void *b, void *payload)
+{
+    *score = similarity_score(a, b);
+    return 0;
+}
+
+void
+similarity_metric_init(similarity_metric *metric, similarity_cache *cache,
+                       unsigned int flags)
+{
+    metric->metric.file_signature = similarity_file_signature;
+    metric->metric.buffer_signature = similarity_buffer_signature;
+    metric->metric.free_signature = similarity_free_signature;
+    metric->metric.similarity = similarity_similarity;
+    metric->metric.payload = metric;
+    metric->cache = cache;
+    metric->ignore_whitespace = (flags & GIT_DIFF_FIND_IGNORE_WHITESPACE) != 0;
+}
+
+
+/*
+ * Computing the signatures ahead, in parallel
+ */
+
+typedef struct {
+    similarity_metric *metric;
+    git_repository *repo;
+    const git_oid *oids;
+    size_t count;
+    size_t next;
+    PyThread_type_lock lock;    /* Guards next */
+} similarity_job;
+
+typedef struct {
+    similarity_job *job;
+    PyThread_type_lock done;    /* Held until the thread is done */
+} similarity_worker;
+
+static void
+similarity_work(similarity_job *job)
+{
+    similarity_metric *metric = job->metric;
+    similarity_sig *sig;
+    git_blob *blob;
+    size_t i;
+
+    for (;;) {
+        PyThread_acquire_lock(job->lock, WAIT_LOCK);
+        i = job->next++;
+        PyThread_release_lock(job->lock);
+        if (i >= job->count)
+            break;
+
+        sig = similarity_cache_get(metric->cache, &job->oids[i],
+                                   metric->ignore_whitespace);
+        if (sig != NULL) {
+            similarity_sig_decref(metric->cache, sig);
+            continue;
+        }
+
+        if (git_blob_lookup(&blob, job->repo, &job->oids[i]) < 0)
+            continue;
+
+        sig = similarity_sig_new(git_blob_rawcontent(blob),
+                                 (size_t)git_blob_rawsize(blob),
+                                 metric->ignore_whitespace);
+        git_blob_free(blob);
+        if (sig == NULL)
+            continue;
+
+        similarity_cache_put(metric->cache, &job->oids[i],
+                             metric->ignore_whitespace, sig);
+        similarity_sig_decref(metric->cache, sig);
+    }
+}
+
+static void
+similarity_thread(void *payload)
+{
+    similarity_worker *worker = payload;
+
+    similarity_work(worker->job);
+    PyThread_release_lock(worker->done);
+}
+
+static int
+similarity_push(git_oid **oids, size_t *count, size_t *alloc,
+                const git_diff_file *file)
+{
+    git_oid *new_oids;
+
+    if (git_oid_iszero(&file->oid) || file->mode == GIT_FILEMODE_COMMIT)
+        return 0;
+
+    if (*count == *alloc) {
+        *alloc = *alloc ? *alloc * 2 : 64;
+        new_oids = realloc(*oids, *alloc * sizeof(git_oid));
+        if (new_oids == NULL)
+            return -1;
+        *oids = new_oids;
+    }
+
+    git_oid_cpy(&(*oids)[(*count)++], &file->oid);
+    return 0;
+}
+
+void
+similarity_prepare(similarity_metric *metric, git_repository *repo,
+                   git_diff_list *diff, unsigned int flags,
+                   unsigned int workers)
+{
+    const git_diff_delta *delta;
+    similarity_job job;
+    similarity_worker *threads;
+    git_oid *oids = NULL;
+    size_t i, n, count = 0, alloc = 0, sources = 0, targets = 0;
+    unsigned int started = 0;
+    int copies, rewrites, err = 0;
+
+    copies = (flags & GIT_DIFF_FIND_COPIES) != 0;
+    rewrites = (flags & (GIT_DIFF_FIND_RENAMES_FROM_REWRITES |
+                         GIT_DIFF_FIND_AND_BREAK_REWRITES)) != 0;
+
+    /* The blobs which may be compared: the sources of renames and copies,
+     * then their targets */
+    n = git_diff_num_deltas(diff);
+    for (i = 0; i < n && err == 0; i++) {
+        if (git_diff_get_patch(NULL, &delta, diff, i) < 0)
+            break;
+
+        if (delta->status == GIT_DELTA_DELETED ||
+            (delta->status == GIT_DELTA_MODIFIED && (copies || rewrites)) ||
+            (delta->status == GIT_DELTA_UNMODIFIED &&
+             (flags & GIT_DIFF_FIND_COPIES_FROM_UNMODIFIED))) {
+            err = similarity_push(&oids, &count, &alloc, &delta->old_file);
+            sources++;
+        }
+
+        if (delta->status == GIT_DELTA_ADDED ||
+            delta->status == GIT_DELTA_UNTRACKED ||
+            (delta->status == GIT_DELTA_MODIFIED && rewrites)) {
+            err = similarity_push(&oids, &count, &alloc, &delta->new_file);
+            targets++;
+        }
+    }
+
+    if (err < 0 || sources == 0 || targets == 0 || count == 0)
+        goto out;
+
+    job.metric = metric;
+    job.repo = repo;
+    job.oids = oids;
+    job.count = count;
+    job.next = 0;
+    job.lock = PyThread_allocate_lock();
+    if (job.lock == NULL)
+        goto out;
+
+    /* This thread is a worker too */
+    if (workers > count)
+        workers = (unsigned int)count;
+    threads = calloc(workers, sizeof(similarity_worker));
+    for (; threads != NULL && started + 1 < workers; started++) {
+        threads[started].job = &job;
+        threads[started].done = PyThread_allocate_lock();
+        if (threads[started].done == NULL)
+            break;
+
+        PyThread_acquire_lock(threads[started].done, WAIT_LOCK);
+        if (PyThread_start_new_thread(similarity_thread,
+                                      &threads[started]) == -1) {
+            PyThread_release_lock(threads[started].done);
+            PyThread_free_lock(threads[started].done);
+            break;
+        }
+    }
+
+    similarity_work(&job);
+
+    for (i = 0; i < started; i++) {
+        PyThread_acquire_lock(threads[i].done, WAIT_LOCK);
+        PyThread_free_lock(threads[i].done);
+    }
+    free(threads);
+    PyThread_free_lock(job.lock);
+
+out:
+    free(oids);
+}
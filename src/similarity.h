@@ -0,0 +1,72 @@
+/*
+ * Copyright 2010-2013 The pygit2 contributors
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * In addition to the permissions in the GNU General Public License,
+ * the authors give you unlimited permission to link the compiled
+ * version of this file into combinations with other programs,
+ * and to distribute those combinations without any restriction
+ * coming from the use of this file.  (The General Public License
+ * restrictions do apply in other respects; for example, they cover
+ * modification of the file, and distribution when not linked into
+ * a combined executable.)
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDE_pygit2_similarity_h
+#define INCLUDE_pygit2_similarity_h
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <git2.h>
+
+/*
+ * A similarity metric for git_diff_find_similar, the one of git itself: the
+ * files are cut in lines (or 64 bytes chunks), and the score is the share
+ * of the bytes found in both.
+ *
+ * The signatures of the blobs are kept by a cache, shared by the diffs of a
+ * repository; blobs never change, so it never goes stale. The cache has a
+ * lock, and does not touch Python objects: use it with the GIL released.
+ */
+typedef struct similarity_cache similarity_cache;
+
+similarity_cache *similarity_cache_new(void);
+void similarity_cache_free(similarity_cache *cache);
+
+/* What git_diff_find_similar is given as the metric */
+typedef struct {
+    git_diff_similarity_metric metric;
+    similarity_cache *cache;
+    int ignore_whitespace;
+} similarity_metric;
+
+void similarity_metric_init(similarity_metric *metric,
+                            similarity_cache *cache, unsigned int flags);
+
+/*
+ * Compute the signatures of the blobs git_diff_find_similar will compare,
+ * with as many threads as workers, so it then finds them in the cache.
+ * This is only a head start: the blobs which cannot be read are left to
+ * git_diff_find_similar.
+ */
+void similarity_prepare(similarity_metric *metric, git_repository *repo,
+                        git_diff_list *diff, unsigned int flags,
+                        unsigned int workers);
+
+/* Read a whole file, into a buffer to free */
+int similarity_read_file(char **out, size_t *len, const char *path);
+
+#endif
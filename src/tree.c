@@ -43,7 +43,10 @@ extern PyTypeObject IndexType;
 void
 TreeEntry_dealloc(TreeEntry *self)
 {
-    git_tree_entry_free((git_tree_entry*)self->entry);
+    if (self->owner)
+        Py_DECREF(self->owner);
+    else
+        git_tree_entry_free((git_tree_entry*)self->entry);
     PyObject_Del(self);
 }
 
@@ -159,15 +162,24 @@ Tree_contains(Tree *self, PyObject *py_name)
     return result;
 }
 
+/* Wraps the given entry. If owner is not NULL the entry is borrowed from its
+ * tree, which is kept alive; otherwise the new object takes ownership of the
+ * entry (and frees it on failure). */
 TreeEntry *
-wrap_tree_entry(const git_tree_entry *entry)
+wrap_tree_entry(const git_tree_entry *entry, Tree *owner)
 {
     TreeEntry *py_entry;
 
     py_entry = PyObject_New(TreeEntry, &TreeEntryType);
-    if (py_entry)
-        py_entry->entry = entry;
+    if (py_entry == NULL) {
+        if (owner == NULL)
+            git_tree_entry_free((git_tree_entry*)entry);
+        return NULL;
+    }
 
+    Py_XINCREF(owner);
+    py_entry->owner = owner;
+    py_entry->entry = entry;
     return py_entry;
 }
 
@@ -205,6 +217,7 @@ Tree_iter(Tree *self)
 {
     TreeIter *iter;
 
+    READY_TYPE(TreeIterType, NULL)
     iter = PyObject_New(TreeIter, &TreeIterType);
     if (iter) {
         Py_INCREF(self);
@@ -230,19 +243,14 @@ Tree_getitem_by_index(Tree *self, PyObject *py_index)
         return NULL;
     }
 
-    entry = git_tree_entry_dup(entry);
-    if (entry == NULL) {
-        PyErr_SetNone(PyExc_MemoryError);
-        return NULL;
-    }
-
-    return wrap_tree_entry(entry);
+    return wrap_tree_entry(entry, self);
 }
 
 TreeEntry *
 Tree_getitem(Tree *self, PyObject *value)
 {
     char *path;
+    const git_tree_entry *borrowed;
     git_tree_entry *entry;
     int err;
 
@@ -255,6 +263,17 @@ Tree_getitem(Tree *self, PyObject *value)
     if (path == NULL)
         return NULL;
 
+    /* A name in this tree, the entry can be borrowed */
+    if (strchr(path, '/') == NULL) {
+        borrowed = git_tree_entry_byname(self->tree, path);
+        free(path);
+        if (borrowed == NULL) {
+            PyErr_SetObject(PyExc_KeyError, value);
+            return NULL;
+        }
+        return wrap_tree_entry(borrowed, self);
+    }
+
     err = git_tree_entry_bypath(&entry, self->tree, path);
     free(path);
 
@@ -267,12 +286,15 @@ Tree_getitem(Tree *self, PyObject *value)
         return (TreeEntry*)Error_set(err);
 
     /* git_tree_entry_dup is already done in git_tree_entry_bypath */
-    return wrap_tree_entry(entry);
+    return wrap_tree_entry(entry, NULL);
 }
 
 
 PyDoc_STRVAR(Tree_diff_to_workdir__doc__,
-  "diff_to_workdir([flags, context_lines, interhunk_lines]) -> Diff\n"
+  "diff_to_workdir([flags, context_lines, interhunk_lines, pathspec,\n"
+  "                 max_size, ignore_submodules, old_prefix, new_prefix,\n"
+  "                 force_binary])\n"
+  "    -> Diff\n"
   "\n"
   "Show the changes between the :py:class:`~pygit2.Tree` and the workdir.\n"
   "\n"
@@ -284,31 +306,47 @@ PyDoc_STRVAR(Tree_diff_to_workdir__doc__,
   "   of a hunk (and to display before and after)\n"
   "\n"
   "interhunk_lines: the maximum number of unchanged lines between hunk\n"
-  "   boundaries before the hunks will be merged into a one.\n");
+  "   boundaries before the hunks will be merged into a one.\n"
+  DIFF_OPTIONS_DOC);
 
 PyObject *
-Tree_diff_to_workdir(Tree *self, PyObject *args)
+Tree_diff_to_workdir(Tree *self, PyObject *args, PyObject *kwds)
 {
-    git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+    diff_options options = DIFF_OPTIONS_INIT;
     git_diff_list *diff;
     Repository *py_repo;
     int err;
+    char *keywords[] = {"flags", "context_lines", "interhunk_lines",
+                        DIFF_OPTIONS_KEYWORDS, NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|IHH" DIFF_OPTIONS_FORMAT,
+                                     keywords, &options.opts.flags,
+                                     &options.opts.context_lines,
+                                     &options.opts.interhunk_lines,
+                                     DIFF_OPTIONS_ARGS(options)))
+        return NULL;
 
-    if (!PyArg_ParseTuple(args, "|IHH", &opts.flags, &opts.context_lines,
-                                        &opts.interhunk_lines))
+    if (diff_options_prepare(&options) < 0) {
+        diff_options_free(&options);
         return NULL;
+    }
 
     py_repo = self->repo;
-    err = git_diff_tree_to_workdir(&diff, py_repo->repo, self->tree, &opts);
+    err = git_diff_tree_to_workdir(&diff, py_repo->repo, self->tree,
+                                   &options.opts);
+    diff_options_free(&options);
     if (err < 0)
         return Error_set(err);
 
-    return wrap_diff(diff, py_repo);
+    return wrap_diff(diff, py_repo, &options);
 }
 
 
 PyDoc_STRVAR(Tree_diff_to_index__doc__,
-  "diff_to_index(index, [flags, context_lines, interhunk_lines]) -> Diff\n"
+  "diff_to_index(index, [flags, context_lines, interhunk_lines, pathspec,\n"
+  "              max_size, ignore_submodules, old_prefix, new_prefix,\n"
+  "              force_binary])\n"
+  "    -> Diff\n"
   "\n"
   "Show the changes between the index and a given :py:class:`~pygit2.Tree`.\n"
   "\n"
@@ -322,35 +360,49 @@ PyDoc_STRVAR(Tree_diff_to_index__doc__,
   "   of a hunk (and to display before and after)\n"
   "\n"
   "interhunk_lines: the maximum number of unchanged lines between hunk\n"
-  "   boundaries before the hunks will be merged into a one.\n");
+  "   boundaries before the hunks will be merged into a one.\n"
+  DIFF_OPTIONS_DOC);
 
 PyObject *
 Tree_diff_to_index(Tree *self, PyObject *args, PyObject *kwds)
 {
-    git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+    diff_options options = DIFF_OPTIONS_INIT;
     git_diff_list *diff;
     Repository *py_repo;
     int err;
+    char *keywords[] = {"index", "flags", "context_lines", "interhunk_lines",
+                        DIFF_OPTIONS_KEYWORDS, NULL};
 
     Index *py_idx = NULL;
 
-    if (!PyArg_ParseTuple(args, "O!|IHH", &IndexType, &py_idx, &opts.flags,
-                                        &opts.context_lines,
-                                        &opts.interhunk_lines))
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|IHH" DIFF_OPTIONS_FORMAT,
+                                     keywords, &IndexType, &py_idx,
+                                     &options.opts.flags,
+                                     &options.opts.context_lines,
+                                     &options.opts.interhunk_lines,
+                                     DIFF_OPTIONS_ARGS(options)))
         return NULL;
 
+    if (diff_options_prepare(&options) < 0) {
+        diff_options_free(&options);
+        return NULL;
+    }
+
     py_repo = self->repo;
     err = git_diff_tree_to_index(&diff, py_repo->repo, self->tree,
-                                 py_idx->index, &opts);
+                                 py_idx->index, &options.opts);
+    diff_options_free(&options);
     if (err < 0)
         return Error_set(err);
 
-    return wrap_diff(diff, py_repo);
+    return wrap_diff(diff, py_repo, &options);
 }
 
 
 PyDoc_STRVAR(Tree_diff_to_tree__doc__,
-  "diff_to_tree([tree, flags, context_lines, interhunk_lines, swap]) -> Diff\n"
+  "diff_to_tree([tree, flags, context_lines, interhunk_lines, swap,\n"
+  "              pathspec, max_size, ignore_submodules, old_prefix,\n"
+  "              new_prefix, force_binary]) -> Diff\n"
   "\n"
   "Show the changes between two trees\n"
   "\n"
@@ -367,27 +419,35 @@ PyDoc_STRVAR(Tree_diff_to_tree__doc__,
   "interhunk_lines: the maximum number of unchanged lines between hunk\n"
   "   boundaries before the hunks will be merged into a one.\n"
   "\n"
-  "swap: instead of diffing a to b. Diff b to a.\n");
+  "swap: instead of diffing a to b. Diff b to a.\n"
+  DIFF_OPTIONS_DOC);
 
 PyObject *
 Tree_diff_to_tree(Tree *self, PyObject *args, PyObject *kwds)
 {
-    git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+    diff_options options = DIFF_OPTIONS_INIT;
     git_diff_list *diff;
     git_tree *from, *to, *tmp;
     Repository *py_repo;
     int err, swap = 0;
     char *keywords[] = {"obj", "flags", "context_lines", "interhunk_lines",
-                        "swap", NULL};
+                        "swap", DIFF_OPTIONS_KEYWORDS, NULL};
 
     Tree *py_tree = NULL;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O!IHHi", keywords,
-                                     &TreeType, &py_tree, &opts.flags,
-                                     &opts.context_lines,
-                                     &opts.interhunk_lines, &swap))
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O!IHHi" DIFF_OPTIONS_FORMAT,
+                                     keywords, &TreeType, &py_tree,
+                                     &options.opts.flags,
+                                     &options.opts.context_lines,
+                                     &options.opts.interhunk_lines, &swap,
+                                     DIFF_OPTIONS_ARGS(options)))
         return NULL;
 
+    if (diff_options_prepare(&options) < 0) {
+        diff_options_free(&options);
+        return NULL;
+    }
+
     py_repo = self->repo;
     to = (py_tree == NULL) ? NULL : py_tree->tree;
     from = self->tree;
@@ -397,11 +457,314 @@ Tree_diff_to_tree(Tree *self, PyObject *args, PyObject *kwds)
         to = tmp;
     }
 
-    err = git_diff_tree_to_tree(&diff, py_repo->repo, from, to, &opts);
+    err = git_diff_tree_to_tree(&diff, py_repo->repo, from, to,
+                                &options.opts);
+    diff_options_free(&options);
     if (err < 0)
         return Error_set(err);
 
-    return wrap_diff(diff, py_repo);
+    return wrap_diff(diff, py_repo, &options);
+}
+
+
+PyDoc_STRVAR(Tree_walk__doc__,
+  "walk([mode, pathspec, blobs_only, bulk]) -> [(path, oid, filemode), ...]\n"
+  "\n"
+  "Walk the tree and all its subtrees in a single traversal, returning a\n"
+  "list of (path, oid, filemode) tuples.\n"
+  "\n"
+  "Arguments:\n"
+  "\n"
+  "mode: GIT_TREEWALK_PRE (the default) lists every tree before its\n"
+  "   entries, GIT_TREEWALK_POST lists it after them.\n"
+  "\n"
+  "pathspec: a list of paths (files or directories, relative to this\n"
+  "   tree). Only the entries within them are returned, and in pre-order\n"
+  "   mode the subtrees outside of them are not even read.\n"
+  "\n"
+  "blobs_only: if true, do not return the trees, only their entries.\n"
+  "\n"
+  "bulk: if true, return a (paths, oids, filemodes) tuple instead, where\n"
+  "   paths is a list, oids a bytes string with the raw (20 bytes) oids one\n"
+  "   after the other, and filemodes a bytes string of native unsigned 32\n"
+  "   bits integers (see the array module).\n");
+
+struct tree_walk_s {
+    int mode;
+    int blobs_only;
+    int bulk;
+    char **pathspec;
+    size_t pathspec_count;
+    /* The path of the current entry */
+    char *path;
+    size_t path_size;
+    /* The result (the paths only in bulk mode) */
+    PyObject *list;
+    /* Bulk mode */
+    unsigned char *oids;
+    unsigned int *modes;
+    size_t count;
+    size_t alloc;
+};
+
+/* Returns 1 if the path is within the pathspec, 0 if it is a tree some
+ * pathspec item is within, and -1 otherwise. */
+static int
+tree_walk_match(struct tree_walk_s *w, const char *path, int is_tree)
+{
+    size_t i, path_len, spec_len;
+    const char *spec;
+    int result = -1;
+
+    if (w->pathspec == NULL)
+        return 1;
+
+    path_len = strlen(path);
+    for (i = 0; i < w->pathspec_count; i++) {
+        spec = w->pathspec[i];
+        spec_len = strlen(spec);
+        if (spec_len <= path_len) {
+            if (strncmp(path, spec, spec_len) == 0 &&
+                (path[spec_len] == '\0' || path[spec_len] == '/'))
+                return 1;
+        }
+        else if (is_tree && spec[path_len] == '/' &&
+                 strncmp(path, spec, path_len) == 0) {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static int
+tree_walk_append(struct tree_walk_s *w, const git_tree_entry *entry)
+{
+    PyObject *py_path, *py_oid, *py_item;
+    void *tmp;
+    int err;
+
+    py_path = to_path(w->path);
+    if (py_path == NULL)
+        return -1;
+
+    if (w->bulk) {
+        err = PyList_Append(w->list, py_path);
+        Py_DECREF(py_path);
+        if (err < 0)
+            return -1;
+
+        if (w->count == w->alloc) {
+            w->alloc = (w->alloc == 0) ? 64 : w->alloc * 2;
+            tmp = realloc(w->oids, w->alloc * GIT_OID_RAWSZ);
+            if (tmp == NULL)
+                goto nomem;
+            w->oids = tmp;
+            tmp = realloc(w->modes, w->alloc * sizeof(unsigned int));
+            if (tmp == NULL)
+                goto nomem;
+            w->modes = tmp;
+        }
+
+        memcpy(w->oids + w->count * GIT_OID_RAWSZ,
+               git_tree_entry_id(entry)->id, GIT_OID_RAWSZ);
+        w->modes[w->count] = git_tree_entry_filemode(entry);
+        w->count++;
+        return 0;
+    }
+
+    py_oid = git_oid_to_python(git_tree_entry_id(entry));
+    if (py_oid == NULL) {
+        Py_DECREF(py_path);
+        return -1;
+    }
+
+    py_item = Py_BuildValue("(NNI)", py_path, py_oid,
+                            git_tree_entry_filemode(entry));
+    if (py_item == NULL)
+        return -1;
+
+    err = PyList_Append(w->list, py_item);
+    Py_DECREF(py_item);
+    return err;
+
+nomem:
+    PyErr_NoMemory();
+    return -1;
+}
+
+static int
+tree_walk_cb(const char *root, const git_tree_entry *entry, void *payload)
+{
+    struct tree_walk_s *w = (struct tree_walk_s *)payload;
+    const char *name;
+    size_t root_len, name_len;
+    int is_tree, match;
+    char *tmp;
+
+    /* Build the path of the entry */
+    name = git_tree_entry_name(entry);
+    root_len = strlen(root);
+    name_len = strlen(name);
+    if (root_len + name_len + 1 > w->path_size) {
+        w->path_size = (root_len + name_len + 1) * 2;
+        tmp = realloc(w->path, w->path_size);
+        if (tmp == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        w->path = tmp;
+    }
+    memcpy(w->path, root, root_len);
+    memcpy(w->path + root_len, name, name_len + 1);
+
+    is_tree = (git_tree_entry_type(entry) == GIT_OBJ_TREE);
+    match = tree_walk_match(w, w->path, is_tree);
+    if (match < 0)
+        /* Skip the subtree, only meaningful in pre-order */
+        return (w->mode == GIT_TREEWALK_PRE && is_tree) ? 1 : 0;
+
+    if (match == 0 || (is_tree && w->blobs_only))
+        return 0;
+
+    return tree_walk_append(w, entry);
+}
+
+PyObject *
+Tree_walk(Tree *self, PyObject *args, PyObject *kwds)
+{
+    struct tree_walk_s w;
+    PyObject *py_pathspec = NULL, *py_item, *py_result = NULL;
+    PyObject *py_oids, *py_modes;
+    Py_ssize_t i, n;
+    size_t len;
+    int err;
+    char *keywords[] = {"mode", "pathspec", "blobs_only", "bulk", NULL};
+
+    memset(&w, 0, sizeof(w));
+    w.mode = GIT_TREEWALK_PRE;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iOii", keywords, &w.mode,
+                                     &py_pathspec, &w.blobs_only, &w.bulk))
+        return NULL;
+
+    if (w.mode != GIT_TREEWALK_PRE && w.mode != GIT_TREEWALK_POST)
+        return PyErr_Format(PyExc_ValueError, "unexpected mode %d", w.mode);
+
+    /* Pathspec */
+    if (py_pathspec != NULL && py_pathspec != Py_None) {
+        py_pathspec = PySequence_Fast(py_pathspec, "pathspec must be a list");
+        if (py_pathspec == NULL)
+            return NULL;
+
+        n = PySequence_Fast_GET_SIZE(py_pathspec);
+        w.pathspec = calloc(n > 0 ? n : 1, sizeof(char *));
+        if (w.pathspec == NULL) {
+            PyErr_NoMemory();
+            goto out;
+        }
+
+        for (i = 0; i < n; i++) {
+            py_item = PySequence_Fast_GET_ITEM(py_pathspec, i);
+            w.pathspec[i] = py_path_to_c_str(py_item);
+            if (w.pathspec[i] == NULL)
+                goto out;
+            w.pathspec_count++;
+
+            /* Ignore trailing slashes, "a/" means the same as "a" */
+            len = strlen(w.pathspec[i]);
+            while (len > 0 && w.pathspec[i][len - 1] == '/')
+                w.pathspec[i][--len] = '\0';
+        }
+    }
+
+    w.list = PyList_New(0);
+    if (w.list == NULL)
+        goto out;
+
+    err = git_tree_walk(self->tree, w.mode, tree_walk_cb, &w);
+    if (err == GIT_EUSER)
+        goto out;
+    if (err < 0) {
+        Error_set(err);
+        goto out;
+    }
+
+    if (!w.bulk) {
+        py_result = w.list;
+        w.list = NULL;
+        goto out;
+    }
+
+    /* Bulk mode */
+    py_oids = PyBytes_FromStringAndSize((const char *)w.oids,
+                                        w.count * GIT_OID_RAWSZ);
+    py_modes = PyBytes_FromStringAndSize((const char *)w.modes,
+                                         w.count * sizeof(unsigned int));
+    if (py_oids != NULL && py_modes != NULL)
+        py_result = Py_BuildValue("(OOO)", w.list, py_oids, py_modes);
+    Py_XDECREF(py_oids);
+    Py_XDECREF(py_modes);
+
+out:
+    Py_XDECREF(w.list);
+    if (w.pathspec != NULL) {
+        for (len = 0; len < w.pathspec_count; len++)
+            free(w.pathspec[len]);
+        free(w.pathspec);
+        Py_DECREF(py_pathspec);
+    }
+    free(w.path);
+    free(w.oids);
+    free(w.modes);
+    return py_result;
+}
+
+
+PyDoc_STRVAR(Tree_entries__doc__,
+  "entries() -> (names, oids, filemodes)\n"
+  "\n"
+  "Return the entries of this tree (not recursive) as three parallel\n"
+  "sequences, without creating a TreeEntry object for each of them: names\n"
+  "is a list, oids a bytes string with the raw (20 bytes) oids one after\n"
+  "the other, and filemodes a bytes string of native unsigned 32 bits\n"
+  "integers (see the array module).");
+
+PyObject *
+Tree_entries(Tree *self)
+{
+    const git_tree_entry *entry;
+    PyObject *py_names, *py_oids, *py_modes, *py_name;
+    char *oids;
+    unsigned int *modes;
+    size_t i, n;
+
+    n = git_tree_entrycount(self->tree);
+    py_names = PyList_New(n);
+    py_oids = PyBytes_FromStringAndSize(NULL, n * GIT_OID_RAWSZ);
+    py_modes = PyBytes_FromStringAndSize(NULL, n * sizeof(unsigned int));
+    if (py_names == NULL || py_oids == NULL || py_modes == NULL)
+        goto error;
+
+    oids = PyBytes_AS_STRING(py_oids);
+    modes = (unsigned int *)PyBytes_AS_STRING(py_modes);
+    for (i = 0; i < n; i++) {
+        entry = git_tree_entry_byindex(self->tree, i);
+        py_name = to_path(git_tree_entry_name(entry));
+        if (py_name == NULL)
+            goto error;
+        PyList_SET_ITEM(py_names, i, py_name);
+        memcpy(oids + i * GIT_OID_RAWSZ, git_tree_entry_id(entry)->id,
+               GIT_OID_RAWSZ);
+        modes[i] = git_tree_entry_filemode(entry);
+    }
+
+    return Py_BuildValue("(NNN)", py_names, py_oids, py_modes);
+
+error:
+    Py_XDECREF(py_names);
+    Py_XDECREF(py_oids);
+    Py_XDECREF(py_modes);
+    return NULL;
 }
 
 
@@ -424,8 +787,10 @@ PyMappingMethods Tree_as_mapping = {
 
 PyMethodDef Tree_methods[] = {
     METHOD(Tree, diff_to_tree, METH_VARARGS | METH_KEYWORDS),
-    METHOD(Tree, diff_to_workdir, METH_VARARGS),
+    METHOD(Tree, diff_to_workdir, METH_VARARGS | METH_KEYWORDS),
     METHOD(Tree, diff_to_index, METH_VARARGS | METH_KEYWORDS),
+    METHOD(Tree, walk, METH_VARARGS | METH_KEYWORDS),
+    METHOD(Tree, entries, METH_NOARGS),
     {NULL}
 };
 
@@ -492,12 +857,7 @@ TreeIter_iternext(TreeIter *self)
 
     self->i += 1;
 
-    entry = git_tree_entry_dup(entry);
-    if (entry == NULL) {
-        PyErr_SetNone(PyExc_MemoryError);
-        return NULL;
-    }
-    return wrap_tree_entry(entry);
+    return wrap_tree_entry(entry, self->owner);
 }
 
 
@@ -33,7 +33,7 @@
 #include <git2.h>
 #include "types.h"
 
-TreeEntry * wrap_tree_entry(const git_tree_entry *entry);
+TreeEntry * wrap_tree_entry(const git_tree_entry *entry, Tree *owner);
 PyObject* TreeEntry_get_filemode(TreeEntry *self);
 PyObject* TreeEntry_get_name(TreeEntry *self);
 PyObject* TreeEntry_get_oid(TreeEntry *self);
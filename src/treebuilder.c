@@ -77,6 +77,129 @@ TreeBuilder_insert(TreeBuilder *self, PyObject *args)
 }
 
 
+/* Like py_oid_to_git_oid, but in Python 3 raw oids (bytes of length 20) are
+ * accepted as well.  Not in Python 2, where bytes are hex strings: a prefix
+ * of 20 digits would be taken for a raw oid.  Returns 0 on error. */
+static size_t
+treebuilder_py_oid(PyObject *py_oid, git_oid *oid)
+{
+#if PY_MAJOR_VERSION >= 3
+    if (PyBytes_Check(py_oid) && PyBytes_GET_SIZE(py_oid) == GIT_OID_RAWSZ) {
+        git_oid_fromraw(oid, (const unsigned char *)PyBytes_AS_STRING(py_oid));
+        return GIT_OID_HEXSZ;
+    }
+#endif
+
+    return py_oid_to_git_oid(py_oid, oid);
+}
+
+static int
+treebuilder_insert_item(git_treebuilder *bld, PyObject *py_name,
+                        PyObject *py_oid, PyObject *py_attr)
+{
+    git_oid oid;
+    char *name;
+    size_t len;
+    long attr;
+    int err;
+
+    attr = PyLong_AsLong(py_attr);
+    if (attr == -1 && PyErr_Occurred())
+        return -1;
+
+    len = treebuilder_py_oid(py_oid, &oid);
+    if (len == 0)
+        return -1;
+    if (len < GIT_OID_HEXSZ) {
+        PyErr_SetObject(PyExc_ValueError, py_oid);
+        return -1;
+    }
+
+    name = py_path_to_c_str(py_name);
+    if (name == NULL)
+        return -1;
+
+    err = git_treebuilder_insert(NULL, bld, name, &oid, (git_filemode_t)attr);
+    free(name);
+    if (err < 0) {
+        Error_set(err);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Inserts the given entries: either a dict of {name: (oid, attr)}, or an
+ * iterable of (name, oid, attr) tuples. */
+int
+TreeBuilder_insert_entries(git_treebuilder *bld, PyObject *py_entries)
+{
+    PyObject *py_iter, *py_item, *py_name, *py_value;
+    Py_ssize_t pos = 0;
+    int err = 0;
+
+    if (PyDict_Check(py_entries)) {
+        while (PyDict_Next(py_entries, &pos, &py_name, &py_value)) {
+            if (!PyTuple_Check(py_value) || PyTuple_GET_SIZE(py_value) != 2) {
+                PyErr_SetString(PyExc_TypeError,
+                                "expected an (oid, attr) tuple");
+                return -1;
+            }
+            err = treebuilder_insert_item(bld, py_name,
+                                          PyTuple_GET_ITEM(py_value, 0),
+                                          PyTuple_GET_ITEM(py_value, 1));
+            if (err < 0)
+                return -1;
+        }
+        return 0;
+    }
+
+    py_iter = PyObject_GetIter(py_entries);
+    if (py_iter == NULL)
+        return -1;
+
+    while ((py_item = PyIter_Next(py_iter)) != NULL) {
+        if (!PyTuple_Check(py_item) || PyTuple_GET_SIZE(py_item) != 3) {
+            PyErr_SetString(PyExc_TypeError,
+                            "expected a (name, oid, attr) tuple");
+            err = -1;
+        }
+        else {
+            err = treebuilder_insert_item(bld, PyTuple_GET_ITEM(py_item, 0),
+                                          PyTuple_GET_ITEM(py_item, 1),
+                                          PyTuple_GET_ITEM(py_item, 2));
+        }
+        Py_DECREF(py_item);
+        if (err < 0)
+            break;
+    }
+
+    Py_DECREF(py_iter);
+    if (PyErr_Occurred())
+        return -1;
+    return err;
+}
+
+
+PyDoc_STRVAR(TreeBuilder_insert_many__doc__,
+    "insert_many(entries)\n"
+    "\n"
+    "Insert or replace many entries at once. entries is either a dict of\n"
+    "{name: (oid, attr)} or an iterable of (name, oid, attr) tuples. Besides\n"
+    "Oid objects and hex strings, in Python 3 oids may be given raw (bytes\n"
+    "of length 20), which avoids creating an Oid object per entry.  Not in\n"
+    "Python 2, where bytes strings are always taken as hex.");
+
+PyObject *
+TreeBuilder_insert_many(TreeBuilder *self, PyObject *py_entries)
+{
+    if (TreeBuilder_insert_entries(self->bld, py_entries) < 0)
+        return NULL;
+
+    Py_RETURN_NONE;
+}
+
+
 PyDoc_STRVAR(TreeBuilder_write__doc__,
     "write() -> Oid\n"
     "\n"
@@ -121,7 +244,7 @@ TreeBuilder_get(TreeBuilder *self, PyObject *py_filename)
         PyErr_SetNone(PyExc_MemoryError);
         return NULL;
     }
-    return (PyObject*)wrap_tree_entry(entry);
+    return (PyObject*)wrap_tree_entry(entry, NULL);
 }
 
 
@@ -164,6 +287,7 @@ PyMethodDef TreeBuilder_methods[] = {
     METHOD(TreeBuilder, clear, METH_NOARGS),
     METHOD(TreeBuilder, get, METH_O),
     METHOD(TreeBuilder, insert, METH_VARARGS),
+    METHOD(TreeBuilder, insert_many, METH_O),
     METHOD(TreeBuilder, remove, METH_O),
     METHOD(TreeBuilder, write, METH_NOARGS),
     {NULL}
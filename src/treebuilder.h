@@ -34,6 +34,8 @@
 #include "types.h"
 
 PyObject* TreeBuilder_insert(TreeBuilder *self, PyObject *args);
+PyObject* TreeBuilder_insert_many(TreeBuilder *self, PyObject *py_entries);
+int TreeBuilder_insert_entries(git_treebuilder *bld, PyObject *py_entries);
 PyObject* TreeBuilder_write(TreeBuilder *self);
 PyObject* TreeBuilder_remove(TreeBuilder *self, PyObject *py_filename);
 PyObject* TreeBuilder_clear(TreeBuilder *self);
@@ -0,0 +1,400 @@
+/*
+ * Copyright 2010-2013 The pygit2 contributors
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * In addition to the permissions in the GNU General Public License,
+ * the authors give you unlimited permission to link the compiled
+ * version of this file into combinations with other programs,
+ * and to distribute those combinations without any restriction
+ * coming from the use of this file.  (The General Public License
+ * restrictions do apply in other respects; for example, they cover
+ * modification of the file, and distribution when not linked into
+ * a combined executable.)
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <string.h>
+#include "error.h"
+#include "utils.h"
+#include "oid.h"
+#include "treeeditor.h"
+
+
+static void
+tree_editor_clear(TreeEditor *self)
+{
+    size_t i;
+
+    for (i = 0; i < self->count; i++)
+        free(self->ops[i].path);
+    self->count = 0;
+}
+
+void
+TreeEditor_dealloc(TreeEditor *self)
+{
+    tree_editor_clear(self);
+    free(self->ops);
+    Py_CLEAR(self->repo);
+    PyObject_Del(self);
+}
+
+
+/* Queues an operation, attr is zero for removals. */
+static PyObject *
+tree_editor_add(TreeEditor *self, PyObject *py_path, const git_oid *oid,
+                int attr)
+{
+    TreeEditorOp *op, *tmp;
+    char *path;
+    size_t len, alloc;
+
+    path = py_path_to_c_str(py_path);
+    if (path == NULL)
+        return NULL;
+
+    /* Validate: "a/b" is fine, but not "", "/a", "a/" nor "a//b" */
+    len = strlen(path);
+    if (len == 0 || path[0] == '/' || path[len - 1] == '/' ||
+        strstr(path, "//") != NULL) {
+        free(path);
+        PyErr_SetObject(PyExc_ValueError, py_path);
+        return NULL;
+    }
+
+    if (self->count == self->alloc) {
+        alloc = (self->alloc == 0) ? 16 : self->alloc * 2;
+        tmp = realloc(self->ops, alloc * sizeof(TreeEditorOp));
+        if (tmp == NULL) {
+            free(path);
+            return PyErr_NoMemory();
+        }
+        self->ops = tmp;
+        self->alloc = alloc;
+    }
+
+    op = &self->ops[self->count];
+    op->path = path;
+    op->attr = attr;
+    op->seq = self->count;
+    if (oid)
+        git_oid_cpy(&op->oid, oid);
+    else
+        memset(&op->oid, 0, sizeof(git_oid));
+    self->count++;
+
+    Py_RETURN_NONE;
+}
+
+
+PyDoc_STRVAR(TreeEditor_upsert__doc__,
+    "upsert(path, oid, attr)\n"
+    "\n"
+    "Insert or replace the entry at the given path, creating the missing\n"
+    "trees along the way. The path is relative to the base tree, with the\n"
+    "components separated by slashes (e.g. 'a/b/c.txt').\n"
+    "\n"
+    "Nothing is written until write() is called.");
+
+PyObject *
+TreeEditor_upsert(TreeEditor *self, PyObject *args)
+{
+    PyObject *py_path, *py_oid;
+    git_oid oid;
+    int err, attr;
+
+    if (!PyArg_ParseTuple(args, "OOi", &py_path, &py_oid, &attr))
+        return NULL;
+
+    if (attr == 0) {
+        PyErr_SetString(PyExc_ValueError, "invalid filemode 0");
+        return NULL;
+    }
+
+    err = py_oid_to_git_oid_expand(self->repo->repo, py_oid, &oid);
+    if (err < 0)
+        return NULL;
+
+    return tree_editor_add(self, py_path, &oid, attr);
+}
+
+
+PyDoc_STRVAR(TreeEditor_remove__doc__,
+    "remove(path)\n"
+    "\n"
+    "Remove the entry (blob or whole tree) at the given path, if there is\n"
+    "one. Trees left empty are removed as well.");
+
+PyObject *
+TreeEditor_remove(TreeEditor *self, PyObject *py_path)
+{
+    return tree_editor_add(self, py_path, NULL, 0);
+}
+
+
+PyDoc_STRVAR(TreeEditor_clear__doc__,
+    "clear()\n"
+    "\n"
+    "Drop all the pending operations.");
+
+PyObject *
+TreeEditor_clear(TreeEditor *self)
+{
+    tree_editor_clear(self);
+    Py_RETURN_NONE;
+}
+
+
+/* Sorts the operations so that the ones below a given tree are contiguous
+ * (the '/' separator sorts before any other character) and, for the same
+ * path, in the order they were queued. */
+static int
+tree_editor_op_cmp(const void *a, const void *b)
+{
+    const TreeEditorOp *op_a = a;
+    const TreeEditorOp *op_b = b;
+    const unsigned char *pa = (const unsigned char *)op_a->path;
+    const unsigned char *pb = (const unsigned char *)op_b->path;
+    int ca, cb;
+
+    for (;; pa++, pb++) {
+        ca = (*pa == '/') ? 1 : *pa;
+        cb = (*pb == '/') ? 1 : *pb;
+        if (ca != cb)
+            return ca - cb;
+        if (ca == 0)
+            break;
+    }
+
+    if (op_a->seq == op_b->seq)
+        return 0;
+    return (op_a->seq < op_b->seq) ? -1 : 1;
+}
+
+/*
+ * Builds the tree at the given prefix, from its base tree (may be NULL) and
+ * the operations below it; all the paths share the first plen characters.
+ * Operations queued before min_seq are ignored, because a later operation
+ * replaced or removed one of the trees they are within.
+ *
+ * Sets *empty and does not write anything if the resulting tree is empty,
+ * unless this is the root tree.
+ */
+static int
+tree_editor_write_tree(git_oid *out, int *empty, git_repository *repo,
+                       const git_tree *base, TreeEditorOp *ops, size_t n,
+                       size_t plen, size_t min_seq)
+{
+    git_treebuilder *bld;
+    const git_tree_entry *entry;
+    git_tree *subtree;
+    git_oid oid;
+    TreeEditorOp *op;
+    const char *name;
+    char *buffer = NULL;
+    size_t i, j, k, len, sub_min_seq;
+    int err, sub_empty;
+
+    err = git_treebuilder_create(&bld, base);
+    if (err < 0)
+        return err;
+
+    for (i = 0; i < n; i = j) {
+        /* The operations on the same entry of this tree */
+        name = ops[i].path + plen;
+        len = strcspn(name, "/");
+        for (j = i; j < n; j++) {
+            if (strncmp(ops[j].path + plen, name, len) != 0)
+                break;
+            if (ops[j].path[plen + len] != '\0' &&
+                ops[j].path[plen + len] != '/')
+                break;
+        }
+
+        free(buffer);
+        buffer = malloc(len + 1);
+        if (buffer == NULL) {
+            err = GIT_ERROR;
+            giterr_set_oom();
+            goto out;
+        }
+        memcpy(buffer, name, len);
+        buffer[len] = '\0';
+
+        /* First the operations on the entry itself, in order */
+        sub_min_seq = min_seq;
+        for (k = i; k < j && ops[k].path[plen + len] == '\0'; k++) {
+            op = &ops[k];
+            if (op->seq < min_seq)
+                continue;
+
+            err = 0;
+            if (op->attr != 0)
+                err = git_treebuilder_insert(NULL, bld, buffer, &op->oid,
+                                             op->attr);
+            else if (git_treebuilder_get(bld, buffer) != NULL)
+                err = git_treebuilder_remove(bld, buffer);
+            if (err < 0)
+                goto out;
+
+            sub_min_seq = op->seq + 1;
+        }
+
+        /* Then the operations below it, if any */
+        if (k == j)
+            continue;
+
+        subtree = NULL;
+        entry = git_treebuilder_get(bld, buffer);
+        if (entry != NULL && git_tree_entry_type(entry) == GIT_OBJ_TREE) {
+            err = git_tree_lookup(&subtree, repo, git_tree_entry_id(entry));
+            if (err < 0)
+                goto out;
+        }
+
+        err = tree_editor_write_tree(&oid, &sub_empty, repo, subtree,
+                                     ops + k, j - k, plen + len + 1,
+                                     sub_min_seq);
+        git_tree_free(subtree);
+        if (err < 0)
+            goto out;
+
+        /* Removing a path below a blob leaves the blob alone */
+        if (!sub_empty)
+            err = git_treebuilder_insert(NULL, bld, buffer, &oid,
+                                         GIT_FILEMODE_TREE);
+        else if (entry != NULL && git_tree_entry_type(entry) == GIT_OBJ_TREE)
+            err = git_treebuilder_remove(bld, buffer);
+        if (err < 0)
+            goto out;
+    }
+
+    *empty = (git_treebuilder_entrycount(bld) == 0);
+    if (*empty && plen > 0)
+        goto out;
+
+    err = git_treebuilder_write(out, repo, bld);
+
+out:
+    free(buffer);
+    git_treebuilder_free(bld);
+    return err;
+}
+
+
+PyDoc_STRVAR(TreeEditor_write__doc__,
+    "write() -> Oid\n"
+    "\n"
+    "Apply the pending operations to the base tree and write the result to\n"
+    "the repository. Only the trees along the edited paths are rewritten.\n"
+    "Returns the oid of the new root tree.\n"
+    "\n"
+    "The operations are applied in the order they were queued; the pending\n"
+    "operations are kept, so write() may be called again after queuing more.");
+
+PyObject *
+TreeEditor_write(TreeEditor *self)
+{
+    git_repository *repo = self->repo->repo;
+    git_tree *base = NULL;
+    git_oid oid;
+    int err, empty;
+
+    if (self->has_base) {
+        err = git_tree_lookup(&base, repo, &self->base);
+        if (err < 0)
+            return Error_set(err);
+    }
+
+    qsort(self->ops, self->count, sizeof(TreeEditorOp), tree_editor_op_cmp);
+    err = tree_editor_write_tree(&oid, &empty, repo, base, self->ops,
+                                 self->count, 0, 0);
+    git_tree_free(base);
+    if (err < 0)
+        return Error_set(err);
+
+    return git_oid_to_python(&oid);
+}
+
+
+PyMethodDef TreeEditor_methods[] = {
+    METHOD(TreeEditor, clear, METH_NOARGS),
+    METHOD(TreeEditor, remove, METH_O),
+    METHOD(TreeEditor, upsert, METH_VARARGS),
+    METHOD(TreeEditor, write, METH_NOARGS),
+    {NULL}
+};
+
+
+Py_ssize_t
+TreeEditor_len(TreeEditor *self)
+{
+    return (Py_ssize_t)self->count;
+}
+
+
+PyMappingMethods TreeEditor_as_mapping = {
+    (lenfunc)TreeEditor_len,      /* mp_length */
+    0,                            /* mp_subscript */
+    0,                            /* mp_ass_subscript */
+};
+
+
+PyDoc_STRVAR(TreeEditor__doc__,
+    "TreeEditor objects, to edit nested paths of a tree in a single batch.\n"
+    "The length of the editor is the number of pending operations.");
+
+PyTypeObject TreeEditorType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_pygit2.TreeEditor",                      /* tp_name           */
+    sizeof(TreeEditor),                        /* tp_basicsize      */
+    0,                                         /* tp_itemsize       */
+    (destructor)TreeEditor_dealloc,            /* tp_dealloc        */
+    0,                                         /* tp_print          */
+    0,                                         /* tp_getattr        */
+    0,                                         /* tp_setattr        */
+    0,                                         /* tp_compare        */
+    0,                                         /* tp_repr           */
+    0,                                         /* tp_as_number      */
+    0,                                         /* tp_as_sequence    */
+    &TreeEditor_as_mapping,                    /* tp_as_mapping     */
+    0,                                         /* tp_hash           */
+    0,                                         /* tp_call           */
+    0,                                         /* tp_str            */
+    0,                                         /* tp_getattro       */
+    0,                                         /* tp_setattro       */
+    0,                                         /* tp_as_buffer      */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,  /* tp_flags          */
+    TreeEditor__doc__,                         /* tp_doc            */
+    0,                                         /* tp_traverse       */
+    0,                                         /* tp_clear          */
+    0,                                         /* tp_richcompare    */
+    0,                                         /* tp_weaklistoffset */
+    0,                                         /* tp_iter           */
+    0,                                         /* tp_iternext       */
+    TreeEditor_methods,                        /* tp_methods        */
+    0,                                         /* tp_members        */
+    0,                                         /* tp_getset         */
+    0,                                         /* tp_base           */
+    0,                                         /* tp_dict           */
+    0,                                         /* tp_descr_get      */
+    0,                                         /* tp_descr_set      */
+    0,                                         /* tp_dictoffset     */
+    0,                                         /* tp_init           */
+    0,                                         /* tp_alloc          */
+    0,                                         /* tp_new            */
+};
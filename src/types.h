@@ -43,6 +43,9 @@ typedef struct {
     git_repository *repo;
     PyObject *index;  /* It will be None for a bare repository */
     PyObject *config; /* It will be None for a bare repository */
+    struct commit_graph *graph; /* Created on demand, see graph.h */
+    struct similarity_cache *similarity; /* Same, see similarity.h */
+    PyObject *strings; /* The names and emails of commits, see commit.c */
 } Repository;
 
 
@@ -65,11 +68,19 @@ typedef struct {
  * The structs for some of the object subtypes are identical except for
  * the type of their object pointers. */
 SIMPLE_TYPE(Object, git_object, obj)
-SIMPLE_TYPE(Commit, git_commit, commit)
 SIMPLE_TYPE(Tree, git_tree, tree)
 SIMPLE_TYPE(Blob, git_blob, blob)
 SIMPLE_TYPE(Tag, git_tag, tag)
 
+/* Like an Object, with its signatures built on first access */
+typedef struct {
+    PyObject_HEAD
+    Repository *repo;
+    git_commit *commit;
+    PyObject *author;
+    PyObject *committer;
+} Commit;
+
 
 /* git_config */
 typedef struct {
@@ -95,7 +106,12 @@ typedef struct {
 
 
 /* git _diff */
-SIMPLE_TYPE(Diff, git_diff_list, list)
+typedef struct {
+    PyObject_HEAD
+    Repository *repo;
+    git_diff_list *list;
+    int force_binary;   /* Never load the contents of the files */
+} Diff;
 
 typedef struct {
     PyObject_HEAD
@@ -113,6 +129,10 @@ typedef struct {
     char* new_oid;
     char status;
     unsigned similarity;
+    char binary;
+    Diff *diff;         /* The diff the patch is from, NULL for blobs */
+    size_t idx;
+    PyObject *text;     /* The bytes of the patch of blobs */
 } Patch;
 
 typedef struct {
@@ -128,8 +148,11 @@ typedef struct {
 /* git_tree_walk , git_treebuilder*/
 SIMPLE_TYPE(TreeBuilder, git_treebuilder, bld)
 
+/* If owner is set the entry is borrowed from the owner's tree, otherwise
+ * the entry is owned (and freed) by the TreeEntry object. */
 typedef struct {
     PyObject_HEAD
+    Tree *owner;
     const git_tree_entry *entry;
 } TreeEntry;
 
@@ -139,12 +162,31 @@ typedef struct {
     int i;
 } TreeIter;
 
+/* A pending TreeEditor operation, attr is zero for removals */
+typedef struct {
+    char *path;
+    git_oid oid;
+    int attr;
+    size_t seq;
+} TreeEditorOp;
+
+typedef struct {
+    PyObject_HEAD
+    Repository *repo;
+    git_oid base;
+    int has_base;
+    TreeEditorOp *ops;
+    size_t count;
+    size_t alloc;
+} TreeEditor;
+
 
 /* git_index */
 SIMPLE_TYPE(Index, git_index, index)
 
 typedef struct {
     PyObject_HEAD
+    Index *owner;
     const git_index_entry *entry;
 } IndexEntry;
 
@@ -156,20 +198,22 @@ typedef struct {
 
 
 /* git_reference, git_reflog */
-SIMPLE_TYPE(Walker, git_revwalk, walk)
+typedef struct {
+    PyObject_HEAD
+    Repository *repo;
+    git_revwalk *walk;
+    /* Only the commits changing these paths are returned, see walker.c */
+    struct walker_path *paths;
+    size_t paths_count;
+    int follow_renames;
+    char *follow_path;      /* the path given, restored by reset() */
+    int walking;            /* iternext runs without the GIL */
+} Walker;
 
 SIMPLE_TYPE(Reference, git_reference, reference)
 
 typedef Reference Branch;
 
-typedef struct {
-    PyObject_HEAD
-    git_signature *signature;
-    char *oid_old;
-    char *oid_new;
-    char *message;
-} RefLogEntry;
-
 typedef struct {
     PyObject_HEAD
     git_reflog *reflog;
@@ -177,6 +221,41 @@ typedef struct {
     size_t size;
 } RefLogIter;
 
+/* The entries borrow from the reflog, which is kept alive by the owner */
+typedef struct {
+    PyObject_HEAD
+    RefLogIter *owner;
+    const git_reflog_entry *entry;
+} RefLogEntry;
+
+typedef struct {
+    PyObject_HEAD
+    Repository *owner;
+    git_reference_iterator *iter;
+} ReferenceIter;
+
+/* A queued reference change, see reftransaction.c */
+typedef struct {
+    char *name;
+    int kind;
+    git_oid target;
+    int has_old;
+    git_oid old;
+    /* Set while committing */
+    git_reference *ref;
+    int existed;
+    git_oid previous;
+    int applied;
+} RefTransactionOp;
+
+typedef struct {
+    PyObject_HEAD
+    Repository *repo;
+    RefTransactionOp *ops;
+    size_t count;
+    size_t alloc;
+} RefTransaction;
+
 
 /* git_signature */
 typedef struct {
@@ -184,6 +263,8 @@ typedef struct {
     Object *obj;
     const git_signature *signature;
     const char *encoding;
+    PyObject *name;     /* Decoded on first access */
+    PyObject *email;
 } Signature;
 
 
@@ -191,4 +272,14 @@ typedef struct {
 SIMPLE_TYPE(Remote, git_remote, remote)
 
 
+/* Repository.blame(incremental=True), see blame.c */
+typedef struct {
+    PyObject_HEAD
+    Repository *owner;
+    struct blame *blame;
+    size_t emitted;
+    int done;
+} BlameIter;
+
+
 #endif
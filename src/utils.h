@@ -157,6 +157,12 @@ char * py_str_to_c_str(PyObject *value, const char *encoding);
     type.tp_new = new; \
     if (PyType_Ready(&type) < 0) return NULL;
 
+/* Internal types (iterators and the like) are not added to the module, so
+ * they are readied on first use instead of at import time. */
+#define READY_TYPE(type, ret) \
+    if (!PyType_HasFeature(&type, Py_TPFLAGS_READY) && PyType_Ready(&type) < 0)\
+        return ret;
+
 #define ADD_TYPE(module, type) \
     Py_INCREF(& type ## Type);\
     if (PyModule_AddObject(module, #type, (PyObject*) & type ## Type) == -1)\
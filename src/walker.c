@@ -35,15 +35,304 @@
 
 extern PyTypeObject CommitType;
 
+/* A path of the filter. In buf the '/' are replaced by NULs, so the
+ * components can be looked up in place. */
+struct walker_path {
+    char *path;
+    char *buf;
+    size_t len;
+};
+
+static void
+walker_clear_paths(Walker *self)
+{
+    size_t i;
+
+    for (i = 0; i < self->paths_count; i++) {
+        free(self->paths[i].path);
+        free(self->paths[i].buf);
+    }
+    free(self->paths);
+    self->paths = NULL;
+    self->paths_count = 0;
+    free(self->follow_path);
+    self->follow_path = NULL;
+}
+
+static int
+walker_set_path(struct walker_path *out, const char *path)
+{
+    char *c;
+
+    out->path = strdup(path);
+    out->buf = strdup(path);
+    if (out->path == NULL || out->buf == NULL) {
+        free(out->path);
+        free(out->buf);
+        giterr_set_oom();
+        return GIT_ERROR;
+    }
+
+    out->len = strlen(path);
+    for (c = out->buf; *c; c++)
+        if (*c == '/')
+            *c = '\0';
+    return 0;
+}
+
+/* The followed path is renamed as the history is walked, a new walk starts
+ * again from the path given */
+static int
+walker_restore_path(Walker *self)
+{
+    struct walker_path path;
+    int err;
+
+    if (self->follow_path == NULL ||
+        strcmp(self->paths[0].path, self->follow_path) == 0)
+        return 0;
+
+    err = walker_set_path(&path, self->follow_path);
+    if (err < 0)
+        return err;
+
+    free(self->paths[0].path);
+    free(self->paths[0].buf);
+    self->paths[0] = path;
+    return 0;
+}
+
+/* While iternext filters the commits the GIL is released, and the paths and
+ * the revwalk are used without it: other threads must keep off them */
+static int
+walker_check_busy(Walker *self)
+{
+    if (!self->walking)
+        return 0;
+
+    PyErr_SetString(PyExc_RuntimeError,
+                    "the walker is in use by another thread");
+    return -1;
+}
+
 void
 Walker_dealloc(Walker *self)
 {
+    walker_clear_paths(self);
     Py_CLEAR(self->repo);
     git_revwalk_free(self->walk);
     PyObject_Del(self);
 }
 
 
+static int
+walker_entries_differ(const git_tree_entry *a, const git_tree_entry *b)
+{
+    if (a == NULL || b == NULL)
+        return a != b;
+
+    return git_oid_cmp(git_tree_entry_id(a), git_tree_entry_id(b)) != 0 ||
+           git_tree_entry_filemode(a) != git_tree_entry_filemode(b);
+}
+
+/*
+ * Whether the paths differ between the trees, either of which may be NULL.
+ * The paths share their components up to offset, and the trees are those
+ * at that point. Subtrees with the same oid are not looked into.
+ */
+static int
+walker_trees_differ(git_repository *repo, git_tree *a, git_tree *b,
+                    struct walker_path **paths, size_t count, size_t offset)
+{
+    struct walker_path **below;
+    const git_tree_entry *entry_a, *entry_b;
+    git_tree *subtree_a, *subtree_b;
+    const char *name;
+    size_t i, j, n, next;
+    int terminal, differ = 0;
+
+    if (a && b && git_oid_cmp(git_tree_id(a), git_tree_id(b)) == 0)
+        return 0;
+
+    below = malloc(count * sizeof(struct walker_path *));
+    if (below == NULL) {
+        giterr_set_oom();
+        return GIT_ERROR;
+    }
+
+    for (i = 0; i < count && differ == 0; i++) {
+        /* Every component is looked up once */
+        name = paths[i]->buf + offset;
+        for (j = 0; j < i; j++)
+            if (strcmp(paths[j]->buf + offset, name) == 0)
+                break;
+        if (j < i)
+            continue;
+
+        /* The paths going below this component */
+        next = offset + strlen(name) + 1;
+        terminal = 0;
+        n = 0;
+        for (j = i; j < count; j++) {
+            if (strcmp(paths[j]->buf + offset, name) != 0)
+                continue;
+            if (next >= paths[j]->len)
+                terminal = 1;
+            else
+                below[n++] = paths[j];
+        }
+
+        entry_a = a ? git_tree_entry_byname(a, name) : NULL;
+        entry_b = b ? git_tree_entry_byname(b, name) : NULL;
+        if (!walker_entries_differ(entry_a, entry_b))
+            continue;
+        if (terminal) {
+            differ = 1;
+            break;
+        }
+
+        subtree_a = NULL;
+        subtree_b = NULL;
+        if (entry_a && git_tree_entry_type(entry_a) == GIT_OBJ_TREE)
+            differ = git_tree_lookup(&subtree_a, repo,
+                                     git_tree_entry_id(entry_a));
+        if (differ == 0 && entry_b &&
+            git_tree_entry_type(entry_b) == GIT_OBJ_TREE)
+            differ = git_tree_lookup(&subtree_b, repo,
+                                     git_tree_entry_id(entry_b));
+        if (differ == 0 && (subtree_a || subtree_b))
+            differ = walker_trees_differ(repo, subtree_a, subtree_b, below,
+                                         n, next);
+        git_tree_free(subtree_a);
+        git_tree_free(subtree_b);
+    }
+
+    free(below);
+    return differ;
+}
+
+static int
+walker_tree_differs(Walker *self, git_tree *a, git_tree *b)
+{
+    struct walker_path **paths;
+    size_t i;
+    int differ;
+
+    paths = malloc(self->paths_count * sizeof(struct walker_path *));
+    if (paths == NULL) {
+        giterr_set_oom();
+        return GIT_ERROR;
+    }
+
+    for (i = 0; i < self->paths_count; i++)
+        paths[i] = &self->paths[i];
+    differ = walker_trees_differ(self->repo->repo, a, b, paths,
+                                 self->paths_count, 0);
+    free(paths);
+    return differ;
+}
+
+
+/* If the followed file was renamed from the parent, follow its old name */
+static int
+walker_follow_rename(Walker *self, git_tree *parent, git_tree *tree)
+{
+    git_diff_options diff_opts = GIT_DIFF_OPTIONS_INIT;
+    git_diff_find_options opts = GIT_DIFF_FIND_OPTIONS_INIT;
+    git_diff_list *diff;
+    const git_diff_delta *delta;
+    git_tree_entry *entry;
+    struct walker_path path;
+    size_t i, n;
+    int err;
+
+    /* Only files added by the commit may have been renamed */
+    err = git_tree_entry_bypath(&entry, parent, self->paths[0].path);
+    if (err == 0)
+        git_tree_entry_free(entry);
+    if (err != GIT_ENOTFOUND)
+        return err;
+    giterr_clear();
+
+    /* Only the deltas are looked at, not the contents */
+    diff_opts.flags = GIT_DIFF_SKIP_BINARY_CHECK;
+    err = git_diff_tree_to_tree(&diff, self->repo->repo, parent, tree,
+                                &diff_opts);
+    if (err < 0)
+        return err;
+
+    opts.flags = GIT_DIFF_FIND_RENAMES;
+    err = git_diff_find_similar(diff, &opts);
+    n = git_diff_num_deltas(diff);
+    for (i = 0; i < n && err == 0; i++) {
+        err = git_diff_get_patch(NULL, &delta, diff, i);
+        if (err < 0 || delta->status != GIT_DELTA_RENAMED ||
+            strcmp(delta->new_file.path, self->paths[0].path) != 0)
+            continue;
+
+        err = walker_set_path(&path, delta->old_file.path);
+        if (err == 0) {
+            free(self->paths[0].path);
+            free(self->paths[0].buf);
+            self->paths[0] = path;
+        }
+        break;
+    }
+
+    git_diff_list_free(diff);
+    return err;
+}
+
+
+/* Whether the commit changes the paths: it differs from all its parents */
+static int
+walker_commit_matches(Walker *self, git_commit *commit)
+{
+    git_commit *parent;
+    git_tree *tree, *parent_tree = NULL, *first_tree = NULL;
+    unsigned int i, n;
+    int err, differ;
+
+    err = git_commit_tree(&tree, commit);
+    if (err < 0)
+        return err;
+
+    n = git_commit_parentcount(commit);
+    if (n == 0)
+        differ = walker_tree_differs(self, NULL, tree);
+    else
+        differ = 1;
+
+    for (i = 0; i < n && differ == 1; i++) {
+        differ = git_commit_parent(&parent, commit, i);
+        if (differ < 0)
+            break;
+        differ = git_commit_tree(&parent_tree, parent);
+        git_commit_free(parent);
+        if (differ < 0)
+            break;
+
+        differ = walker_tree_differs(self, parent_tree, tree);
+        if (i == 0 && self->follow_renames)
+            first_tree = parent_tree;
+        else
+            git_tree_free(parent_tree);
+    }
+
+    /* Every parent is compared with the same name, and the name only
+     * changes if the commit is returned */
+    if (differ == 1 && first_tree != NULL) {
+        err = walker_follow_rename(self, first_tree, tree);
+        if (err < 0)
+            differ = err;
+    }
+
+    git_tree_free(first_tree);
+    git_tree_free(tree);
+    return differ;
+}
+
+
 PyDoc_STRVAR(Walker_hide__doc__,
   "hide(oid)\n"
   "\n"
@@ -55,6 +344,9 @@ Walker_hide(Walker *self, PyObject *py_hex)
     int err;
     git_oid oid;
 
+    if (walker_check_busy(self) < 0)
+        return NULL;
+
     err = py_oid_to_git_oid_expand(self->repo->repo, py_hex, &oid);
     if (err < 0)
         return NULL;
@@ -78,6 +370,9 @@ Walker_push(Walker *self, PyObject *py_hex)
     int err;
     git_oid oid;
 
+    if (walker_check_busy(self) < 0)
+        return NULL;
+
     err = py_oid_to_git_oid_expand(self->repo->repo, py_hex, &oid);
     if (err < 0)
         return NULL;
@@ -98,13 +393,19 @@ PyDoc_STRVAR(Walker_sort__doc__,
 PyObject *
 Walker_sort(Walker *self, PyObject *py_sort_mode)
 {
-    int sort_mode;
+    int sort_mode, err;
+
+    if (walker_check_busy(self) < 0)
+        return NULL;
 
     sort_mode = (int)PyLong_AsLong(py_sort_mode);
     if (sort_mode == -1 && PyErr_Occurred())
         return NULL;
 
     git_revwalk_sorting(self->walk, sort_mode);
+    err = walker_restore_path(self);
+    if (err < 0)
+        return Error_set(err);
 
     Py_RETURN_NONE;
 }
@@ -118,7 +419,16 @@ PyDoc_STRVAR(Walker_reset__doc__,
 PyObject *
 Walker_reset(Walker *self)
 {
+    int err;
+
+    if (walker_check_busy(self) < 0)
+        return NULL;
+
     git_revwalk_reset(self->walk);
+    err = walker_restore_path(self);
+    if (err < 0)
+        return Error_set(err);
+
     Py_RETURN_NONE;
 }
 
@@ -137,28 +447,170 @@ Walker_iternext(Walker *self)
     Commit *py_commit;
     git_oid oid;
 
-    err = git_revwalk_next(&oid, self->walk);
-    if (err < 0)
-        return Error_set(err);
+    if (walker_check_busy(self) < 0)
+        return NULL;
 
-    err = git_commit_lookup(&commit, self->repo->repo, &oid);
-    if (err < 0)
-        return Error_set(err);
+    if (self->paths_count == 0) {
+        err = git_revwalk_next(&oid, self->walk);
+        if (err < 0)
+            return Error_set(err);
+
+        err = git_commit_lookup(&commit, self->repo->repo, &oid);
+        if (err < 0)
+            return Error_set(err);
+    }
+    else {
+        /* Skip the commits which do not change the paths */
+        self->walking = 1;
+        Py_BEGIN_ALLOW_THREADS
+        for (;;) {
+            err = git_revwalk_next(&oid, self->walk);
+            if (err < 0)
+                break;
+
+            err = git_commit_lookup(&commit, self->repo->repo, &oid);
+            if (err < 0)
+                break;
+
+            err = walker_commit_matches(self, commit);
+            if (err == 1)
+                break;
+            git_commit_free(commit);
+            if (err < 0)
+                break;
+        }
+        Py_END_ALLOW_THREADS
+        self->walking = 0;
+
+        /* At the end libgit2 resets the walk, so does the followed path */
+        if (err == GIT_ITEROVER && walker_restore_path(self) < 0)
+            err = GIT_ERROR;
+        if (err < 0)
+            return Error_set(err);
+    }
 
     py_commit = PyObject_New(Commit, &CommitType);
     if (py_commit) {
         py_commit->commit = commit;
         Py_INCREF(self->repo);
         py_commit->repo = self->repo;
+        py_commit->author = NULL;
+        py_commit->committer = NULL;
     }
     return (PyObject*)py_commit;
 }
 
+
+PyDoc_STRVAR(Walker_limit_paths__doc__,
+  "limit_paths(paths[, follow_renames])\n"
+  "\n"
+  "Only return the commits which change the given paths, like\n"
+  "'git log -- paths': commits which differ from all their parents there.\n"
+  "A path matches itself and, if it is a directory, everything below it;\n"
+  "there are no wildcards. Directories whose oid did not change are not\n"
+  "looked into. An empty list removes the limit.\n"
+  "\n"
+  "If follow_renames is True, and there is a single path, its renames are\n"
+  "followed as the history is walked (like 'git log --follow'); the walk\n"
+  "should then go from the newest commits to the oldest. A new walk, or\n"
+  "reset(), starts again from the path given.");
+
+PyObject *
+Walker_limit_paths(Walker *self, PyObject *args)
+{
+    PyObject *py_paths, *py_seq;
+    struct walker_path *paths;
+    char *path;
+    size_t len;
+    Py_ssize_t i, n;
+    int follow_renames = 0, err = 0;
+
+    if (!PyArg_ParseTuple(args, "O|i", &py_paths, &follow_renames))
+        return NULL;
+
+    if (walker_check_busy(self) < 0)
+        return NULL;
+
+    py_seq = PySequence_Fast(py_paths, "expected a list of paths");
+    if (py_seq == NULL)
+        return NULL;
+
+    n = PySequence_Fast_GET_SIZE(py_seq);
+    if (follow_renames && n != 1) {
+        Py_DECREF(py_seq);
+        PyErr_SetString(PyExc_ValueError,
+                        "renames can be followed for a single path");
+        return NULL;
+    }
+
+    paths = calloc(n + 1, sizeof(struct walker_path));
+    if (paths == NULL) {
+        Py_DECREF(py_seq);
+        return PyErr_NoMemory();
+    }
+
+    for (i = 0; i < n && err == 0; i++) {
+        path = py_path_to_c_str(PySequence_Fast_GET_ITEM(py_seq, i));
+        if (path == NULL) {
+            err = -1;
+            break;
+        }
+
+        len = strlen(path);
+        while (len > 0 && path[len - 1] == '/')
+            path[--len] = '\0';
+        if (len == 0 || path[0] == '/' || strstr(path, "//")) {
+            PyErr_Format(PyExc_ValueError, "invalid path '%s'", path);
+            err = -1;
+        }
+        else if (walker_set_path(&paths[i], path) < 0) {
+            PyErr_NoMemory();
+            err = -1;
+        }
+        free(path);
+    }
+    Py_DECREF(py_seq);
+
+    if (err < 0) {
+        while (i-- > 0) {
+            free(paths[i].path);
+            free(paths[i].buf);
+        }
+        free(paths);
+        return NULL;
+    }
+
+    if (follow_renames) {
+        path = strdup(paths[0].path);
+        if (path == NULL) {
+            free(paths[0].path);
+            free(paths[0].buf);
+            free(paths);
+            return PyErr_NoMemory();
+        }
+    }
+
+    walker_clear_paths(self);
+    if (n > 0) {
+        self->paths = paths;
+        self->paths_count = n;
+    }
+    else {
+        free(paths);
+    }
+    self->follow_renames = follow_renames;
+    if (follow_renames)
+        self->follow_path = path;
+
+    Py_RETURN_NONE;
+}
+
 PyMethodDef Walker_methods[] = {
     METHOD(Walker, hide, METH_O),
     METHOD(Walker, push, METH_O),
     METHOD(Walker, reset, METH_NOARGS),
     METHOD(Walker, sort, METH_O),
+    METHOD(Walker, limit_paths, METH_VARARGS),
     {NULL}
 };
 
@@ -0,0 +1,95 @@
+# -*- coding: UTF-8 -*-
+#
+# Copyright 2010-2013 The pygit2 contributors
+#
+# This file is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License, version 2,
+# as published by the Free Software Foundation.
+#
+# In addition to the permissions in the GNU General Public License,
+# the authors give you unlimited permission to link the compiled
+# version of this file into combinations with other programs,
+# and to distribute those combinations without any restriction
+# coming from the use of this file.  (The General Public License
+# restrictions do apply in other respects; for example, they cover
+# modification of the file, and distribution when not linked into
+# a combined executable.)
+#
+# This file is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; see the file COPYING.  If not, write to
+# the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+# Boston, MA 02110-1301, USA.
+
+
+"""Tests for blame."""
+
+from __future__ import absolute_import
+from __future__ import unicode_literals
+import unittest
+
+from . import utils
+
+
+MASTER = '2be5719152d4f82c7302b1c0932d8e5f0a4a0e98'
+HELLO = 'acecd5ea2924a4b900e7e149496e1f4b57976e51'
+HOLA = '6aaa262e655dd54252e5813c8e5acd7780ed097d'
+BONJOUR = '4ec4389a8068641da2d6578db0419484972284c8'
+
+
+class BlameTest(utils.RepoTestCase):
+
+    def hunks(self, hunks):
+        return [(start, lines, commit.hex, orig_start, boundary)
+                for start, lines, commit, orig_start, boundary in hunks]
+
+    def test_blame(self):
+        blame = self.repo.blame('hello.txt')
+        self.assertEqual(self.hunks(blame), [
+            (1, 1, HELLO, 1, False),
+            (2, 1, HOLA, 2, False),
+            (3, 1, BONJOUR, 3, False)])
+
+        # The merge took the file from its second parent
+        blame = self.repo.blame('hello.txt', newest=BONJOUR)
+        self.assertEqual(len(blame), 3)
+
+    def test_blame_range(self):
+        blame = self.repo.blame('hello.txt', MASTER, oldest=HOLA)
+        self.assertEqual(self.hunks(blame), [
+            (1, 2, HOLA, 1, True),
+            (3, 1, BONJOUR, 3, False)])
+
+        blame = self.repo.blame('hello.txt', min_line=2, max_line=2)
+        self.assertEqual(self.hunks(blame), [(2, 1, HOLA, 2, False)])
+
+        self.assertRaises(ValueError, self.repo.blame, 'hello.txt',
+                          max_line=4)
+        self.assertRaises(KeyError, self.repo.blame, 'missing.txt')
+
+    def test_blame_empty_file(self):
+        repo = self.repo
+        builder = repo.TreeBuilder(repo[MASTER].tree)
+        builder.insert('empty.txt', repo.create_blob(b''), 0o100644)
+        signature = repo[MASTER].author
+        commit = repo.create_commit(None, signature, signature, 'Empty\n',
+                                    builder.write(), [MASTER])
+
+        self.assertEqual(repo.blame('empty.txt', commit), [])
+        self.assertEqual(list(repo.blame('empty.txt', commit,
+                                         incremental=True)), [])
+        self.assertRaises(ValueError, repo.blame, 'empty.txt', commit,
+                          max_line=1)
+
+    def test_blame_incremental(self):
+        hunks = self.repo.blame('hello.txt', incremental=True)
+        self.assertEqual(sorted(self.hunks(hunks)),
+                         self.hunks(self.repo.blame('hello.txt')))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -37,6 +37,7 @@ from . import utils
 
 
 BLOB_SHA = 'a520c24d85fbfc815d385957eed41406ca5a860b'
+BLOB_OLD_SHA = 'eaa3421edde47f2b4f1aa32f308cb39702f091ac'
 BLOB_CONTENT = """hello world
 hola mundo
 bonjour le monde
@@ -105,5 +106,41 @@ class BlobTest(utils.RepoTestCase):
         self.assertTrue(isinstance(blob, pygit2.Blob))
         self.assertEqual(pygit2.GIT_OBJ_BLOB, blob.type)
 
+    def test_diff_blob(self):
+        old = self.repo[BLOB_OLD_SHA]
+        new = self.repo[BLOB_SHA]
+        patch = old.diff(new)
+        self.assertEqual(patch.status, 'M')
+        self.assertEqual(patch.old_oid, BLOB_OLD_SHA)
+        self.assertEqual(patch.new_oid, BLOB_SHA)
+        self.assertEqual(patch.old_file_path, None)
+
+        hunk, = patch.hunks
+        self.assertEqual((hunk.old_start, hunk.old_lines), (1, 2))
+        self.assertEqual((hunk.new_start, hunk.new_lines), (1, 3))
+        self.assertEqual(hunk.lines, [(' ', b'hello world\n'),
+                                      (' ', b'hola mundo\n'),
+                                      ('+', b'bonjour le monde\n')])
+        self.assertEqual(patch.to_bytes(),
+                         b'@@ -1,2 +1,3 @@\n'
+                         b' hello world\n'
+                         b' hola mundo\n'
+                         b'+bonjour le monde\n')
+
+        patch = self.repo.diff(old, new)
+        self.assertEqual(patch.hunks[0].lines, hunk.lines)
+
+    def test_diff_blob_to_buffer(self):
+        blob = self.repo[BLOB_SHA]
+        patch = blob.diff(b'hello world\n', context_lines=0)
+        self.assertEqual(patch.new_oid,
+                         '3b18e512dba79e4c8300dd08aeb37f8e728b8dad')
+        self.assertEqual(patch.hunks[0].lines,
+                         [('-', b'hola mundo\n'),
+                          ('-', b'bonjour le monde\n')])
+
+        self.assertEqual(blob.diff(BLOB_CONTENT).hunks, [])
+        self.assertRaises(TypeError, blob.diff, 'text')
+
 if __name__ == '__main__':
     unittest.main()
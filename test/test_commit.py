@@ -64,6 +64,21 @@ class CommitTest(utils.BareRepoTestCase):
         self.assertEqual(
             '967fce8df97cc71722d3c2a5930ef3e6f1d27b12', commit.tree.hex)
 
+    def test_as_tuple(self):
+        commit = self.repo[COMMIT_SHA]
+        self.assertEqual(commit.as_tuple(),
+                         ('Dave Borowitz', 'dborowitz@google.com',
+                          1288477363, -420,
+                          'Dave Borowitz', 'dborowitz@google.com',
+                          1288481576, -420))
+
+        # The signatures are kept, and their strings shared by the commits
+        self.assertTrue(commit.author is commit.author)
+        self.assertTrue(commit.as_tuple()[4] is commit.committer.name)
+        parent = commit.parents[0]
+        self.assertTrue(parent.author.name is commit.author.name)
+        self.assertTrue(parent.author.email is commit.committer.email)
+
     def test_new_commit(self):
         repo = self.repo
         message = 'New commit.\n\nMessage with non-ascii chars: ééé.\n'
@@ -121,6 +136,56 @@ class CommitTest(utils.BareRepoTestCase):
         self.assertEqual(1, len(commit.parents))
         self.assertEqual(COMMIT_SHA, commit.parents[0].hex)
 
+    def test_new_commit_full_oids(self):
+        # Same commit as in test_new_commit, written without any lookup
+        repo = self.repo
+        message = 'New commit.\n\nMessage with non-ascii chars: ééé.\n'
+        committer = Signature('John Doe', 'jdoe@example.com', 12346, 0)
+        author = Signature(
+            'J. David Ibáñez', 'jdavid@example.com', 12345, 0,
+            encoding='utf-8')
+        tree = '967fce8df97cc71722d3c2a5930ef3e6f1d27b12'
+
+        sha = repo.create_commit('refs/heads/new', author, committer, message,
+                                 tree, [repo[COMMIT_SHA].oid], lookup=False)
+        self.assertEqual('98286caaab3f1fde5bf52c8369b2b0423bad743b', sha.hex)
+        self.assertEqual(sha, repo.lookup_reference('refs/heads/new').target)
+
+        # By default, full oids are checked as well
+        missing = '0' * 39 + '1'
+        self.assertRaises(KeyError, repo.create_commit, None, author,
+                          committer, message, missing, [])
+        self.assertRaises(KeyError, repo.create_commit, None, author,
+                          committer, message, tree, [missing])
+        # A commit is not a tree
+        self.assertRaises(KeyError, repo.create_commit, None, author,
+                          committer, message, COMMIT_SHA, [])
+
+    def test_create_commits(self):
+        repo = self.repo
+        signature = Signature('John Doe', 'jdoe@example.com', 12346, 60)
+        tree = '967fce8df97cc71722d3c2a5930ef3e6f1d27b12'
+
+        oids = repo.create_commits([
+            (signature, signature, 'first\n', tree, [COMMIT_SHA]),
+            (signature, signature, 'second\n', tree, [0]),
+            (signature, signature, 'merge\n', tree, [0, 1])],
+            'refs/heads/new')
+        self.assertEqual(3, len(oids))
+        ref = repo.lookup_reference('refs/heads/new')
+        self.assertEqual(oids[2], ref.target)
+
+        commit = repo[oids[2]]
+        self.assertEqual('merge\n', commit.message)
+        self.assertEqual(60, commit.committer.offset)
+        self.assertEqual([oids[0], oids[1]], [ x.oid for x in commit.parents ])
+        self.assertEqual(COMMIT_SHA, repo[oids[1]].parents[0].parents[0].hex)
+
+        self.assertRaises(IndexError, repo.create_commits,
+                          [(signature, signature, 'x\n', tree, [0])])
+        self.assertRaises(ValueError, repo.create_commits,
+                          [(signature, signature, 'x\n', tree[:7], [])])
+
     def test_modify_commit(self):
         message = 'New commit.\n\nMessage.\n'
         committer = ('John Doe', 'jdoe@example.com', 12346)
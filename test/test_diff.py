@@ -35,6 +35,7 @@ from pygit2 import GIT_DIFF_INCLUDE_UNMODIFIED
 from pygit2 import GIT_DIFF_IGNORE_WHITESPACE, GIT_DIFF_IGNORE_WHITESPACE_EOL
 from . import utils
 from itertools import chain
+from io import BytesIO
 
 
 COMMIT_SHA1_1 = '5fe808e8953c12735680c257f56600cb0de44b10'
@@ -180,6 +181,66 @@ class DiffTest(utils.BareRepoTestCase):
         _test(self.repo.diff(COMMIT_SHA1_1, COMMIT_SHA1_2))
 
 
+    def test_diff_tree_pathspec(self):
+        tree_a = self.repo[COMMIT_SHA1_1].tree
+        tree_b = self.repo[COMMIT_SHA1_2].tree
+
+        diff = tree_a.diff_to_tree(tree_b, pathspec=['c'])
+        self.assertEqual([p.new_file_path for p in diff], ['c/d'])
+
+        diff = self.repo.diff(COMMIT_SHA1_1, COMMIT_SHA1_2, pathspec=['a'])
+        self.assertEqual([p.new_file_path for p in diff], ['a'])
+
+        diff = tree_a.diff_to_tree(tree_b, pathspec=['a'], old_prefix='x/',
+                                   new_prefix='y/')
+        self.assertTrue('--- x/a\n+++ y/a\n' in diff.patch)
+
+        diff = self.repo.index.diff_to_tree(tree_a, pathspec=['c/*'])
+        self.assertEqual([p.new_file_path for p in diff], ['c/d'])
+
+        self.assertRaises(TypeError, tree_a.diff_to_tree, tree_b, pathspec=1)
+        self.assertRaises(ValueError, tree_a.diff_to_tree, tree_b,
+                          max_size=-1)
+
+    def test_diff_force_binary(self):
+        tree_a = self.repo[COMMIT_SHA1_1].tree
+        tree_b = self.repo[COMMIT_SHA1_2].tree
+
+        diff = tree_a.diff_to_tree(tree_b, force_binary=True)
+        self.assertEqual([(p.new_file_path, p.status, p.hunks, p.binary)
+                          for p in diff],
+                         [('a', 'M', [], True), ('c/d', 'D', [], True)])
+        self.assertFalse(tree_a.diff_to_tree(tree_b)[0].binary)
+
+        # The text of the patch is printed as without force_binary
+        text = tree_a.diff_to_tree(tree_b).patch
+        self.assertEqual(diff.patch, text)
+        self.assertEqual(b''.join(p.to_bytes() for p in diff),
+                         text.encode('utf-8'))
+
+    def test_diff_deltas(self):
+        tree_a = self.repo[COMMIT_SHA1_1].tree
+        tree_b = self.repo[COMMIT_SHA1_2].tree
+        deltas = tree_a.diff_to_tree(tree_b).deltas()
+
+        a_old, a_new = tree_a['a'].oid, tree_b['a'].oid
+        self.assertEqual(deltas[0][:7],
+                         ('M', 'a', 'a', a_old, a_new,
+                          self.repo[a_old].size, self.repo[a_new].size))
+        d_old = tree_a['c/d'].oid
+        self.assertEqual(deltas[1][:7],
+                         ('D', 'c/d', None, d_old, None,
+                          self.repo[d_old].size, None))
+        # The contents were not looked at
+        self.assertEqual([x[7] for x in deltas], [None] * len(deltas))
+
+        diff = tree_a.diff_to_tree(tree_b)
+        patches = list(diff)
+        self.assertEqual([x[7] for x in diff.deltas()],
+                         [p.binary for p in patches])
+        diff = tree_a.diff_to_tree(tree_b, force_binary=True)
+        self.assertAll(lambda x: x[7] is True, diff.deltas())
+
     def test_diff_empty_tree(self):
         commit_a = self.repo[COMMIT_SHA1_1]
         diff = commit_a.tree.diff_to_tree()
@@ -255,6 +316,18 @@ class DiffTest(utils.BareRepoTestCase):
         diff = commit_a.tree.diff_to_tree(commit_b.tree)
         self.assertEqual(diff.patch, PATCH)
 
+    def test_write_patch(self):
+        commit_a = self.repo[COMMIT_SHA1_1]
+        commit_b = self.repo[COMMIT_SHA1_2]
+        diff = commit_a.tree.diff_to_tree(commit_b.tree)
+
+        out = BytesIO()
+        diff.write_patch(out)
+        self.assertEqual(out.getvalue(), PATCH.encode('utf-8'))
+        self.assertEqual(b''.join(patch.to_bytes() for patch in diff),
+                         out.getvalue())
+        self.assertRaises(AttributeError, diff.write_patch, None)
+
     def test_diff_oids(self):
         commit_a = self.repo[COMMIT_SHA1_1]
         commit_b = self.repo[COMMIT_SHA1_2]
@@ -284,5 +357,76 @@ class DiffTest(utils.BareRepoTestCase):
         diff.find_similar()
         self.assertAny(lambda x: x.status == 'R', diff)
 
+    def make_rename_diff(self):
+        """A diff where old.txt is renamed to new.txt, and one line of its
+        20 lines changed."""
+        lines = ['line %d\n' % i for i in range(20)]
+        old = ''.join(lines).encode('ascii')
+        lines[10] = 'changed\n'
+        new = ''.join(lines).encode('ascii')
+
+        trees = []
+        for name, data in [('old.txt', old), ('new.txt', new)]:
+            builder = self.repo.TreeBuilder()
+            builder.insert(name, self.repo.create_blob(data),
+                           pygit2.GIT_FILEMODE_BLOB)
+            trees.append(self.repo[builder.write()])
+        return trees[0].diff_to_tree(trees[1])
+
+    def test_find_similar_options(self):
+        diff = self.make_rename_diff()
+        diff.find_similar(rename_threshold=99)
+        self.assertAll(lambda x: x.status != 'R', diff)
+
+        diff = self.make_rename_diff()
+        diff.find_similar(pygit2.GIT_DIFF_FIND_RENAMES, rename_threshold=90)
+        self.assertEqual([(x.old_file_path, x.new_file_path, x.status)
+                          for x in diff], [('old.txt', 'new.txt', 'R')])
+
+        self.assertRaises(ValueError, diff.find_similar, rename_threshold=101)
+        self.assertRaises(ValueError, diff.find_similar, workers=4)
+        self.assertRaises(ValueError, diff.find_similar, metric='other')
+
+    def test_find_similar_native(self):
+        def renames(diff):
+            return [(x.old_file_path, x.new_file_path, x.status, x.similarity)
+                    for x in diff if x.status in 'RC']
+
+        # The default is libgit2's metric
+        commit_a = self.repo[COMMIT_SHA1_6]
+        commit_b = self.repo[COMMIT_SHA1_7]
+        diff = commit_a.tree.diff_to_tree(commit_b.tree,
+                                          GIT_DIFF_INCLUDE_UNMODIFIED)
+        diff.find_similar()
+        expected = renames(diff)
+        diff = commit_a.tree.diff_to_tree(commit_b.tree,
+                                          GIT_DIFF_INCLUDE_UNMODIFIED)
+        diff.find_similar(metric='native', workers=4)
+        self.assertEqual([x[:3] for x in renames(diff)],
+                         [x[:3] for x in expected])
+
+        diff = self.make_rename_diff()
+        diff.find_similar(pygit2.GIT_DIFF_FIND_RENAMES, rename_threshold=90,
+                          metric='native', workers=4)
+        self.assertEqual([(x.old_file_path, x.new_file_path, x.status)
+                          for x in diff], [('old.txt', 'new.txt', 'R')])
+
+    def test_find_similar_metric(self):
+        calls = []
+        def metric(old, new):
+            calls.append((old[:6], new[:6]))
+            return 100 if b'changed' in new else 0
+
+        diff = self.make_rename_diff()
+        diff.find_similar(metric=metric)
+        self.assertAny(lambda x: x.status == 'R', diff)
+        self.assertTrue(calls)
+        self.assertAll(lambda x: x == (b'line 0', b'line 0'), calls)
+
+        def broken(old, new):
+            raise ZeroDivisionError
+        diff = self.make_rename_diff()
+        self.assertRaises(ZeroDivisionError, diff.find_similar, metric=broken)
+
 if __name__ == '__main__':
     unittest.main()
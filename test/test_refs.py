@@ -29,9 +29,11 @@
 
 from __future__ import absolute_import
 from __future__ import unicode_literals
+from os.path import exists, join
 import unittest
 
-from pygit2 import GitError, GIT_REF_OID, GIT_REF_SYMBOLIC
+from pygit2 import GitError, GIT_REF_OID, GIT_REF_SYMBOLIC, GIT_OBJ_TAG
+from pygit2 import GIT_OBJ_COMMIT, Signature
 from . import utils
 
 
@@ -54,6 +56,60 @@ class ReferencesTest(utils.RepoTestCase):
                          ['refs/heads/i18n', 'refs/heads/master',
                           'refs/tags/version1'])
 
+    def test_references_iter(self):
+        repo = self.repo
+        repo.create_reference('refs/tags/version1', 'refs/heads/master')
+
+        names = repo.references_iter()
+        self.assertEqual(sorted(names),
+                         ['refs/heads/i18n', 'refs/heads/master',
+                          'refs/tags/version1'])
+        self.assertEqual(list(repo.references_iter('refs/tags/*')),
+                         ['refs/tags/version1'])
+        self.assertEqual(3, repo.references_count())
+        self.assertEqual(2, repo.references_count('refs/heads/*'))
+        self.assertEqual(0, repo.references_count('refs/remotes/*'))
+
+    def test_ref_transaction(self):
+        repo = self.repo
+        i18n = repo.lookup_reference('refs/heads/i18n').target
+        master = repo.lookup_reference('refs/heads/master').target
+
+        with repo.ref_transaction() as tx:
+            tx.create('refs/tags/v1', master)
+            tx.update('refs/heads/master', i18n, master)
+            tx.delete('refs/heads/i18n', i18n)
+            self.assertEqual(3, len(tx))
+
+        self.assertEqual(sorted(repo.listall_references()),
+                         ['refs/heads/master', 'refs/tags/v1'])
+        self.assertEqual(repo.lookup_reference('refs/heads/master').target,
+                         i18n)
+
+        # A wrong expectation aborts the whole transaction
+        tx = repo.ref_transaction()
+        tx.create('refs/tags/v2', master)
+        tx.update('refs/heads/master', master, master)
+        self.assertRaises(GitError, tx.commit)
+        self.assertEqual(0, len(tx))
+        self.assertEqual(sorted(repo.listall_references()),
+                         ['refs/heads/master', 'refs/tags/v1'])
+
+        # Nothing is committed when the block raises
+        try:
+            with repo.ref_transaction() as tx:
+                tx.delete('refs/tags/v1')
+                raise ValueError
+        except ValueError:
+            pass
+        self.assertTrue('refs/tags/v1' in repo.listall_references())
+
+        tx.create('refs/tags/v3', master)
+        tx.update('refs/tags/v3', i18n)
+        self.assertRaises(ValueError, tx.commit)
+        self.assertEqual(0, len(tx))
+        self.assertFalse('refs/tags/v3' in repo.listall_references())
+
     def test_head(self):
         head = self.repo.head
         self.assertEqual(LAST_COMMIT, self.repo[head.target].hex)
@@ -201,8 +257,52 @@ class ReferencesTest(utils.RepoTestCase):
         self.assertEqual(reference.target, 'refs/heads/master')
 
 
-#   def test_packall_references(self):
-#       self.repo.packall_references()
+    def test_pack_references(self):
+        repo = self.repo
+        repo.create_reference('refs/tags/version1', LAST_COMMIT)
+        loose = join(repo.path, 'refs', 'tags', 'version1')
+        self.assertTrue(exists(loose))
+
+        repo.pack_references()
+        self.assertFalse(exists(loose))
+        reference = repo.lookup_reference('refs/tags/version1')
+        self.assertEqual(reference.target.hex, LAST_COMMIT)
+        reference = repo.lookup_reference('refs/heads/master')
+        self.assertEqual(reference.target.hex, LAST_COMMIT)
+
+
+    def test_create_references_packed(self):
+        repo = self.repo
+        tagger = Signature('Alice', 'alice@example.com', 1373371436, 0)
+        tag = repo.create_tag('version0', LAST_COMMIT, GIT_OBJ_COMMIT, tagger,
+                              'Tagged for the tests.\n').hex
+        repo.create_references([('refs/tags/version1', LAST_COMMIT),
+                                ('refs/tags/version2', tag)], packed=True)
+
+        self.assertFalse(exists(join(repo.path, 'refs', 'tags', 'version1')))
+        with open(join(repo.path, 'packed-refs')) as f:
+            lines = f.read().splitlines()
+        self.assertEqual(lines[-3:], [
+            '%s refs/tags/version1' % LAST_COMMIT,
+            '%s refs/tags/version2' % tag,
+            '^%s' % LAST_COMMIT])
+        reference = repo.lookup_reference('refs/tags/version2')
+        self.assertEqual(reference.target.hex, tag)
+
+        # Existing references and directories are not overridden, packed
+        # or not, and nothing is created then
+        for packed in (True, False):
+            self.assertRaises(ValueError, repo.create_references,
+                              [('refs/tags/version3', LAST_COMMIT),
+                               ('refs/heads/master', LAST_COMMIT)],
+                              packed=packed)
+            self.assertRaises(ValueError, repo.create_references,
+                              {'refs/tags/version1/a': LAST_COMMIT},
+                              packed=packed)
+            self.assertRaises(ValueError, repo.create_references,
+                              {'refs/tags': LAST_COMMIT}, packed=packed)
+        self.assertFalse(exists(join(repo.path, 'packed-refs.lock')))
+        self.assertEqual(repo.references_count('refs/tags/*'), 3)
 
 
     def test_get_object(self):
@@ -211,5 +311,33 @@ class ReferencesTest(utils.RepoTestCase):
         self.assertEqual(repo[ref.target].oid, ref.get_object().oid)
 
 
+class ReferencesSnapshotTest(utils.BareRepoTestCase):
+
+    def test_references_snapshot(self):
+        repo = self.repo
+        repo.create_reference('refs/tags/version1', 'refs/heads/master')
+        repo.create_reference('refs/tags/broken', 'refs/heads/nothing')
+
+        snapshot = dict( (name, (target, peeled)) for name, target, peeled
+                         in repo.references_snapshot() )
+        head = repo.lookup_reference('refs/heads/master').target
+        root = 'c2792cfa289ae6321ecf2cd5806c2194b0fd070c'
+        self.assertEqual(snapshot['refs/heads/master'], (head, head))
+        self.assertEqual(snapshot['refs/tags/version1'],
+                         ('refs/heads/master', head))
+        self.assertEqual(snapshot['refs/tags/broken'],
+                         ('refs/heads/nothing', None))
+        target, peeled = snapshot['refs/tags/root']
+        self.assertEqual(repo[target].type, GIT_OBJ_TAG)
+        self.assertEqual(peeled.hex, root)
+
+        names = [ x[0] for x in repo.references_snapshot('refs/tags/*') ]
+        self.assertEqual(sorted(names), ['refs/tags/broken', 'refs/tags/root',
+                                         'refs/tags/version1'])
+
+        snapshot = repo.references_snapshot('refs/tags/root', peel=False)
+        self.assertEqual(snapshot[0][2], None)
+
+
 if __name__ == '__main__':
     unittest.main()
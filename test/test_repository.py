@@ -37,12 +37,14 @@ import unittest
 import tempfile
 import os
 from os.path import join, realpath
+import re
 
 # Import from pygit2
 from pygit2 import GIT_OBJ_ANY, GIT_OBJ_BLOB, GIT_OBJ_COMMIT
 from pygit2 import init_repository, clone_repository, discover_repository
 from pygit2 import Oid, Reference, hashfile
 import pygit2
+from pygit2.repository import grep_literal
 from . import utils
 
 
@@ -238,6 +240,108 @@ class RepositoryTest_II(utils.RepoTestCase):
         self.assertEqual(commit.hex,
                          'acecd5ea2924a4b900e7e149496e1f4b57976e51')
 
+    def test_merge_base_many(self):
+        master = '2be5719152d4f82c7302b1c0932d8e5f0a4a0e98'
+        heads = ['5470a671a80ac3789f1a6a8cefbcf43ce7af0563',
+                 '5ebeeebb320790caf276b9fc8b24546d63316533',
+                 'acecd5ea2924a4b900e7e149496e1f4b57976e51']
+        bases = self.repo.merge_base_many(master, heads)
+        self.assertEqual([base.hex for base in bases],
+                         ['4ec4389a8068641da2d6578db0419484972284c8',
+                          heads[1], heads[2]])
+
+        # Again, from the cache
+        bases = self.repo.merge_base_many(master, heads[:1])
+        self.assertEqual(bases[0].hex,
+                         '4ec4389a8068641da2d6578db0419484972284c8')
+
+    def test_merge_base_octopus(self):
+        oids = ['5470a671a80ac3789f1a6a8cefbcf43ce7af0563',
+                '5ebeeebb320790caf276b9fc8b24546d63316533',
+                '2be5719152d4f82c7302b1c0932d8e5f0a4a0e98']
+        base = self.repo.merge_base_octopus(oids)
+        self.assertEqual(base.hex, 'acecd5ea2924a4b900e7e149496e1f4b57976e51')
+
+    def test_merge_trees(self):
+        repo = self.repo
+        ancestor = repo['acecd5ea2924a4b900e7e149496e1f4b57976e51'].tree
+        ours = repo['5ebeeebb320790caf276b9fc8b24546d63316533'].tree
+        theirs = repo['4ec4389a8068641da2d6578db0419484972284c8'].tree
+
+        index = repo.merge_trees(ancestor, ours, theirs)
+        self.assertFalse(index.has_conflicts)
+        self.assertEqual(index.conflicts(), {})
+        master = repo['2be5719152d4f82c7302b1c0932d8e5f0a4a0e98']
+        self.assertEqual(index.write_tree(), master.tree.oid)
+
+    def test_merge_trees_conflict(self):
+        repo = self.repo
+        ancestor = repo['acecd5ea2924a4b900e7e149496e1f4b57976e51'].tree
+        theirs = repo['6aaa262e655dd54252e5813c8e5acd7780ed097d'].tree
+        blob = repo.create_blob(b'hello world\nhallo welt\n')
+        builder = repo.TreeBuilder()
+        builder.insert('hello.txt', blob, pygit2.GIT_FILEMODE_BLOB)
+        ours = repo[builder.write()]
+
+        conflicts = repo.merge_trees(ancestor, ours, theirs).conflicts()
+        self.assertEqual(list(conflicts), ['hello.txt'])
+        self.assertEqual([entry.oid for entry in conflicts['hello.txt']],
+                         [ancestor['hello.txt'].oid, blob,
+                          theirs['hello.txt'].oid])
+
+        index = repo.merge_trees(
+            ancestor, ours, theirs,
+            automerge=pygit2.GIT_MERGE_AUTOMERGE_FAVOR_OURS)
+        self.assertFalse(index.has_conflicts)
+        self.assertEqual(index['hello.txt'].oid, blob)
+
+    def test_ahead_behind(self):
+        master = '2be5719152d4f82c7302b1c0932d8e5f0a4a0e98'
+        i18n = '5470a671a80ac3789f1a6a8cefbcf43ce7af0563'
+        self.assertEqual(self.repo.ahead_behind(master, i18n), (2, 1))
+        self.assertEqual(self.repo.ahead_behind(i18n, master), (1, 2))
+        self.assertEqual(self.repo.ahead_behind_many([(master, i18n),
+                                                      (master, master)]),
+                         [(2, 1), (0, 0)])
+
+    def test_descendant_of(self):
+        master = '2be5719152d4f82c7302b1c0932d8e5f0a4a0e98'
+        root = 'acecd5ea2924a4b900e7e149496e1f4b57976e51'
+        self.assertTrue(self.repo.descendant_of(master, root))
+        self.assertFalse(self.repo.descendant_of(root, master))
+        self.assertFalse(self.repo.descendant_of(master, master))
+        self.assertFalse(self.repo.descendant_of(
+            master, '5470a671a80ac3789f1a6a8cefbcf43ce7af0563'))
+
+    def test_grep(self):
+        repo = self.repo
+        self.assertEqual(repo.grep('HEAD', 'ol'),
+                         [('hello.txt', 2, b'hola mundo')])
+        self.assertEqual(repo.grep('HEAD', r'^h', pathspec=['hello.txt']),
+                         [('hello.txt', 1, b'hello world'),
+                          ('hello.txt', 2, b'hola mundo')])
+        self.assertEqual(repo.grep(repo.head, r'bon\w+r le monde$', workers=4),
+                         [('hello.txt', 3, b'bonjour le monde')])
+        self.assertEqual(repo.grep('HEAD', 'HOLA', flags=re.IGNORECASE),
+                         [('hello.txt', 2, b'hola mundo')])
+        self.assertEqual(repo.grep('HEAD', 'hola', pathspec=['bye.txt']), [])
+
+    def test_grep_blobs(self):
+        repo = self.repo
+        tree = repo.head.get_object().tree
+        oids = tree['hello.txt'].oid.raw * 2
+        self.assertEqual(repo.grep_blobs(oids, b'jour'),
+                         [(0, 3, b'bonjour le monde'),
+                          (1, 3, b'bonjour le monde')])
+        self.assertEqual(len(repo.grep_blobs(oids, b'')), 6)
+        self.assertRaises(ValueError, repo.grep_blobs, oids[:-1], b'')
+
+    def test_grep_literal(self):
+        self.assertEqual(grep_literal(b'hello'), b'hello')
+        self.assertEqual(grep_literal(br'\bfoo.*\.barbaz\d'), b'.barbaz')
+        self.assertEqual(grep_literal(b'abc?d'), b'ab')
+        self.assertEqual(grep_literal(b'(long)x|y'), b'')
+
 
 class NewRepositoryTest(utils.NoRepoTestCase):
 
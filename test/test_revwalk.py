@@ -29,9 +29,13 @@
 
 from __future__ import absolute_import
 from __future__ import unicode_literals
+from binascii import hexlify
+import struct
 import unittest
 
-from pygit2 import GIT_SORT_TIME, GIT_SORT_REVERSE
+from pygit2 import GIT_SORT_TIME, GIT_SORT_REVERSE, GIT_SORT_TOPOLOGICAL
+from pygit2 import GIT_FILEMODE_BLOB
+from pygit2 import Signature
 from . import utils
 
 
@@ -64,6 +68,26 @@ class RevlogTestTest(utils.RepoTestCase):
             self.assertEqual(entry.committer.name, REVLOGS[i][0])
             self.assertEqual(entry.message, REVLOGS[i][1])
 
+    def test_log_entry_outlives_iterator(self):
+        ref = self.repo.lookup_reference('HEAD')
+        entry = list(ref.log())[-1]
+        self.assertEqual(entry.oid_old, '0' * 40)
+        self.assertEqual(entry.oid_new, log[-1])
+        self.assertEqual(entry.committer.time, 1297179898)
+
+    def test_log_table(self):
+        ref = self.repo.lookup_reference('HEAD')
+        oids_old, oids_new, times, offsets = ref.log_table()
+        n = len(REVLOGS)
+        self.assertEqual(len(oids_old), n * 20)
+        self.assertEqual(hexlify(oids_old[-20:]).decode('ascii'), '0' * 40)
+        self.assertEqual(hexlify(oids_new[-20:]).decode('ascii'), log[-1])
+        times = struct.unpack(str('%dq') % n, times)
+        offsets = struct.unpack(str('%di') % n, offsets)
+        self.assertEqual(times[-1], 1297179898)
+        self.assertEqual(offsets[-1], 60)
+        self.assertEqual(list(times), sorted(times, reverse=True))
+
 
 class WalkerTest(utils.RepoTestCase):
 
@@ -102,6 +126,88 @@ class WalkerTest(utils.RepoTestCase):
         walker.sort(GIT_SORT_TIME | GIT_SORT_REVERSE)
         self.assertEqual([x.hex for x in walker], list(reversed(log)))
 
+    def test_limit_paths(self):
+        walker = self.repo.walk(log[0], GIT_SORT_TIME)
+        walker.limit_paths(['hello.txt'])
+        # The merge is the same as its second parent for hello.txt
+        self.assertEqual([x.hex for x in walker], log[2:])
+
+        walker.reset()
+        walker.push(log[0])
+        walker.limit_paths(['.gitignore', 'no/such/file'])
+        self.assertEqual([x.hex for x in walker], log[1:2])
+
+        walker.reset()
+        walker.push(log[0])
+        walker.limit_paths([])
+        self.assertEqual([x.hex for x in walker], log)
+
+    def test_limit_paths_follow_renames(self):
+        repo = self.repo
+        head = repo[log[0]]
+        builder = repo.TreeBuilder(head.tree)
+        builder.insert('salut.txt', head.tree['hello.txt'].oid,
+                       GIT_FILEMODE_BLOB)
+        builder.remove('hello.txt')
+        signature = Signature('Foo', 'foo@example.com', 12346, 0)
+        renamed = repo.create_commit(None, signature, signature,
+                                     'Rename hello.txt', builder.write(),
+                                     [head.oid])
+
+        walker = repo.walk(renamed, GIT_SORT_TIME)
+        walker.limit_paths(['salut.txt'])
+        self.assertEqual([x.oid for x in walker], [renamed])
+
+        walker.reset()
+        walker.push(renamed)
+        walker.limit_paths(['salut.txt'], True)
+        self.assertEqual([x.hex for x in walker],
+                         [renamed.hex] + log[2:])
+
+        # A new walk starts again from the new name
+        walker.push(renamed)
+        self.assertEqual([x.hex for x in walker],
+                         [renamed.hex] + log[2:])
+        walker.push(renamed)
+        next(walker)
+        next(walker)
+        walker.reset()
+        walker.push(renamed)
+        self.assertEqual([x.hex for x in walker],
+                         [renamed.hex] + log[2:])
+
+        self.assertRaises(ValueError, walker.limit_paths,
+                          ['salut.txt', 'bye.txt'], True)
+
+    def test_limit_paths_follow_renames_merge(self):
+        repo = self.repo
+        head = repo[log[0]]
+
+        def commit(parents, tree, message):
+            time = head.commit_time + len(message)
+            signature = Signature('Foo', 'foo@example.com', time, 0)
+            return repo.create_commit(None, signature, signature, message,
+                                      tree, parents)
+
+        # hello.txt is renamed, then changed, and merged into head
+        builder = repo.TreeBuilder(head.tree)
+        builder.insert('salut.txt', head.tree['hello.txt'].oid,
+                       GIT_FILEMODE_BLOB)
+        builder.remove('hello.txt')
+        renamed = commit([head.oid], builder.write(), 'Rename')
+        builder.insert('salut.txt', repo.create_blob(b'salut\n'),
+                       GIT_FILEMODE_BLOB)
+        tree = builder.write()
+        changed = commit([renamed], tree, 'Change it')
+        merge = commit([head.oid, changed], tree, 'Merge the change')
+
+        # The merge is the same as its second parent: it is left out, and
+        # the followed name must not change there
+        walker = repo.walk(merge, GIT_SORT_TOPOLOGICAL)
+        walker.limit_paths(['salut.txt'], True)
+        self.assertEqual([x.hex for x in walker],
+                         [changed.hex, renamed.hex] + log[2:])
+
 
 if __name__ == '__main__':
     unittest.main()
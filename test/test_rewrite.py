@@ -0,0 +1,131 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright 2010-2013 The pygit2 contributors
+#
+# This file is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License, version 2,
+# as published by the Free Software Foundation.
+#
+# In addition to the permissions in the GNU General Public License,
+# the authors give you unlimited permission to link the compiled
+# version of this file into combinations with other programs,
+# and to distribute those combinations without any restriction
+# coming from the use of this file.  (The General Public License
+# restrictions do apply in other respects; for example, they cover
+# modification of the file, and distribution when not linked into
+# a combined executable.)
+#
+# This file is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; see the file COPYING.  If not, write to
+# the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+# Boston, MA 02110-1301, USA.
+
+
+"""Tests for Repository.rewrite_history."""
+
+from __future__ import absolute_import
+from __future__ import unicode_literals
+import unittest
+
+from pygit2 import GIT_SORT_TOPOLOGICAL, GIT_OBJ_COMMIT, Signature
+from . import utils
+
+
+HEAD_SHA = '784855caf26449a1914d2cf62d12b9374d76ae78'
+FIRST_SHA = 'c2792cfa289ae6321ecf2cd5806c2194b0fd070c'
+MASTER = 'refs/heads/master'
+
+
+class RewriteHistoryTest(utils.BareRepoTestCase):
+
+    def history(self):
+        head = self.repo.lookup_reference(MASTER).target
+        return list(self.repo.walk(head, GIT_SORT_TOPOLOGICAL))
+
+    def test_noop(self):
+        result = self.repo.rewrite_history([MASTER])
+        self.assertEqual({MASTER: self.repo[HEAD_SHA].oid}, result)
+
+    def test_remove_path(self):
+        result = self.repo.rewrite_history([MASTER], path_filter=['c/d'])
+        history = self.history()
+        self.assertEqual(result[MASTER], history[0].oid)
+        self.assertEqual(7, len(history))
+        for commit in history:
+            self.assertFalse('c' in commit.tree)
+        # The first commit did not have c/d, so it is kept as is
+        self.assertEqual(FIRST_SHA, history[-1].hex)
+        self.assertEqual(['a', 'a.copy', 'b', 'ipsum'],
+                         [ x.name for x in history[0].tree ])
+
+    def test_annotated_tag(self):
+        tagger = Signature('Alice', 'alice@example.com', 1373371436, 0)
+        old_tag = self.repo.create_tag('version1', HEAD_SHA, GIT_OBJ_COMMIT,
+                                       tagger, 'Tagged for the tests.\n')
+        tag_ref = 'refs/tags/version1'
+
+        result = self.repo.rewrite_history([MASTER, tag_ref],
+                                           path_filter=['c/d'])
+        tag = self.repo[result[tag_ref]]
+        self.assertNotEqual(old_tag, tag.oid)
+        self.assertEqual(tag.oid, self.repo.lookup_reference(tag_ref).target)
+        self.assertEqual(result[MASTER], tag.target)
+        self.assertEqual('version1', tag.name)
+        self.assertEqual('Alice', tag.tagger.name)
+        self.assertEqual('Tagged for the tests.\n', tag.message)
+
+        # Nothing to rewrite, the tag is kept
+        result = self.repo.rewrite_history([tag_ref])
+        self.assertEqual(tag.oid, result[tag_ref])
+
+    def test_author_map(self):
+        author_map = {'dborowitz@google.com': ('Dave', 'dave@example.com')}
+        self.repo.rewrite_history([MASTER], author_map=author_map)
+        history = self.history()
+        for commit in history[-2:]:
+            self.assertEqual('Dave', commit.author.name)
+            self.assertEqual('dave@example.com', commit.committer.email)
+        self.assertEqual('Nico von Geyso', history[0].author.name)
+        self.assertNotEqual(HEAD_SHA, history[0].hex)
+
+        for value in ('Dave', ['Dave', 'dave@example.com'], ('Dave',)):
+            self.assertRaises(TypeError, self.repo.rewrite_history, [MASTER],
+                              author_map={'dave@example.com': value})
+
+    def test_callbacks(self):
+        trees = []
+        def tree_filter(oid):
+            trees.append(oid)
+            return None
+
+        def commit_filter(commit):
+            if commit.message.startswith('add a white space'):
+                return None
+            return (commit.author, commit.committer,
+                    commit.message.upper())
+
+        self.repo.rewrite_history([MASTER], tree_filter=tree_filter,
+                                  commit_filter=commit_filter)
+        history = self.history()
+        self.assertEqual(6, len(history))
+        self.assertEqual('MOVED LOREM TO IPSUM\n', history[0].message)
+        # Called once per tree, including the one of the dropped commit
+        self.assertEqual(7, len(set(trees)))
+        self.assertEqual(7, len(trees))
+
+    def test_callback_error(self):
+        def tree_filter(oid):
+            raise ValueError(oid)
+
+        self.assertRaises(ValueError, self.repo.rewrite_history, [MASTER],
+                          tree_filter=tree_filter)
+        self.assertEqual(HEAD_SHA, self.history()[0].hex)
+
+
+if __name__ == '__main__':
+    unittest.main()
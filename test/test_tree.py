@@ -29,9 +29,11 @@
 
 from __future__ import absolute_import
 from __future__ import unicode_literals
+from array import array
 import operator
 import unittest
 
+from pygit2 import GIT_TREEWALK_POST
 from . import utils
 
 
@@ -121,5 +123,58 @@ class TreeTest(utils.BareRepoTestCase):
             self.assertEqual(tree_entry.hex, tree[tree_entry.name].hex)
 
 
+    def test_entry_outlives_tree(self):
+        # Entries are borrowed from the tree, which they keep alive
+        entries = list(self.repo[TREE_SHA])
+        entry = self.repo[TREE_SHA][0]
+        self.assertEqual([ x.name for x in entries ], ['a', 'b', 'c'])
+        self.assertTreeEntryEqual(
+            entry, '7f129fd57e31e935c6d60a0c794efe4e6927664b', 'a', 0o0100644)
+
+
+    def test_tree_entries(self):
+        tree = self.repo[TREE_SHA]
+        names, oids, filemodes = tree.entries()
+        self.assertEqual(names, ['a', 'b', 'c'])
+        self.assertEqual(oids, b''.join([ x.oid.raw for x in tree ]))
+        filemodes = array(str('I'), filemodes)
+        self.assertEqual(list(filemodes), [0o0100644, 0o0100644, 0o0040000])
+
+
+    def test_walk_tree(self):
+        tree = self.repo[TREE_SHA]
+        entries = [ (path, oid.hex, filemode)
+                    for path, oid, filemode in tree.walk() ]
+        self.assertEqual(entries, [
+            ('a', '7f129fd57e31e935c6d60a0c794efe4e6927664b', 0o0100644),
+            ('b', '85f120ee4dac60d0719fd51731e4199aa5a37df6', 0o0100644),
+            ('c', SUBTREE_SHA, 0o0040000),
+            ('c/d', '297efb891a47de80be0cfe9c639e4b8c9b450989', 0o0100644)])
+
+        paths = [ x[0] for x in tree.walk(GIT_TREEWALK_POST) ]
+        self.assertEqual(paths, ['a', 'b', 'c/d', 'c'])
+
+        paths = [ x[0] for x in tree.walk(blobs_only=True) ]
+        self.assertEqual(paths, ['a', 'b', 'c/d'])
+
+        paths = [ x[0] for x in tree.walk(pathspec=['c/d', 'b']) ]
+        self.assertEqual(paths, ['b', 'c/d'])
+
+        paths = [ x[0] for x in tree.walk(pathspec=['c/']) ]
+        self.assertEqual(paths, ['c', 'c/d'])
+
+        self.assertRaises(ValueError, tree.walk, 3)
+
+
+    def test_walk_tree_bulk(self):
+        tree = self.repo[TREE_SHA]
+        paths, oids, filemodes = tree.walk(blobs_only=True, bulk=True)
+        self.assertEqual(paths, ['a', 'b', 'c/d'])
+        self.assertEqual(len(oids), 3 * 20)
+        self.assertEqual(oids[40:], tree['c/d'].oid.raw)
+        filemodes = array(str('I'), filemodes)
+        self.assertEqual(list(filemodes), [0o0100644] * 3)
+
+
 if __name__ == '__main__':
     unittest.main()
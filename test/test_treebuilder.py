@@ -29,6 +29,7 @@
 
 from __future__ import absolute_import
 from __future__ import unicode_literals
+import sys
 import unittest
 
 from . import utils
@@ -75,5 +76,33 @@ class TreeBuilderTest(utils.BareRepoTestCase):
         self.assertEqual(tree.oid, result)
 
 
+    def test_insert_many(self):
+        tree = self.repo[TREE_SHA]
+        # Raw oids are bytes, and bytes are hex strings in Python 2
+        raw = sys.version_info[0] >= 3
+        entries = [ (x.name, x.oid.raw if raw else x.oid, x.filemode)
+                    for x in tree ]
+
+        bld = self.repo.TreeBuilder()
+        bld.insert_many(entries)
+        self.assertEqual(tree.oid, bld.write())
+
+        bld = self.repo.TreeBuilder(entries)
+        self.assertEqual(tree.oid, bld.write())
+
+        entries = dict( (x.name, (x.hex, x.filemode)) for x in tree )
+        bld = self.repo.TreeBuilder(entries)
+        self.assertEqual(tree.oid, bld.write())
+
+        self.assertRaises(TypeError, bld.insert_many, [('a', tree.oid)])
+
+        # A hex prefix as long as a raw oid is still a prefix, refused
+        prefix = tree.hex[:20]
+        if not raw:
+            prefix = prefix.encode('ascii')
+        self.assertRaises(ValueError, bld.insert_many,
+                          [('a', prefix, 0o100644)])
+
+
 if __name__ == '__main__':
     unittest.main()
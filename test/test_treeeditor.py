@@ -0,0 +1,118 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright 2010-2013 The pygit2 contributors
+#
+# This file is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License, version 2,
+# as published by the Free Software Foundation.
+#
+# In addition to the permissions in the GNU General Public License,
+# the authors give you unlimited permission to link the compiled
+# version of this file into combinations with other programs,
+# and to distribute those combinations without any restriction
+# coming from the use of this file.  (The General Public License
+# restrictions do apply in other respects; for example, they cover
+# modification of the file, and distribution when not linked into
+# a combined executable.)
+#
+# This file is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; see the file COPYING.  If not, write to
+# the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+# Boston, MA 02110-1301, USA.
+
+
+"""Tests for TreeEditor objects."""
+
+from __future__ import absolute_import
+from __future__ import unicode_literals
+import unittest
+
+from pygit2 import GIT_FILEMODE_BLOB, GIT_FILEMODE_BLOB_EXECUTABLE
+from . import utils
+
+
+TREE_SHA = '967fce8df97cc71722d3c2a5930ef3e6f1d27b12'
+
+
+class TreeEditorTest(utils.BareRepoTestCase):
+
+    def paths(self, oid):
+        return [ x[0] for x in self.repo[oid].walk(blobs_only=True) ]
+
+
+    def test_noop_treeeditor(self):
+        editor = self.repo.TreeEditor(TREE_SHA)
+        self.assertEqual(len(editor), 0)
+        self.assertEqual(editor.write().hex, TREE_SHA)
+
+
+    def test_new_tree(self):
+        repo = self.repo
+        blob = repo.create_blob('foo')
+        editor = repo.TreeEditor()
+        editor.upsert('a/b/c/d.txt', blob, GIT_FILEMODE_BLOB)
+        editor.upsert('a/e.txt', blob, GIT_FILEMODE_BLOB_EXECUTABLE)
+        self.assertEqual(len(editor), 2)
+
+        tree = repo[editor.write()]
+        self.assertEqual(self.paths(tree.oid), ['a/b/c/d.txt', 'a/e.txt'])
+        self.assertEqual(tree['a/b/c/d.txt'].oid, blob)
+        self.assertEqual(tree['a/e.txt'].filemode,
+                         GIT_FILEMODE_BLOB_EXECUTABLE)
+
+
+    def test_edit_tree(self):
+        repo = self.repo
+        tree = repo[TREE_SHA]
+        blob = repo.create_blob('foo')
+        editor = repo.TreeEditor(tree)
+        editor.upsert('c/x/y', blob, GIT_FILEMODE_BLOB)
+        editor.upsert('b', blob, GIT_FILEMODE_BLOB)
+        editor.remove('a')
+        editor.remove('nonexistent/path')
+
+        new_tree = repo[editor.write()]
+        self.assertEqual(self.paths(new_tree.oid), ['b', 'c/d', 'c/x/y'])
+        self.assertEqual(new_tree['b'].oid, blob)
+        self.assertEqual(new_tree['c/d'].oid, tree['c/d'].oid)
+
+
+    def test_remove_empties_trees(self):
+        editor = self.repo.TreeEditor(TREE_SHA)
+        editor.remove('c/d')
+        self.assertEqual(self.paths(editor.write()), ['a', 'b'])
+
+
+    def test_operations_order(self):
+        blob = self.repo.create_blob('foo')
+
+        # Removing a tree drops the changes queued before within it
+        editor = self.repo.TreeEditor(TREE_SHA)
+        editor.upsert('c/e', blob, GIT_FILEMODE_BLOB)
+        editor.remove('c')
+        self.assertEqual(self.paths(editor.write()), ['a', 'b'])
+
+        # But not the ones queued after
+        editor.upsert('c/f', blob, GIT_FILEMODE_BLOB)
+        self.assertEqual(self.paths(editor.write()), ['a', 'b', 'c/f'])
+
+        # The last operation on a path wins
+        editor.clear()
+        editor.upsert('a', blob, GIT_FILEMODE_BLOB)
+        editor.remove('a')
+        self.assertEqual(self.paths(editor.write()), ['b', 'c/d'])
+
+
+    def test_invalid_paths(self):
+        editor = self.repo.TreeEditor()
+        for path in ['', '/a', 'a/', 'a//b']:
+            self.assertRaises(ValueError, editor.remove, path)
+
+
+if __name__ == '__main__':
+    unittest.main()